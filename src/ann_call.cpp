@@ -4,13 +4,21 @@
 #include <cmath>
 #include <cstring>
 #include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <math.h>
 
 namespace ann_namespace {
   #include "ANN.h"
+  #include "ANNperf.h"
 }
 
+/* Point indices and counts, 64-bit when built with ANN_IDX64 */
+typedef ann_namespace::ANNidx bann_idx;
+
 extern "C" {
   /* ANN search wrapper 
    * Performs k-nearest neighbor search using specified divergence.
@@ -24,54 +32,43 @@ extern "C" {
    *    K        - number of nearest neighbors to find
    *    Eps      - approximation factor
    *    DivChoice- divergence choice (0: Eucl, 1: KL, 2: DKL, 3: IS, 4: DIS)
+   *    Lazy     - if nonzero, subtrees are built when a search first reaches them
    *  
    *  Output: None
    *    Stores array of indices of k nearest neighbours of each query point in Indx
    *    (row-major order)
   */
-  void bann_search(double *Data, int *NData, double *Query, int *NQuery, int *Dim,
-                   int *K, int *Indx, double *Eps, int *DivChoice)
+  void bann_search(double *Data, bann_idx *NData, double *Query, bann_idx *NQuery, int *Dim,
+                   int *K, bann_idx *Indx, double *Dists, double *Eps, int *DivChoice, int *Lazy)
   {
     using namespace ann_namespace;
 
     const int dim = *Dim;
-    const int nData = *NData;
-    const int nQuery = *NQuery;
+    const bann_idx nData = *NData;
+    const bann_idx nQuery = *NQuery;
     const int k = *K;
     const double eps = *Eps;
     const int divChoice = *DivChoice;
 
     ANNkd_tree *tree;
-    ANNpointArray dataPts = annAllocPts(nData, dim);
-    ANNpointArray queryPts = annAllocPts(nQuery, dim);
     ANNidxArray nnIdx = new ANNidx[k];
     ANNdistArray divs = new ANNdist[k];
 
-    int ptr = 0;
-    /* Read in data points.
-     *  Data is input as a contiguous block, passed in row-major order.
+    bann_idx ptr = 0;
+    /* View data and query points.
+     *  Both are input as contiguous blocks, passed in row-major order, and
+     *  are searched in place rather than copied.
      */
-    for (int i = 0; i < nData; i++) {
-      for (int j = 0; j < dim; j++) {
-        dataPts[i][j] = Data[i * dim + j];
-      }
-    }
-    tree = new ANNkd_tree(dataPts, nData, dim);
-    /* Read in query points
-     *  Query is input as a contiguous block, passed in row-major order.
-    */
-    for (int i = 0; i < nQuery; i++) {
-      for (int j = 0; j < dim; j++) {
-        queryPts[i][j] = Query[i * dim + j];
-      }
-    }
+    ANNpointArray dataPts = annViewPts(Data, nData, dim);
+    ANNpointArray queryPts = annViewPts(Query, nQuery, dim);
+    tree = new ANNkd_tree(dataPts, nData, dim, 1, ANN_KD_SUGGEST, (ANNbool) (*Lazy != 0));
 
     /* For each query point, find the k nearest neighbors. 
      *   Store indices in Indx array.
     */
     switch (divChoice) {
       case 0: // Euclidean search
-        for (int i = 0; i < nQuery; i++) {
+        for (bann_idx i = 0; i < nQuery; i++) {
           tree->annkSearch(
             div_component_eucl,
             queryPts[i],
@@ -80,12 +77,13 @@ extern "C" {
             divs,
             eps);
           for (int j = 0; j < k; j++) {
+            if (Dists != NULL) Dists[ptr] = divs[j];
             Indx[ptr++] = nnIdx[j];
           }
         }
         break;
       case 1: // KL search
-        for (int i = 0; i < nQuery; i++) {
+        for (bann_idx i = 0; i < nQuery; i++) {
           tree->annkSearch(
             div_component_kl,
             queryPts[i],
@@ -94,12 +92,13 @@ extern "C" {
             divs,
             eps);
           for (int j = 0; j < k; j++) {
+            if (Dists != NULL) Dists[ptr] = divs[j];
             Indx[ptr++] = nnIdx[j];
           }
         }
         break;
       case 2: // DKL search
-        for (int i = 0; i < nQuery; i++) {
+        for (bann_idx i = 0; i < nQuery; i++) {
           tree->annkSearch(
             div_component_dkl,
             queryPts[i],
@@ -108,12 +107,13 @@ extern "C" {
             divs,
             eps);
           for (int j = 0; j < k; j++) {
+            if (Dists != NULL) Dists[ptr] = divs[j];
             Indx[ptr++] = nnIdx[j];
           }
         }
         break;
       case 3: // IS search
-        for (int i = 0; i < nQuery; i++) {
+        for (bann_idx i = 0; i < nQuery; i++) {
           tree->annkSearch(
             div_component_is,
             queryPts[i],
@@ -122,12 +122,13 @@ extern "C" {
             divs,
             eps);
           for (int j = 0; j < k; j++) {
+            if (Dists != NULL) Dists[ptr] = divs[j];
             Indx[ptr++] = nnIdx[j];
           }
         }
         break;
       case 4: // DIS search
-        for (int i = 0; i < nQuery; i++) {
+        for (bann_idx i = 0; i < nQuery; i++) {
           tree->annkSearch(
             div_component_dis,
             queryPts[i],
@@ -136,6 +137,7 @@ extern "C" {
             divs,
             eps);
           for (int j = 0; j < k; j++) {
+            if (Dists != NULL) Dists[ptr] = divs[j];
             Indx[ptr++] = nnIdx[j];
           }
         }
@@ -144,13 +146,178 @@ extern "C" {
         std::cerr << "Directive: "<< divChoice << "\n";
         break;
     }
-    annDeallocPts(dataPts);
-    annDeallocPts(queryPts);
+    annDeallocViewPts(dataPts);
+    annDeallocViewPts(queryPts);
     delete tree;
     delete [] nnIdx;
     delete [] divs;
   }
 
+  /* Divergence component for a k-nearest neighbour search with DivChoice
+   *  (0: Eucl, 1: KL, 2: DKL, 3: IS, 4: DIS). Empty if DivChoice is unknown.
+  */
+  static ann_namespace::divergence knn_divergence(int divChoice)
+  {
+    using namespace ann_namespace;
+
+    switch (divChoice) {
+      case 0: return div_component_eucl;
+      case 1: return div_component_kl;
+      case 2: return div_component_dkl;
+      case 3: return div_component_is;
+      case 4: return div_component_dis;
+      default: return divergence();
+    }
+  }
+
+  /* k-nearest neighbour search of the query rows in blocks of Block
+   *  The query rows are searched in place, so a block is only a list of
+   *  row pointers. If Order is nonzero the queries are searched in the
+   *  order of the leaves they fall into rather than row by row, and the
+   *  results are stored back in the rows of their queries.
+  */
+  static void knn_blocks(ann_namespace::ANNkd_tree *tree, ann_namespace::divergence div,
+                         double *Query, bann_idx nQuery, int dim, int k, double eps,
+                         int block, int Order, bann_idx *Indx, double *Dists)
+  {
+    using namespace ann_namespace;
+
+    ANNidxArray order = NULL;
+    if (Order != 0) {
+      ANNpointArray queryPts = annViewPts(Query, nQuery, dim);
+      order = new ANNidx[nQuery];
+      tree->annLeafOrder(queryPts, nQuery, order);
+      annDeallocViewPts(queryPts);
+    }
+
+    ANNpointArray blockPts = new ANNpoint[block];
+    ANNidxArray nnIdx = new ANNidx[block * k];
+    ANNdistArray divs = new ANNdist[block * k];
+    bann_idx *rows = new bann_idx[block];
+
+    for (bann_idx first = 0; first < nQuery; first += block) {
+      int nq = nQuery - first < block ? (int) (nQuery - first) : block;
+      for (int i = 0; i < nq; i++) {
+        rows[i] = order != NULL ? order[first + i] : first + i;
+        blockPts[i] = &Query[rows[i] * dim];
+      }
+      if (nq == 1) {
+        tree->annkSearch(div, blockPts[0], k, nnIdx, divs, eps);
+      }
+      else {
+        tree->annkSearchBlock(div, blockPts, nq, k, nnIdx, divs, eps);
+      }
+      for (int i = 0; i < nq; i++) {
+        for (int j = 0; j < k; j++) {
+          if (Dists != NULL) Dists[rows[i] * k + j] = divs[i * k + j];
+          Indx[rows[i] * k + j] = nnIdx[i * k + j];
+        }
+      }
+    }
+
+    delete [] rows;
+    delete [] blockPts;
+    delete [] nnIdx;
+    delete [] divs;
+    delete [] order;
+  }
+
+  /* k-nearest neighbour search of all query rows with a dual-tree search
+   *  A kd-tree is built over the query rows as well, and the two trees are
+   *  walked together (see annkDualSearch), so that queries close to each
+   *  other share the pruning of the data tree.
+  */
+  static void knn_dual(ann_namespace::ANNkd_tree *tree, ann_namespace::divergence div,
+                       double *Query, bann_idx nQuery, int dim, int k, double eps,
+                       bann_idx *Indx, double *Dists)
+  {
+    using namespace ann_namespace;
+
+    if (nQuery <= 0) {
+      return;
+    }
+    const int bucket = 8;             // queries compared per data leaf
+    ANNpointArray queryPts = annViewPts(Query, nQuery, dim);
+    ANNkd_tree *qtree = new ANNkd_tree(queryPts, nQuery, dim, bucket);
+    ANNdistArray divs = Dists != NULL ? Dists : new ANNdist[nQuery * k];
+    tree->annkDualSearch(div, qtree, k, Indx, divs, eps);
+    if (Dists == NULL) {
+      delete [] divs;
+    }
+    delete qtree;
+    annDeallocViewPts(queryPts);
+  }
+
+  /* Dual-tree ANN search wrapper
+   *  As bann_search, with all queries searched at once by annkDualSearch.
+  */
+  void bann_search_dual(double *Data, bann_idx *NData, double *Query, bann_idx *NQuery, int *Dim,
+                        int *K, bann_idx *Indx, double *Dists, double *Eps, int *DivChoice)
+  {
+    using namespace ann_namespace;
+
+    const int dim = *Dim;
+    const bann_idx nData = *NData;
+
+    divergence div = knn_divergence(*DivChoice);
+    if (!div) {
+      std::cerr << "Directive: "<< *DivChoice << "\n";
+      return;
+    }
+
+    ANNpointArray dataPts = annViewPts(Data, nData, dim);
+    ANNkd_tree *tree = new ANNkd_tree(dataPts, nData, dim);
+    knn_dual(tree, div, Query, *NQuery, dim, *K, *Eps, Indx, Dists);
+    delete tree;
+    annDeallocViewPts(dataPts);
+  }
+
+  /* Block ANN search wrapper
+   * Performs k-nearest neighbor search as bann_search, but pushes blocks of
+   * consecutive query points through the kd-tree together.
+   *
+   *  Inputs: as bann_search, and
+   *    Block    - number of query points per block
+   *    Order    - if nonzero, queries are first ordered by the leaves they
+   *               fall into, so that consecutive searches (and the queries
+   *               of a block) visit the same parts of the tree
+   *
+   *  Output: None
+   *    Stores indices and divergences as bann_search does, in the rows of
+   *    the queries whatever the order of the search.
+  */
+  void bann_search_block(double *Data, bann_idx *NData, double *Query, bann_idx *NQuery, int *Dim,
+                         int *K, bann_idx *Indx, double *Dists, double *Eps, int *DivChoice, int *Block,
+                         int *Order, int *Lazy)
+  {
+    using namespace ann_namespace;
+
+    const int dim = *Dim;
+    const bann_idx nData = *NData;
+    const bann_idx nQuery = *NQuery;
+    const int k = *K;
+    const double eps = *Eps;
+    const int block = *Block > 0 ? *Block : 1;
+
+    divergence div = knn_divergence(*DivChoice);
+    if (!div) {
+      std::cerr << "Directive: "<< *DivChoice << "\n";
+      return;
+    }
+
+    ANNpointArray dataPts = annViewPts(Data, nData, dim);
+    ANNkd_tree *tree = new ANNkd_tree(dataPts, nData, dim, 1, ANN_KD_SUGGEST, (ANNbool) (*Lazy != 0));
+    knn_blocks(tree, div, Query, nQuery, dim, k, eps, block, *Order, Indx, Dists);
+    delete tree;
+    annDeallocViewPts(dataPts);
+  }
+
+  /* Number of NUMA nodes on this machine */
+  int bann_numa_nodes()
+  {
+    return ann_namespace::annNumaNodes();
+  }
+
   /* ANN hausdorff search wrapper 
    * Performs approximate hausdorff distance computation using specified divergence.
    *  
@@ -162,47 +329,38 @@ extern "C" {
    *    Dim      - dimension of points
    *    Eps      - approximation factor
    *    DivChoice- divergence choice (0: Eucl, 1: KL, 2: DKL, 3: IS, 4: DIS)
+   *    NNDists  - NULL, or storage for NQuery divergences
+   *    Lazy     - if nonzero, subtrees are built when a search first reaches them
    *  
    *  Output:
    *    (1+epsilon) hausdorff divergence
+   *    If NNDists is not NULL, the divergence of each query point from its
+   *    nearest data point is stored there. The searches then run to the end
+   *    rather than stopping once a point is closer than the divergence so
+   *    far, which makes them slower.
   */
-   double bann_haus(double *P, int *NP, double *Q, int *NQ, int *Dim,
-        double *Eps, int *DivChoice)
+   double bann_haus(double *P, bann_idx *NP, double *Q, bann_idx *NQ, int *Dim,
+        double *Eps, int *DivChoice, double *NNDists, int *Lazy)
    {
       using namespace ann_namespace;
 
       const int dim = *Dim;
-      const int nP = *NP;
-      const int nQ = *NQ;
+      const bann_idx nP = *NP;
+      const bann_idx nQ = *NQ;
       const double eps = *Eps;
       const int divChoice = *DivChoice;
 
       ANNkd_tree *tree;
-      ANNpointArray dataPts = annAllocPts(nP, dim);
-      ANNpointArray queryPts = annAllocPts(nQ, dim);
-
       ANNidxArray nnIdx = new ANNidx[1];
       ANNdistArray divs = new ANNdist[1];
 
       double hausdorff = 0.0;
 
-      /* Read in Data pts, and build the kd_tree
+      /* View P and Q in place (row-major order), and build the kd_tree on P
        * */
-      for (int i = 0; i < nP; i++) {
-         for (int j = 0; j < dim; j++) {
-            dataPts[i][j] = P[i * dim + j];
-         }
-      }
-      /* Build kd-tree on P
-       * */
-      tree = new ANNkd_tree(dataPts, nP, dim);
-      /* Read in Query points
-       * */
-      for (int i = 0; i < nQ; i++) {
-         for (int j = 0; j < dim; j++) {
-            queryPts[i][j] = Q[i * dim + j];
-         }
-      }
+      ANNpointArray dataPts = annViewPts(P, nP, dim);
+      ANNpointArray queryPts = annViewPts(Q, nQ, dim);
+      tree = new ANNkd_tree(dataPts, nP, dim, 1, ANN_KD_SUGGEST, (ANNbool) (*Lazy != 0));
       /* Direction notes:
        * By default, the BH search builds the kd-tree on the first set (P), and then 
        * computes the nearest neighbour with the reversed computation direction from
@@ -211,70 +369,85 @@ extern "C" {
       */
       switch (divChoice) {
          case 0: // (squared) Euclidean search
-            for (int i = 0; i < nQ; i++) {
+            for (bann_idx i = 0; i < nQ; i++) {
                tree->annhSearch(
                      div_component_eucl,
                      queryPts[i],
                      nnIdx,
                      divs,
                      eps,
-                     hausdorff);
+                     NNDists != NULL ? 0.0 : hausdorff);
+              if (NNDists != NULL) {
+                NNDists[i] = divs[0];
+              }
               if (hausdorff < divs[0]) {
                 hausdorff = divs[0];
               }
             }
             break;
          case 1: // H_{KL}(P||Q)
-            for (int i = 0; i < nQ; i++) {
+            for (bann_idx i = 0; i < nQ; i++) {
                tree->annhSearch(
                   div_component_dkl,
                   queryPts[i],
                   nnIdx,
                   divs,
                   eps,
-                  hausdorff);
+                  NNDists != NULL ? 0.0 : hausdorff);
+              if (NNDists != NULL) {
+                NNDists[i] = divs[0];
+              }
               if (hausdorff < divs[0]) {
                 hausdorff = divs[0];
               }
             }
             break;
          case 2: // H'_{KL}(P||Q)
-            for (int i = 0; i < nQ; i++) {
+            for (bann_idx i = 0; i < nQ; i++) {
                tree->annhSearch(
                   div_component_kl,
                   queryPts[i],
                   nnIdx,
                   divs,
                   eps,
-                  hausdorff);
+                  NNDists != NULL ? 0.0 : hausdorff);
+              if (NNDists != NULL) {
+                NNDists[i] = divs[0];
+              }
               if (hausdorff < divs[0]) {
                 hausdorff = divs[0];
               }
             }
             break;
          case 3: // H_{IS}(P||Q)
-            for (int i = 0; i < nQ; i++) {
+            for (bann_idx i = 0; i < nQ; i++) {
                tree->annhSearch(
                   div_component_dis,
                   queryPts[i],
                   nnIdx,
                   divs,
                   eps,
-                  hausdorff);
+                  NNDists != NULL ? 0.0 : hausdorff);
+                if (NNDists != NULL) {
+                  NNDists[i] = divs[0];
+                }
                 if (hausdorff < divs[0]) {
                   hausdorff = divs[0];
                 }
             }
             break;
          case 4: // H'_{IS}(P||Q)
-            for (int i = 0; i < nQ; i++) {
+            for (bann_idx i = 0; i < nQ; i++) {
                tree->annhSearch(
                   div_component_is,
                   queryPts[i],
                   nnIdx,
                   divs,
                   eps,
-                  hausdorff);
+                  NNDists != NULL ? 0.0 : hausdorff);
+              if (NNDists != NULL) {
+                NNDists[i] = divs[0];
+              }
               if (hausdorff < divs[0]) {
                 hausdorff = divs[0];
               }
@@ -284,8 +457,8 @@ extern "C" {
             std::cerr << "Directive: " << divChoice << "\n";
             break;
       }
-      annDeallocPts(dataPts);
-      annDeallocPts(queryPts);
+      annDeallocViewPts(dataPts);
+      annDeallocViewPts(queryPts);
       delete tree;
       delete [] nnIdx;
       delete [] divs;
@@ -294,6 +467,743 @@ extern "C" {
    }
 
 
+  /* -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+   * Persistent index
+   *  The functions above build a kd-tree for every call. A bann_index owns
+   *  the data points and their kd-tree, so that they are built once and
+   *  searched many times, with any divergence. The tree is only read by
+   *  searches, so one index may be searched from several threads at once.
+   * -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+  */
+  struct bann_index {
+    int dim;                          // dimension of points
+    bann_idx nData;                   // number of data points
+    ann_namespace::ANNpointArray pts; // data points
+    ann_namespace::ANNkd_tree *tree;  // kd-tree over pts
+    bool own;                         // are the coordinates ours?
+    bool mapped;                      // tree maps a file holding pts?
+    int *perm;                        // coordinate order of pts, or NULL
+    ann_namespace::ANNkd_replicas *repl; // per-node replicas, tree is the first; or NULL
+  };
+
+  /* Divergence component for a Hausdorff search with DivChoice, in the
+   *  reversed direction used by bann_haus. Empty if DivChoice is unknown.
+  */
+  static ann_namespace::divergence haus_divergence(int divChoice)
+  {
+    using namespace ann_namespace;
+
+    switch (divChoice) {
+      case 0: return div_component_eucl;
+      case 1: return div_component_dkl;
+      case 2: return div_component_kl;
+      case 3: return div_component_dis;
+      case 4: return div_component_is;
+      default: return divergence();
+    }
+  }
+
+  /* An index over the data points, without its tree */
+  static bann_index *bann_index_points(double *Data, bann_idx *NData, int *Dim, long *Stride,
+                                       int *Copy)
+  {
+    using namespace ann_namespace;
+
+    bann_index *index = new bann_index;
+    index->dim = *Dim;
+    index->nData = *NData;
+    index->own = *Copy != 0;
+    index->mapped = false;
+    index->perm = NULL;
+    index->repl = NULL;
+    if (index->own) {
+      index->pts = annAllocPts(index->nData, index->dim, *Copy == 2 ? ANNtrue : ANNfalse);
+      for (bann_idx i = 0; i < index->nData; i++) {
+        for (int j = 0; j < index->dim; j++) {
+          index->pts[i][j] = Data[i * *Stride + j];
+        }
+      }
+    }
+    else {
+      index->pts = annViewPts(Data, index->nData, *Stride);
+    }
+    return index;
+  }
+
+  /* Queries in the coordinate order of an index
+   *  The points of an index built along a coordinate subset hold their
+   *  coordinates in the order Index->perm. Returns the NQuery rows of
+   *  Query reordered alike in Buf, or Query itself for other indexes.
+  */
+  static double *bann_index_queries(bann_index *Index, const double *Query, bann_idx NQuery,
+                                    std::vector<double> &Buf)
+  {
+    if (Index->perm == NULL) {
+      return const_cast<double *>(Query);
+    }
+    const int dim = Index->dim;
+    Buf.resize((size_t) NQuery * dim);
+    for (bann_idx i = 0; i < NQuery; i++) {
+      for (int j = 0; j < dim; j++) {
+        Buf[i * dim + j] = Query[i * dim + Index->perm[j]];
+      }
+    }
+    return Buf.data();
+  }
+
+  /* Build an index over the data points.
+   *  Point i starts at Data[i * Stride] and has Dim consecutive coordinates.
+   *  If Copy is zero the points are used in place, and the caller must keep
+   *  Data alive and unchanged until the index is freed; otherwise they are
+   *  copied into aligned storage of the index, with each row padded to
+   *  annRowStride(Dim) coordinates if Copy is 2. Split is the ANNsplitRule of
+   *  the kd-tree.
+   *  Returns the index, to be released with bann_index_free.
+  */
+  bann_index *bann_index_build(double *Data, bann_idx *NData, int *Dim, long *Stride, int *Copy,
+                               int *Split)
+  {
+    using namespace ann_namespace;
+
+    bann_index *index = bann_index_points(Data, NData, Dim, Stride, Copy);
+    index->tree = new ANNkd_tree(index->pts, index->nData, index->dim, 1, (ANNsplitRule) *Split);
+    return index;
+  }
+
+  /* Build an index replicated per NUMA node
+   *  As bann_index_build, with one copy of the points and kd-tree per node
+   *  (see ANNkd_replicas): NNodes replicas, or one per NUMA node of the
+   *  machine if NNodes is 0. A single replica is built over the points of
+   *  the index; several are always copies, each built on its node, and
+   *  padded if Copy is 2. Searches with bann_index_search run each worker
+   *  on the node of its replica; the other searches use the first.
+  */
+  bann_index *bann_index_build_numa(double *Data, bann_idx *NData, int *Dim, long *Stride,
+                                    int *Copy, int *Split, int *NNodes)
+  {
+    using namespace ann_namespace;
+
+    int view = 0;                       // the replicas copy the points
+    bann_index *index = bann_index_points(Data, NData, Dim, Stride, &view);
+    index->repl = new ANNkd_replicas(index->pts, index->nData, index->dim, 1,
+                                     (ANNsplitRule) *Split, *NNodes, (ANNbool) (*Copy != 0),
+                                     (ANNbool) (*Copy == 2));
+    index->tree = index->repl->replicaTree(0);
+    return index;
+  }
+
+  /* Replicas of an index
+   *  Returns the number of replicas of an index built by
+   *  bann_index_build_numa, or 0. For each replica, stores the NUMA node
+   *  holding it (-1 if none) in ReplNode and the number of queries it has
+   *  served in Served, and in Simulated whether the node count was given.
+  */
+  int bann_index_replicas(bann_index *Index, int *ReplNode, bann_idx *Served, int *Simulated)
+  {
+    if (Index->repl == NULL) {
+      *Simulated = 0;
+      return 0;
+    }
+    const int nRepl = Index->repl->nReplicas();
+    for (int r = 0; r < nRepl; r++) {
+      if (ReplNode != NULL) ReplNode[r] = Index->repl->replicaNode(r);
+      if (Served != NULL) Served[r] = Index->repl->replicaServed(r);
+    }
+    *Simulated = Index->repl->isSimulated();
+    return nRepl;
+  }
+
+  /* Build an index for a query workload
+   *  As bann_index_build, with the kd-tree built for the NQuery sample
+   *  queries at Query, searched for their K nearest neighbours with
+   *  DivChoice as for bann_search (see kd_workload.cpp). Leaves hold at
+   *  most MaxBucket points. Returns NULL if DivChoice is invalid.
+  */
+  bann_index *bann_index_build_workload(double *Data, bann_idx *NData, int *Dim, long *Stride,
+                                        int *Copy, double *Query, bann_idx *NQuery, int *K,
+                                        int *DivChoice, int *MaxBucket)
+  {
+    using namespace ann_namespace;
+
+    divergence div = knn_divergence(*DivChoice);
+    if (!div) {
+      std::cerr << "Directive: "<< *DivChoice << "\n";
+      return NULL;
+    }
+
+    bann_index *index = bann_index_points(Data, NData, Dim, Stride, Copy);
+    ANNpointArray queries = annViewPts(Query, *NQuery, *Dim);
+    index->tree = new ANNkd_tree(index->pts, index->nData, index->dim, div,
+                                 queries, *NQuery, *K, *MaxBucket);
+    annDeallocViewPts(queries);
+    return index;
+  }
+
+  /* Order the coordinates of the data points for a subset index
+   *  Stores in Rank the Dim coordinates by decreasing spread of the points
+   *  if DivChoice is -1, and otherwise by decreasing mean divergence, with
+   *  DivChoice as for bann_search, between sample pairs of points (see
+   *  annRankDims). Returns 0, or -1 if DivChoice is invalid.
+  */
+  int bann_rank_dims(double *Data, bann_idx *NData, int *Dim, long *Stride, int *DivChoice,
+                     int *Rank)
+  {
+    using namespace ann_namespace;
+
+    divergence div = *DivChoice == -1 ? divergence() : knn_divergence(*DivChoice);
+    if (*DivChoice != -1 && !div) {
+      return -1;
+    }
+    ANNpointArray pts = annViewPts(Data, *NData, *Stride);
+    annRankDims(pts, *NData, *Dim, div, Rank);
+    annDeallocViewPts(pts);
+    return 0;
+  }
+
+  /* Build an index along a subset of the coordinates
+   *  As bann_index_build, with the points always copied and their
+   *  coordinates stored in the order Order, a permutation of 0..Dim-1.
+   *  The kd-tree cuts along the first NDims of them only (see
+   *  kd_subspace.cpp), into leaves of at most MaxBucket points, and the
+   *  leaves compare queries with their points in that order, so that the
+   *  comparison with a far point stops after its first coordinates.
+   *  Queries are reordered alike by the searches.
+  */
+  bann_index *bann_index_build_subspace(double *Data, bann_idx *NData, int *Dim, long *Stride,
+                                        int *Order, int *NDims, int *MaxBucket)
+  {
+    using namespace ann_namespace;
+
+    const int dim = *Dim;
+    bann_index *index = new bann_index;
+    index->dim = dim;
+    index->nData = *NData;
+    index->own = true;
+    index->mapped = false;
+    index->repl = NULL;
+    index->perm = new int[dim];
+    for (int j = 0; j < dim; j++) {
+      index->perm[j] = Order[j];
+    }
+    index->pts = annAllocPts(index->nData, dim);
+    for (bann_idx i = 0; i < index->nData; i++) {
+      for (int j = 0; j < dim; j++) {
+        index->pts[i][j] = Data[i * *Stride + Order[j]];
+      }
+    }
+    std::vector<int> dims(*NDims);      // leading coordinates
+    for (int j = 0; j < *NDims; j++) {
+      dims[j] = j;
+    }
+    index->tree = new ANNkd_tree(index->pts, index->nData, dim, dims.data(), *NDims, *MaxBucket);
+    return index;
+  }
+
+  void bann_index_free(bann_index *Index)
+  {
+    using namespace ann_namespace;
+
+    if (Index->repl != NULL) {          // the replicas own the tree
+      delete Index->repl;
+    }
+    else {
+      delete Index->tree;               // a mapped tree releases its points
+    }
+    if (Index->own) {
+      annDeallocPts(Index->pts);
+    }
+    else if (!Index->mapped) {
+      annDeallocViewPts(Index->pts);
+    }
+    delete [] Index->perm;
+    delete Index;
+  }
+
+  /* Save an index in the binary kd-tree format
+   *  Meta is stored with the file as build metadata, truncated to
+   *  ANN_BIN_META - 1 bytes. Returns an ANNbinStatus.
+  */
+  int bann_index_save(bann_index *Index, const char *Path, const char *Meta)
+  {
+    if (Index->perm != NULL) {          // the format has no coordinate order
+      return ann_namespace::ANN_BIN_UNSUPPORTED;
+    }
+    return Index->tree->SaveBinary(Path, Meta);
+  }
+
+  /* Publish an index in a new POSIX shared memory segment
+   *  As bann_index_save, with Name the name of the segment ("/name").
+   *  Fails with ANN_BIN_EXISTS if the segment exists already.
+  */
+  int bann_index_publish(bann_index *Index, const char *Name, const char *Meta)
+  {
+    if (Index->perm != NULL) {
+      return ann_namespace::ANN_BIN_UNSUPPORTED;
+    }
+    return Index->tree->SaveBinary(Name, Meta, ann_namespace::ANNtrue);
+  }
+
+  /* Remove the name of a shared memory segment
+   *  Indexes attached to it remain valid. Returns an ANNbinStatus.
+  */
+  int bann_unlink_shared(const char *Name)
+  {
+    return ann_namespace::annUnlinkShared(Name);
+  }
+
+  /* Load an index saved by bann_index_save or, if Shared is nonzero,
+   *  attach to the shared memory segment of bann_index_publish.
+   *  The file or segment is mapped read-only and searched in place, so all
+   *  processes attached to a segment share one copy of the points. If
+   *  Verify is nonzero the checksums of all sections are checked first.
+   *  Status is set to an ANNbinStatus; on failure NULL is returned.
+  */
+  bann_index *bann_index_load(const char *Path, int *Verify, int *Shared, int *Status)
+  {
+    using namespace ann_namespace;
+
+    ANNkd_mapped *tree = new ANNkd_mapped(Path, (ANNbool) (*Verify != 0), (ANNbool) (*Shared != 0));
+    *Status = tree->status();
+    if (*Status != ANN_BIN_OK) {
+      delete tree;
+      return NULL;
+    }
+    bann_index *index = new bann_index;
+    index->dim = tree->theDim();
+    index->nData = tree->nPoints();
+    index->pts = tree->thePoints();
+    index->tree = tree;
+    index->own = false;
+    index->mapped = true;
+    index->perm = NULL;
+    index->repl = NULL;
+    return index;
+  }
+
+  /* Build metadata of a loaded index
+   *  Copies the stored metadata string to Meta, which must hold
+   *  ANN_BIN_META bytes, and returns the build time in seconds since the
+   *  epoch. Indexes that were not loaded have no metadata and time 0.
+  */
+  long long bann_index_meta(bann_index *Index, char *Meta)
+  {
+    using namespace ann_namespace;
+
+    Meta[0] = '\0';
+    if (!Index->mapped) {
+      return 0;
+    }
+    const ANNbinHeader &hdr = ((ANNkd_mapped *) Index->tree)->header();
+    memcpy(Meta, hdr.meta, ANN_BIN_META);
+    Meta[ANN_BIN_META - 1] = '\0';
+    return hdr.build_time;
+  }
+
+  /* Search worker for bann_index_search
+   *  Searches queries [first, last) on the replica of worker Worker, pinned
+   *  to its node, or on the tree of an index without replicas.
+  */
+  static void index_worker(bann_index *Index, int worker, ann_namespace::divergence div,
+                           double *Query, bann_idx first, bann_idx last, int k, double eps,
+                           int block, int Order, bann_idx *Indx, double *Dists)
+  {
+    using namespace ann_namespace;
+
+    const int dim = Index->dim;
+    ANNkd_tree *tree = Index->repl != NULL ? Index->repl->bindWorker(worker) : Index->tree;
+    knn_blocks(tree, div, &Query[first * dim], last - first, dim, k, eps, block, Order,
+               &Indx[first * k], Dists != NULL ? &Dists[first * k] : NULL);
+    if (Index->repl != NULL) {
+      Index->repl->served(Index->repl->replicaOf(worker), last - first);
+    }
+  }
+
+  /* k-nearest neighbour search on an index
+   *  As bann_search_block, with blocks of Block consecutive queries pushed
+   *  through the tree together when Block > 1. The queries are split into
+   *  NThreads contiguous parts, searched by as many workers, each on the
+   *  node of its replica if the index has replicas. A single part of an
+   *  index without replicas is searched by the calling thread.
+  */
+  void bann_index_search(bann_index *Index, double *Query, bann_idx *NQuery, int *K,
+                         bann_idx *Indx, double *Dists, double *Eps, int *DivChoice, int *Block,
+                         int *Order, int *NThreads)
+  {
+    using namespace ann_namespace;
+
+    std::vector<double> buf;          // queries in the order of the index
+    Query = bann_index_queries(Index, Query, *NQuery, buf);
+
+    const int dim = Index->dim;
+    const bann_idx nQuery = *NQuery;
+    const int k = *K;
+    const double eps = *Eps;
+    const int block = *Block > 0 ? *Block : 1;
+
+    divergence div = knn_divergence(*DivChoice);
+    if (!div) {
+      std::cerr << "Directive: "<< *DivChoice << "\n";
+      return;
+    }
+
+    const int nThreads = *NThreads > 0 ? *NThreads : 1;
+    if (nThreads == 1 && Index->repl == NULL) {
+      knn_blocks(Index->tree, div, Query, nQuery, dim, k, eps, block, *Order, Indx, Dists);
+      return;
+    }
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < nThreads; w++) {
+      bann_idx first = (bann_idx) ((long long) nQuery * w / nThreads);
+      bann_idx last = (bann_idx) ((long long) nQuery * (w + 1) / nThreads);
+      workers.emplace_back(index_worker, Index, w, div, Query, first, last, k, eps, block,
+                           *Order, Indx, Dists);
+    }
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+  }
+
+  /* Seeded k-nearest neighbour search on an index
+   *  As bann_index_search, with each query first compared against
+   *  candidate index points (see annkSearchSeeded): query i against
+   *  Seeds[i * NSeeds ... i * NSeeds + NSeeds - 1], where entries outside
+   *  the index (e.g. -1) are ignored, and if Chain is nonzero also against
+   *  the neighbours just found for query i - 1.
+  */
+  void bann_index_search_seeded(bann_index *Index, double *Query, bann_idx *NQuery, int *K,
+                                bann_idx *Seeds, int *NSeeds, int *Chain, bann_idx *Indx,
+                                double *Dists, double *Eps, int *DivChoice)
+  {
+    using namespace ann_namespace;
+
+    std::vector<double> buf;          // queries in the order of the index
+    Query = bann_index_queries(Index, Query, *NQuery, buf);
+
+    const int dim = Index->dim;
+    const bann_idx nQuery = *NQuery;
+    const int k = *K;
+    const int nSeeds = Seeds != NULL && *NSeeds > 0 ? *NSeeds : 0;
+    const double eps = *Eps;
+
+    divergence div = knn_divergence(*DivChoice);
+    if (!div) {
+      std::cerr << "Directive: "<< *DivChoice << "\n";
+      return;
+    }
+
+    ANNidxArray seeds = new ANNidx[nSeeds + k];
+    ANNdistArray divs = new ANNdist[k];
+    for (bann_idx i = 0; i < nQuery; i++) {
+      int n = 0;
+      for (int j = 0; j < nSeeds; j++) {
+        seeds[n++] = Seeds[i * nSeeds + j];
+      }
+      if (*Chain != 0 && i > 0) {
+        for (int j = 0; j < k; j++) {
+          seeds[n++] = Indx[(i - 1) * k + j];
+        }
+      }
+      Index->tree->annkSearchSeeded(div, &Query[i * dim], k, seeds, n, &Indx[i * k], divs, eps);
+      if (Dists != NULL) {
+        for (int j = 0; j < k; j++) {
+          Dists[i * k + j] = divs[j];
+        }
+      }
+    }
+    delete [] seeds;
+    delete [] divs;
+  }
+
+  /* k-nearest neighbour search on an index with a budget per query
+   *  As bann_index_search without blocks, by the standard search, or by the
+   *  priority (best-first) search annkPriSearch if Priority is nonzero.
+   *  Each query stops once it has visited MaxPts points or MaxLeaves
+   *  leaves or taken MaxTime seconds (0 for no limit, see annSearchBudget),
+   *  and Truncated[i] is set to 1 if query i was stopped, 0 if it completed.
+   *  A stopped query returns the closest points found, with ANN_NULL_IDX
+   *  at divergence ANN_DIST_INF for any it did not reach.
+  */
+  void bann_index_search_budget(bann_index *Index, double *Query, bann_idx *NQuery, int *K,
+                                bann_idx *Indx, double *Dists, double *Eps, int *DivChoice,
+                                int *Priority, int *MaxPts, int *MaxLeaves, double *MaxTime,
+                                unsigned char *Truncated)
+  {
+    using namespace ann_namespace;
+
+    std::vector<double> buf;          // queries in the order of the index
+    Query = bann_index_queries(Index, Query, *NQuery, buf);
+
+    const int dim = Index->dim;
+    const bann_idx nQuery = *NQuery;
+    const int k = *K;
+    const double eps = *Eps;
+
+    divergence div = knn_divergence(*DivChoice);
+    if (!div) {
+      std::cerr << "Directive: "<< *DivChoice << "\n";
+      return;
+    }
+
+    ANNdistArray divs = new ANNdist[k];
+    annSearchBudget(*MaxPts, *MaxLeaves, *MaxTime);
+    for (bann_idx i = 0; i < nQuery; i++) {
+      if (*Priority != 0) {
+        Index->tree->annkPriSearch(div, &Query[i * dim], k, &Indx[i * k], divs, eps);
+      }
+      else {
+        Index->tree->annkSearch(div, &Query[i * dim], k, &Indx[i * k], divs, eps);
+      }
+      Truncated[i] = annSearchTruncated() ? 1 : 0;
+      if (Dists != NULL) {
+        for (int j = 0; j < k; j++) {
+          Dists[i * k + j] = divs[j];
+        }
+      }
+    }
+    annSearchBudget(0, 0, 0);           // budgets are per thread; leave none set
+    delete [] divs;
+  }
+
+  /* Dual-tree k-nearest neighbour search on an index
+   *  As bann_search_dual, with the index as the data tree.
+  */
+  void bann_index_search_dual(bann_index *Index, double *Query, bann_idx *NQuery, int *K,
+                              bann_idx *Indx, double *Dists, double *Eps, int *DivChoice)
+  {
+    using namespace ann_namespace;
+
+    std::vector<double> buf;          // queries in the order of the index
+    Query = bann_index_queries(Index, Query, *NQuery, buf);
+
+    divergence div = knn_divergence(*DivChoice);
+    if (!div) {
+      std::cerr << "Directive: "<< *DivChoice << "\n";
+      return;
+    }
+
+    knn_dual(Index->tree, div, Query, *NQuery, Index->dim, *K, *Eps, Indx, Dists);
+  }
+
+  /* Bregman--Hausdorff divergence from the query points to the index points
+   *  As bann_haus with P the indexed points. If Lower is not NULL, it is
+   *  a divergence already reached, e.g. by earlier chunks of a query set:
+   *  it is used as the starting threshold of the searches, and the result
+   *  is the larger of it and the divergence of these query points.
+  */
+  double bann_index_haus(bann_index *Index, double *Query, bann_idx *NQuery, double *Eps,
+                         int *DivChoice, double *NNDists, double *Lower)
+  {
+    using namespace ann_namespace;
+
+    std::vector<double> buf;          // queries in the order of the index
+    Query = bann_index_queries(Index, Query, *NQuery, buf);
+
+    const int dim = Index->dim;
+    const bann_idx nQ = *NQuery;
+    const double eps = *Eps;
+
+    divergence div = haus_divergence(*DivChoice);
+    if (!div) {
+      std::cerr << "Directive: " << *DivChoice << "\n";
+      return 0.0;
+    }
+
+    ANNidx nnIdx[1];
+    ANNdist divs[1];
+    double hausdorff = Lower != NULL ? *Lower : 0.0;
+    for (bann_idx i = 0; i < nQ; i++) {
+      Index->tree->annhSearch(div, &Query[i * dim], nnIdx, divs, eps,
+                              NNDists != NULL ? 0.0 : hausdorff);
+      if (NNDists != NULL) {
+        NNDists[i] = divs[0];
+      }
+      if (hausdorff < divs[0]) {
+        hausdorff = divs[0];
+      }
+    }
+    return hausdorff;
+  }
+
+  /* Points in range of a set of queries, from bann_index_range_all */
+  struct bann_range_result {
+    std::vector<ann_namespace::ANNidx> indx;  // indices, query after query
+    std::vector<ann_namespace::ANNdist> dists; // their divergences
+  };
+
+  /* Fixed-radius search on an index reporting all points in range
+   *  Finds, in one pass per query (see annRangeSearch), the index points
+   *  within divergence Radii[i] of query i, or Radii[0] of every query if
+   *  NRadii is 1. If Sorted is nonzero the points of each query are sorted
+   *  closest first. The points of query i are entries Offsets[i] to
+   *  Offsets[i + 1] - 1 of the result, which is copied out with
+   *  bann_range_result_copy and released with bann_range_result_free.
+   *  Returns NULL, leaving Offsets unset, if DivChoice is invalid.
+  */
+  bann_range_result *bann_index_range_all(bann_index *Index, double *Query, bann_idx *NQuery,
+                                   double *Radii, bann_idx *NRadii, double *Eps, int *DivChoice,
+                                   int *Sorted, bann_idx *Offsets)
+  {
+    using namespace ann_namespace;
+
+    std::vector<double> buf;          // queries in the order of the index
+    Query = bann_index_queries(Index, Query, *NQuery, buf);
+
+    const int dim = Index->dim;
+    const bann_idx nQuery = *NQuery;
+
+    divergence div = knn_divergence(*DivChoice);
+    if (!div) {
+      std::cerr << "Directive: "<< *DivChoice << "\n";
+      return NULL;
+    }
+
+    bann_range_result *range = new bann_range_result;
+    Offsets[0] = 0;
+    for (bann_idx i = 0; i < nQuery; i++) {
+      double radius = Radii[*NRadii == 1 ? 0 : i];
+      Index->tree->annRangeSearch(div, &Query[i * dim], radius, range->indx, range->dists,
+                                  (ANNbool) (*Sorted != 0), *Eps);
+      Offsets[i + 1] = (bann_idx) range->indx.size();
+    }
+    return range;
+  }
+
+  /* Copies the indices, and the divergences unless Dists is NULL */
+  void bann_range_result_copy(const bann_range_result *Range, bann_idx *Indx, double *Dists)
+  {
+    if (Range != NULL && !Range->indx.empty()) {
+      memcpy(Indx, Range->indx.data(), Range->indx.size() * sizeof(bann_idx));
+      if (Dists != NULL) {
+        memcpy(Dists, Range->dists.data(), Range->dists.size() * sizeof(double));
+      }
+    }
+  }
+
+  void bann_range_result_free(bann_range_result *Range)
+  {
+    delete Range;
+  }
+
+  /* Number of index points in range of each query
+   *  Counts[i] is set to the number of index points within divergence
+   *  Radii[i] of query i, or Radii[0] of every query if NRadii is 1,
+   *  without listing them (see annRangeCount).
+  */
+  void bann_index_range_count(bann_index *Index, double *Query, bann_idx *NQuery,
+                              double *Radii, bann_idx *NRadii, double *Eps, int *DivChoice,
+                              bann_idx *Counts)
+  {
+    using namespace ann_namespace;
+
+    std::vector<double> buf;          // queries in the order of the index
+    Query = bann_index_queries(Index, Query, *NQuery, buf);
+
+    const int dim = Index->dim;
+    const bann_idx nQuery = *NQuery;
+
+    divergence div = knn_divergence(*DivChoice);
+    if (!div) {
+      std::cerr << "Directive: "<< *DivChoice << "\n";
+      return;
+    }
+
+    for (bann_idx i = 0; i < nQuery; i++) {
+      double radius = Radii[*NRadii == 1 ? 0 : i];
+      Counts[i] = Index->tree->annRangeCount(div, &Query[i * dim], radius, *Eps);
+    }
+  }
+
+  /* Tree statistics of an index
+   *  Stats holds dim, n_pts, bkt_size, n_lf, n_tl, n_spl, n_shr and depth,
+   *  and AvgAR the average aspect ratio of the leaves.
+  */
+  void bann_index_stats(bann_index *Index, bann_idx *Stats, double *AvgAR)
+  {
+    using namespace ann_namespace;
+
+    ANNkdStats st;
+    Index->tree->getStats(st);
+    Stats[0] = st.dim;
+    Stats[1] = st.n_pts;
+    Stats[2] = st.bkt_size;
+    Stats[3] = st.n_lf;
+    Stats[4] = st.n_tl;
+    Stats[5] = st.n_spl;
+    Stats[6] = st.n_shr;
+    Stats[7] = st.depth;
+    *AvgAR = st.avg_ar;
+  }
+
+  /* How the tree of an index was built
+   *  Stores in Split the ANNsplitRule of a tree built by a splitting rule,
+   *  or -1, and returns its ANNbuildKind. Indexes loaded from a file
+   *  report those recorded by the writer.
+  */
+  int bann_index_build_info(bann_index *Index, int *Split)
+  {
+    *Split = Index->tree->splitRule();
+    return Index->tree->buildKind();
+  }
+
+  /* Single query entry points
+   *  For compiled loops (e.g. Numba or Cython) that search one query at a
+   *  time: scalars are passed by value, nothing is allocated for K <= 32,
+   *  and the search state is per thread, so they may be called from any
+   *  number of threads at once.
+   *
+   *  bann_index_knn1 stores the indices of the K nearest index points to
+   *  Query in Indx and, if Dists is not NULL, their divergences in Dists,
+   *  with DivChoice as for bann_search. Returns 0, or -1 if DivChoice or K
+   *  is invalid.
+  */
+  int bann_index_knn1(bann_index *Index, const double *Query, int K, int DivChoice,
+                      double Eps, bann_idx *Indx, double *Dists)
+  {
+    using namespace ann_namespace;
+
+    static thread_local std::vector<double> buf;
+    Query = bann_index_queries(Index, Query, 1, buf);
+
+    divergence div = knn_divergence(DivChoice);
+    if (!div || K <= 0 || K > Index->nData) {
+      return -1;
+    }
+    ANNdist local[32];
+    ANNdistArray divs = Dists != NULL ? Dists : (K <= 32 ? local : new ANNdist[K]);
+    Index->tree->annkSearch(div, (ANNpoint) Query, K, Indx, divs, Eps);
+    if (divs != Dists && divs != local) {
+      delete [] divs;
+    }
+    return 0;
+  }
+
+  /* Hausdorff step for one query point, with DivChoice as for bann_haus
+   *  Returns the divergence of Query from its nearest index point, except
+   *  that the search stops early once a point within Threshold is found,
+   *  and then some value no larger than Threshold is returned. Keeping
+   *  the maximum of the results over a query set, passed back in as
+   *  Threshold, gives its Hausdorff divergence. Returns -1 if DivChoice
+   *  is invalid.
+  */
+  double bann_index_haus1(bann_index *Index, const double *Query, int DivChoice,
+                          double Eps, double Threshold)
+  {
+    using namespace ann_namespace;
+
+    static thread_local std::vector<double> buf;
+    Query = bann_index_queries(Index, Query, 1, buf);
+
+    divergence div = haus_divergence(DivChoice);
+    if (!div) {
+      return -1.0;
+    }
+    ANNidx nnIdx[1];
+    ANNdist divs[1];
+    Index->tree->annhSearch(div, (ANNpoint) Query, nnIdx, divs, Eps, Threshold);
+    return divs[0];
+  }
+
   /* -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
    * Timing functions 
    *  Repeat the functions above but with timings for each.
@@ -309,14 +1219,14 @@ extern "C" {
       return std::chrono::system_clock::now();
    }
 
-   void timed_search(double *Data, int *NData, double *Query, int *NQuery, int *Dim,
-                   int *K, int *Indx, double *Eps, int *DivChoice)
+   void timed_search(double *Data, bann_idx *NData, double *Query, bann_idx *NQuery, int *Dim,
+                   int *K, bann_idx *Indx, double *Eps, int *DivChoice)
    {
       using namespace ann_namespace;
 
     const int dim = *Dim;
-    const int nData = *NData;
-    const int nQuery = *NQuery;
+    const bann_idx nData = *NData;
+    const bann_idx nQuery = *NQuery;
     const int k = *K;
     const double eps = *Eps;
     const int divChoice = *DivChoice;
@@ -327,13 +1237,13 @@ extern "C" {
     ANNidxArray nnIdx = new ANNidx[k];
     ANNdistArray divs = new ANNdist[k];
 
-    int ptr = 0;
+    bann_idx ptr = 0;
     /* Read in data points.
      *  Data is input as a contiguous block, passed in row-major order.
      */
     std::chrono::time_point<std::chrono::system_clock> phase_1, phase_2;
     phase_1 = std::chrono::system_clock::now();
-    for (int i = 0; i < nData; i++) {
+    for (bann_idx i = 0; i < nData; i++) {
       for (int j = 0; j < dim; j++) {
         dataPts[i][j] = Data[i * dim + j];
       }
@@ -346,7 +1256,7 @@ extern "C" {
     /* Read in query points
      *  Query is input as a contiguous block, passed in row-major order.
     */
-    for (int i = 0; i < nQuery; i++) {
+    for (bann_idx i = 0; i < nQuery; i++) {
       for (int j = 0; j < dim; j++) {
         queryPts[i][j] = Query[i * dim + j];
       }
@@ -358,7 +1268,7 @@ extern "C" {
     */
     switch (divChoice) {
       case 0: // Euclidean search
-        for (int i = 0; i < nQuery; i++) {
+        for (bann_idx i = 0; i < nQuery; i++) {
           tree->annkSearch(
             div_component_eucl,
             queryPts[i],
@@ -372,7 +1282,7 @@ extern "C" {
         }
         break;
       case 1: // KL search
-        for (int i = 0; i < nQuery; i++) {
+        for (bann_idx i = 0; i < nQuery; i++) {
           tree->annkSearch(
             div_component_kl,
             queryPts[i],
@@ -386,7 +1296,7 @@ extern "C" {
         }
         break;
       case 2: // DKL search
-        for (int i = 0; i < nQuery; i++) {
+        for (bann_idx i = 0; i < nQuery; i++) {
           tree->annkSearch(
             div_component_dkl,
             queryPts[i],
@@ -400,7 +1310,7 @@ extern "C" {
         }
         break;
       case 3: // IS search
-        for (int i = 0; i < nQuery; i++) {
+        for (bann_idx i = 0; i < nQuery; i++) {
           tree->annkSearch(
             div_component_is,
             queryPts[i],
@@ -414,7 +1324,7 @@ extern "C" {
         }
         break;
       case 4: // DIS search
-        for (int i = 0; i < nQuery; i++) {
+        for (bann_idx i = 0; i < nQuery; i++) {
           tree->annkSearch(
             div_component_dis,
             queryPts[i],
@@ -438,14 +1348,14 @@ extern "C" {
     delete [] nnIdx;
     delete [] divs;
   }
-   double timed_haus(double *Data, int *NData, double *Query, int *NQuery, int *Dim,
+   double timed_haus(double *Data, bann_idx *NData, double *Query, bann_idx *NQuery, int *Dim,
         double *Eps, int*DivChoice)
    {
       using namespace ann_namespace;
 
       const int dim = *Dim;
-      const int nData = *NData;
-      const int nQ = *NQuery;
+      const bann_idx nData = *NData;
+      const bann_idx nQ = *NQuery;
       const double eps = *Eps;
       const int divChoice = *DivChoice;
 
@@ -462,7 +1372,7 @@ extern "C" {
        phase_1 = std::chrono::system_clock::now();
       /* Read in Data pts, and build the kd_tree
        * */
-      for (int i = 0; i < nData; i++) {
+      for (bann_idx i = 0; i < nData; i++) {
          for (int j = 0; j < dim; j++) {
             dataPts[i][j] = Data[i * dim + j];
          }
@@ -473,7 +1383,7 @@ extern "C" {
       phase_2 = print_time(phase_2, phase_1, "Build tree");
       /* Read in Query points
        * */
-      for (int i = 0; i < nQ; i++) {
+      for (bann_idx i = 0; i < nQ; i++) {
          for (int j = 0; j < dim; j++) {
             queryPts[i][j] = Query[i * dim + j];
          }
@@ -481,7 +1391,7 @@ extern "C" {
       phase_1 = print_time(phase_1, phase_2, "read query");
       switch (divChoice) {
          case 0: // (squared) Euclidean search
-            for (int i = 0; i < nQ; i++) {
+            for (bann_idx i = 0; i < nQ; i++) {
                tree->annhSearch(
                      div_component_eucl,
                      queryPts[i],
@@ -495,7 +1405,7 @@ extern "C" {
             }
             break;
          case 1: // H_{KL}(P||Q)
-            for (int i = 0; i < nQ; i++) {
+            for (bann_idx i = 0; i < nQ; i++) {
                tree->annhSearch(
                   div_component_dkl,
                   queryPts[i],
@@ -509,7 +1419,7 @@ extern "C" {
             }
             break;
          case 2: // H'_{KL}(P||Q)
-            for (int i = 0; i < nQ; i++) {
+            for (bann_idx i = 0; i < nQ; i++) {
                tree->annhSearch(
                   div_component_kl,
                   queryPts[i],
@@ -523,7 +1433,7 @@ extern "C" {
             }
             break;
          case 3: // H_{IS}(P||Q)
-            for (int i = 0; i < nQ; i++) {
+            for (bann_idx i = 0; i < nQ; i++) {
                tree->annhSearch(
                   div_component_dis,
                   queryPts[i],
@@ -537,7 +1447,7 @@ extern "C" {
             }
             break;
          case 4: // H'_{IS}(P||Q)
-            for (int i = 0; i < nQ; i++) {
+            for (bann_idx i = 0; i < nQ; i++) {
                tree->annhSearch(
                   div_component_is,
                   queryPts[i],
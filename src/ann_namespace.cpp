@@ -1,8 +1,31 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
+#include <ctime>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#ifdef __linux__
+  #include <fcntl.h>
+  #include <pthread.h>
+  #include <sched.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
 
 namespace ann_namespace {
   #include "cpp_src/ANN.cpp"
@@ -14,11 +37,18 @@ namespace ann_namespace {
   #include "cpp_src/divergence_config.h"
   #include "cpp_src/kd_dump.cpp"
   #include "cpp_src/kd_search.cpp"
+  #include "cpp_src/kd_block_search.cpp"
+  #include "cpp_src/kd_dual_search.cpp"
   #include "cpp_src/kd_split.cpp"
   #include "cpp_src/kd_tree.cpp"
+  #include "cpp_src/kd_lazy.cpp"
   #include "cpp_src/kd_util.cpp"
   #include "cpp_src/kd_fix_rad_search.cpp"
+  #include "cpp_src/kd_workload.cpp"
+  #include "cpp_src/kd_subspace.cpp"
   #include "cpp_src/kd_pr_search.cpp"
   #include "cpp_src/kd_haus.cpp"
+  #include "cpp_src/kd_numa.cpp"
+  #include "cpp_src/kd_binary.cpp"
 //  #include "cpp_src/ann_brute.cpp"
 }
@@ -0,0 +1,158 @@
+/* bann.h
+ *  C interface of the BANN library, for programs that link against it
+ *  directly rather than through the Python module.
+ *
+ *  An index is created once over a set of data points, or opened from a
+ *  file or shared memory segment written by bann_save / bann_publish
+ *  (or by the save and publish methods of bann.Index), searched any number
+ *  of times with any divergence, and destroyed.
+ *
+ *  Thread safety: searches only read an index, and the search state is
+ *  kept per thread, so any number of threads may search one index at
+ *  once. An index must not be destroyed while it is being searched.
+ *
+ *  Points are rows of dim consecutive doubles. Point indices are of type
+ *  bann_idx, which is 64-bit if the library is built with ANN_IDX64;
+ *  programs must be compiled with the same setting, which they can check
+ *  against bann_idx_size().
+ *
+ *  Functions returning int return BANN_OK or an error code.
+ */
+#ifndef BANN_H
+#define BANN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BANN_API_VERSION 2
+
+#ifdef ANN_IDX64
+typedef long long bann_idx;
+#else
+typedef int bann_idx;
+#endif
+
+typedef struct bann_index bann_index;
+typedef struct bann_range_result bann_range_result;
+
+/* Divergences, for searches in the direction of bann_knn */
+enum bann_div {
+  BANN_SE  = 0,                       /* squared Euclidean distance */
+  BANN_KL  = 1,                       /* Kullback--Leibler divergence */
+  BANN_DKL = 2,                       /* reverse KL divergence */
+  BANN_IS  = 3,                       /* Itakura--Saito divergence */
+  BANN_DIS = 4                        /* reverse IS divergence */
+};
+
+/* Error codes; 1 to 5 are those of loading and saving index files */
+enum bann_status {
+  BANN_OK          = 0,               /* success */
+  BANN_EIO         = 1,               /* file cannot be opened, read or written */
+  BANN_EFORMAT     = 2,               /* not a compatible index file */
+  BANN_ECHECKSUM   = 3,               /* file does not match its checksums */
+  BANN_EUNSUPPORTED = 4,              /* not supported on this platform */
+  BANN_EEXISTS     = 5,               /* shared memory segment exists already */
+  BANN_EINVAL      = 6                /* invalid argument */
+};
+
+/* Storage of the points of bann_create */
+enum bann_copy {
+  BANN_IN_PLACE    = 0,               /* search the caller's points */
+  BANN_COPY        = 1,               /* copy them, rows dim coordinates apart */
+  BANN_COPY_PADDED = 2                /* copy them, rows padded to SIMD boundaries */
+};
+
+/* Statistics of the kd-tree of an index */
+typedef struct bann_stats {
+  int dim;                            /* dimension of points */
+  bann_idx n_pts;                     /* number of points */
+  int bkt_size;                       /* bucket size */
+  bann_idx n_lf;                      /* number of leaves */
+  bann_idx n_tl;                      /* number of trivial (empty) leaves */
+  bann_idx n_spl;                     /* number of splitting nodes */
+  bann_idx n_shr;                     /* number of shrinking nodes */
+  int depth;                          /* depth of the tree */
+  double avg_ar;                      /* average aspect ratio of leaves */
+} bann_stats;
+
+int bann_api_version(void);           /* BANN_API_VERSION of the library */
+int bann_idx_size(void);              /* sizeof(bann_idx) of the library */
+
+/* Create an index over n points of dimension dim, point i starting at
+ *  data[i * stride]. If copy is BANN_IN_PLACE the points are searched in
+ *  place and must stay alive and unchanged until the index is destroyed;
+ *  otherwise they are copied, as copy says. On failure NULL is returned, and the error code is
+ *  stored in *status if status is not NULL.
+ */
+bann_index *bann_create(const double *data, bann_idx n, int dim, long stride, int copy,
+                        int *status);
+
+/* Open an index file, mapped read-only and searched in place, or with
+ *  bann_attach the shared memory segment "/name" of bann_publish. If
+ *  verify is nonzero the checksums are checked first.
+ */
+bann_index *bann_open(const char *path, int verify, int *status);
+bann_index *bann_attach(const char *name, int verify, int *status);
+
+/* Write an index to a file, or to a new shared memory segment, with meta
+ *  (at most 255 bytes, or NULL) stored as its metadata.
+ */
+int bann_save(const bann_index *index, const char *path, const char *meta);
+int bann_publish(const bann_index *index, const char *name, const char *meta);
+
+void bann_destroy(bann_index *index);
+
+int bann_dim(const bann_index *index);
+bann_idx bann_size(const bann_index *index);
+
+/* k-nearest neighbours of nq query points
+ *  The indices of the k nearest index points of query i, closest first,
+ *  are stored in indices[i * k ... i * k + k - 1], and their divergences
+ *  in dists at the same positions unless dists is NULL.
+ */
+int bann_knn(const bann_index *index, const double *queries, bann_idx nq, int k,
+             int div, double eps, bann_idx *indices, double *dists);
+
+/* (1+eps)-approximate Bregman--Hausdorff divergence from the query points
+ *  to the index points, stored in *result. div is taken in the reversed
+ *  direction of computation of bann.bhaus, so that bann_hausdorff with the
+ *  index over P equals bann.bhaus(P, queries, eps, div). If nn_dists is
+ *  not NULL, the divergence of each query point from its nearest index
+ *  point is stored there.
+ */
+int bann_hausdorff(const bann_index *index, const double *queries, bann_idx nq, int div,
+                   double eps, double *result, double *nn_dists);
+
+/* Fixed-radius search
+ *  counts[i] is set to the number of index points within divergence
+ *  radius of query i. If indices is not NULL the indices of those points
+ *  are then stored consecutively, closest first, query after query, so it
+ *  must hold the sum of the counts (e.g. from a first call without it).
+ */
+int bann_range(const bann_index *index, const double *queries, bann_idx nq, double radius,
+               int div, double eps, bann_idx *counts, bann_idx *indices);
+
+/* Fixed-radius search in one pass
+ *  Finds the index points within divergence radii[i] of query i, or
+ *  radii[0] of every query if nradii is 1, searching each query once, so
+ *  the cost is linear in the number of points found. If sorted is nonzero
+ *  the points of each query are sorted closest first. The points of query
+ *  i are entries offsets[i] to offsets[i + 1] - 1 (offsets holds nq + 1
+ *  entries) of *result, whose indices, and divergences unless dists is
+ *  NULL, are copied out with bann_range_result_copy. The result must be
+ *  released with bann_range_result_free.
+ */
+int bann_range_all(const bann_index *index, const double *queries, bann_idx nq,
+                   const double *radii, bann_idx nradii, int div, double eps, int sorted,
+                   bann_idx *offsets, bann_range_result **result);
+void bann_range_result_copy(const bann_range_result *result, bann_idx *indices, double *dists);
+void bann_range_result_free(bann_range_result *result);
+
+int bann_get_stats(const bann_index *index, bann_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,20 +1,140 @@
 import numpy
 cimport numpy
+import asyncio
+import ctypes
+import json
+import os
+import threading
+import time
+from collections import deque
+from concurrent.futures import Future, ThreadPoolExecutor
 
-cdef extern from "ann_call.cpp":
-    void bann_search(double *Data, int *NData, double *Query, int *NQuery, int *Dim,
-                     int *K, int *Indx, double *Eps, int *DivChoice)
-    void timed_search(double *Data, int *NData, double *Query, int *NQuery, int *Dim,
-                     int *K, int *Indx, double *Eps, int *DivChoice)
-    double bann_haus(double *Data, int *NData, double *Query, int *NQuery, int *Dim,
+# The C++ entry points only touch the buffers passed to them and per-thread search state,
+# so they are declared nogil and called with the GIL released.
+cdef extern from "ann_call.cpp" nogil:
+    ctypedef long long bann_idx
+    void bann_search(double *Data, bann_idx *NData, double *Query, bann_idx *NQuery, int *Dim,
+                     int *K, bann_idx *Indx, double *Dists, double *Eps, int *DivChoice, int *Lazy)
+    void bann_search_block(double *Data, bann_idx *NData, double *Query, bann_idx *NQuery, int *Dim,
+                     int *K, bann_idx *Indx, double *Dists, double *Eps, int *DivChoice, int *Block,
+                     int *Order, int *Lazy)
+    void bann_search_dual(double *Data, bann_idx *NData, double *Query, bann_idx *NQuery, int *Dim,
+                     int *K, bann_idx *Indx, double *Dists, double *Eps, int *DivChoice)
+    void timed_search(double *Data, bann_idx *NData, double *Query, bann_idx *NQuery, int *Dim,
+                     int *K, bann_idx *Indx, double *Eps, int *DivChoice)
+    double bann_haus(double *Data, bann_idx *NData, double *Query, bann_idx *NQuery, int *Dim,
+                     double *Eps, int *DivChoice, double *NNDists, int *Lazy)
+    double timed_haus(double *Data, bann_idx *NData, double *Query, bann_idx *NQuery, int *Dim,
                      double *Eps, int *DivChoice)
-    double timed_haus(double *Data, int *NData, double *Query, int *NQuery, int *Dim,
+    int bann_numa_nodes()
+    ctypedef struct bann_index:
+        int dim
+        bann_idx nData
+    bann_index *bann_index_build(double *Data, bann_idx *NData, int *Dim, long *Stride, int *Copy,
+                     int *Split)
+    bann_index *bann_index_build_numa(double *Data, bann_idx *NData, int *Dim, long *Stride,
+                     int *Copy, int *Split, int *NNodes)
+    int bann_index_replicas(bann_index *Index, int *ReplNode, bann_idx *Served, int *Simulated)
+    bann_index *bann_index_build_workload(double *Data, bann_idx *NData, int *Dim, long *Stride,
+                     int *Copy, double *Query, bann_idx *NQuery, int *K, int *DivChoice,
+                     int *MaxBucket)
+    int bann_rank_dims(double *Data, bann_idx *NData, int *Dim, long *Stride, int *DivChoice,
+                     int *Rank)
+    bann_index *bann_index_build_subspace(double *Data, bann_idx *NData, int *Dim, long *Stride,
+                     int *Order, int *NDims, int *MaxBucket)
+    void bann_index_free(bann_index *Index)
+    void bann_index_search(bann_index *Index, double *Query, bann_idx *NQuery, int *K,
+                     bann_idx *Indx, double *Dists, double *Eps, int *DivChoice, int *Block,
+                     int *Order, int *NThreads)
+    void bann_index_search_seeded(bann_index *Index, double *Query, bann_idx *NQuery, int *K,
+                     bann_idx *Seeds, int *NSeeds, int *Chain, bann_idx *Indx, double *Dists,
                      double *Eps, int *DivChoice)
+    void bann_index_search_budget(bann_index *Index, double *Query, bann_idx *NQuery, int *K,
+                     bann_idx *Indx, double *Dists, double *Eps, int *DivChoice, int *Priority,
+                     int *MaxPts, int *MaxLeaves, double *MaxTime, unsigned char *Truncated)
+    void bann_index_search_dual(bann_index *Index, double *Query, bann_idx *NQuery, int *K,
+                     bann_idx *Indx, double *Dists, double *Eps, int *DivChoice)
+    double bann_index_haus(bann_index *Index, double *Query, bann_idx *NQuery, double *Eps,
+                     int *DivChoice, double *NNDists, double *Lower)
+    ctypedef struct bann_range_result:
+        pass
+    bann_range_result *bann_index_range_all(bann_index *Index, double *Query, bann_idx *NQuery,
+                     double *Radii, bann_idx *NRadii, double *Eps, int *DivChoice, int *Sorted,
+                     bann_idx *Offsets)
+    void bann_range_result_copy(const bann_range_result *Range, bann_idx *Indx, double *Dists)
+    void bann_range_result_free(bann_range_result *Range)
+    void bann_index_range_count(bann_index *Index, double *Query, bann_idx *NQuery,
+                     double *Radii, bann_idx *NRadii, double *Eps, int *DivChoice,
+                     bann_idx *Counts)
+    void bann_index_stats(bann_index *Index, bann_idx *Stats, double *AvgAR)
+    int bann_index_build_info(bann_index *Index, int *Split)
+    int bann_index_save(bann_index *Index, const char *Path, const char *Meta)
+    bann_index *bann_index_load(const char *Path, int *Verify, int *Shared, int *Status)
+    int bann_index_publish(bann_index *Index, const char *Name, const char *Meta)
+    int bann_unlink_shared(const char *Name)
+    long long bann_index_meta(bann_index *Index, char *Meta)
+    int bann_index_knn1(bann_index *Index, const double *Query, int K, int DivChoice,
+                     double Eps, bann_idx *Indx, double *Dists)
+    double bann_index_haus1(bann_index *Index, const double *Query, int DivChoice,
+                     double Eps, double Threshold)
+
+# dtype of point indices returned by searches, int64 in builds with ANN_IDX64 and numpy.intc
+# otherwise.
+idx_dtype = numpy.dtype('i%d' % sizeof(bann_idx))
+
+div_map = {
+    'se': 0,
+    'kl': 1,
+    'dkl': 2,
+    'is': 3,
+    'dis': 4
+}
+
+# Splitting rules of an Index, as ANNsplitRule codes
+split_map = {
+    'suggest': 5,
+    'std': 0,
+    'midpt': 1,
+    'fair': 2,
+    'sl_midpt': 3,
+    'sl_fair': 4,
+    'sqrt': 6,
+    'log': 7
+}
+
+_build_kinds = ['unknown', 'split', 'workload', 'subspace']
+
+def _div_choice(div):
+    """
+    Map a divergence name to the DivChoice code used by ann_call.cpp.
+    """
+    if not isinstance(div, str):
+        raise TypeError("Divergence choice must be a string.")
+    try:
+        return div_map[div.lower()]
+    except KeyError:
+        raise ValueError(f"Unknown divergence choice '{div}'. Supported choices are: {list(div_map.keys())}.")
+
+def _out_array(out, shape, dtype, str name):
+    """
+    Check a caller-provided output array, or allocate one if out is None. Results are written
+    straight into its buffer, so it must be writable and C-contiguous with the exact shape and
+    dtype of the result.
+    """
+    if out is None:
+        return numpy.empty(shape, dtype = dtype)
+    if (not isinstance(out, numpy.ndarray) or out.shape != shape or out.dtype != dtype
+            or not out.flags.c_contiguous or not out.flags.writeable):
+        raise ValueError(f"{name} must be a writable C-contiguous {numpy.dtype(dtype).name} "
+                         f"array of shape {shape}.")
+    return out
 
 def k_search(
     numpy.ndarray[double, ndim=2] data,
     numpy.ndarray[double, ndim=2] query,
-    int k = 1, double eps = 0, str div = 'kl') -> numpy.ndarray:
+    int k = 1, double eps = 0, str div = 'kl', int block = 1,
+    bint return_dists = False, out_indices = None, out_dists = None, bint reorder = False,
+    bint dual = False, bint lazy = False):
     """
     Bregman Nearest Neighbour search
     Uses a kd-tree to find the $k$-nearest neighbours for each point in input query set from
@@ -46,12 +166,45 @@ def k_search(
            'dkl' - Dual Kullback-Leibler
            'is'  - Itakura-Saito
            'dis' - Dual Itakura-Saito
+    block : int, optional
+        The number of consecutive query points pushed through the kd-tree together. Each leaf
+        is then compared against every query of the block that reaches it while it is in cache,
+        which is faster when neighbouring queries lie close together. Default is 1, which
+        searches each query on its own.
+    return_dists : bool, optional
+        If True, the divergences of the neighbours are returned as well. Default is False.
+    out_indices : numpy.ndarray, optional
+        A writable C-contiguous array of shape (m_points, k) and dtype idx_dtype to store the
+        indices in, instead of a new array.
+    out_dists : numpy.ndarray, optional
+        A writable C-contiguous float64 array of shape (m_points, k) to store the divergences
+        in. Implies return_dists.
+    reorder : bool, optional
+        If True, the queries are searched in the order of the kd-tree leaves they fall into,
+        found by one descent of the tree per query, rather than in the order given, so that
+        consecutive searches (and the queries of a block) find the nodes and points they need
+        still in cache. This pays off for large, unordered query sets. Results are returned in
+        the order of the queries either way. Default is False.
+    dual : bool, optional
+        If True, a second kd-tree is built over the queries and both trees are searched together,
+        pruning a whole group of nearby queries against a part of the data at once. This pays
+        off when there are many queries, e.g. all-kNN of a data set against itself. block and
+        reorder are then ignored. Default is False.
+    lazy : bool, optional
+        If True, each subtree of the kd-tree is built only when a search first reaches it, so a
+        call with few queries, or with queries in a small part of the data, does not pay for
+        building the rest of the tree. Results are the same either way. Ignored if dual is set.
+        Default is False.
     
     Returns
     -------
     indices : numpy.ndarray
         A 2D numpy array of shape (m_points, k) containing the indices of the k-nearest neighbors
         in the data set for each query point.
+    dists : numpy.ndarray
+        Only if return_dists is True or out_dists is given: a 2D numpy array of shape
+        (m_points, k) containing the divergence of each neighbour from its query point, in
+        increasing order. These are the values the search computed, so they cost nothing extra.
     """
     # Parse inputs and check validity at Python level
     ndata, dim = data.shape[0], data.shape[1]
@@ -60,45 +213,48 @@ def k_search(
         raise ValueError("Data points and query points must lie in the same dimension.")
     if k > ndata or k <= 0:
         raise ValueError("Must search for at least 1 nearest neighbour and less neighbours than data.")
-
-    div_map = {
-        'se': 0,
-        'kl': 1,
-        'dkl': 2,
-        'is': 3,
-        'dis': 4
-    }
-    if not isinstance(div, str):
-        raise TypeError("Divergence choice must be a string.")
-    try:
-        DivChoice = div_map[div.lower()]
-    except KeyError:
-        raise ValueError(f"Unknown divergence choice '{div}'. Supported choices are: {list(div_map.keys())}.")
+    if block <= 0:
+        raise ValueError("Blocks must hold at least 1 query point.")
 
     # Convert to C-types
-    cdef int ND = ndata
-    cdef int NQ = nquery
+    cdef bann_idx ND = ndata
+    cdef bann_idx NQ = nquery
     cdef int D = dim
     cdef int K = k
     cdef double Eps = eps
-    cdef int divChoice = DivChoice
+    cdef int divChoice = _div_choice(div)
+    cdef int Block = block
+    cdef int Order = reorder
+    cdef bint Dual = dual
+    cdef int Lazy = lazy
 
     cdef numpy.ndarray[double, ndim=1] data_c = numpy.ascontiguousarray(data.ravel(), dtype=numpy.double)
     cdef numpy.ndarray[double, ndim=1] query_c = numpy.ascontiguousarray(query.ravel(), dtype=numpy.double)
     cdef double *data_ptr = &data_c[0] if data_c.size else NULL
     cdef double *query_ptr = &query_c[0] if query_c.size else NULL
-    # Prepare output array
-    cdef numpy.ndarray[int, ndim=1] nn_index = numpy.empty(NQ * K, dtype=numpy.intc)
+    # Prepare output arrays, which the C++ search fills in place
+    return_dists = return_dists or out_dists is not None
+    cdef numpy.ndarray nn_index = _out_array(out_indices, (NQ, K), idx_dtype, "out_indices")
+    cdef numpy.ndarray nn_dists = _out_array(out_dists, (NQ, K), numpy.double, "out_dists") if return_dists else None
+    cdef bann_idx *index_ptr = <bann_idx *> numpy.PyArray_DATA(nn_index)
+    cdef double *dists_ptr = <double *> numpy.PyArray_DATA(nn_dists) if return_dists else NULL
 
     # Call to C++ (Release Global Interpreter Lock since ANN is pure C++)
-    bann_search(data_ptr, &ND, query_ptr, &NQ, &D, &K, &nn_index[0], &Eps, &divChoice)
+    with nogil:
+        if Dual:
+            bann_search_dual(data_ptr, &ND, query_ptr, &NQ, &D, &K, index_ptr, dists_ptr, &Eps, &divChoice)
+        elif Block > 1 or Order:
+            bann_search_block(data_ptr, &ND, query_ptr, &NQ, &D, &K, index_ptr, dists_ptr, &Eps, &divChoice, &Block, &Order, &Lazy)
+        else:
+            bann_search(data_ptr, &ND, query_ptr, &NQ, &D, &K, index_ptr, dists_ptr, &Eps, &divChoice, &Lazy)
 
-    return nn_index.reshape((NQ, K))
+    return (nn_index, nn_dists) if return_dists else nn_index
 
 def bhaus(
     numpy.ndarray[double, ndim=2] setp,
     numpy.ndarray[double, ndim=2] setq,
-    double eps = 0, str div = 'kl') -> double:
+    double eps = 0, str div = 'kl', bint return_nn_dists = False, out_nn_dists = None,
+    bint lazy = False):
     """
     (Approximate) Bregman--Hausdorff divergence search:
     Uses a kd-tree to find the Bregman--Hausdorff divergence from a set of vectors $A$
@@ -130,11 +286,25 @@ def bhaus(
             'dkl' - Dual Kullback-Leibler
             'is'  - Itakura-Saito
             'dis' - Dual Itakura-Saito
+    return_nn_dists : bool, optional
+        If True, the divergence of each query point from its nearest data point is returned as
+        well. The searches then cannot stop early once a point closer than the Hausdorff
+        divergence so far is found, so this is slower. Default is False.
+    out_nn_dists : numpy.ndarray, optional
+        A writable C-contiguous float64 array of shape (m_points,) to store those divergences
+        in. Implies return_nn_dists.
+    lazy : bool, optional
+        If True, each subtree of the kd-tree on data is built only when a search first reaches it.
+        As the searches stop early, they often reach a small part of the tree, whose construction
+        then takes most of the time of the call. Results are the same either way. Default is False.
 
     Returns
     -------
     haus : double
         The Bregman--Hausdorff divergence from query $\to$ data.
+    nn_dists : numpy.ndarray
+        Only if return_nn_dists is True or out_nn_dists is given: the divergence of each query
+        point from its nearest data point, whose maximum is haus.
     """
     # Parse inputs and check validity at Python level
     np, dim = setp.shape[0], setp.shape[1]
@@ -142,35 +312,1286 @@ def bhaus(
     if dim != qdim:
         raise ValueError("P and Q must have the same dimension.")
 
-    div_map = {
-        'se': 0,
-        'kl': 1,
-        'dkl': 2,
-        'is': 3,
-        'dis': 4
-    }
-    if not isinstance(div, str):
-        raise ValueError("Divergence choice must be a string.")
-    try:
-        DivChoice = div_map[div.lower()]
-    except KeyError:
-        raise ValueError(f"Unknown divergence choice '{div}'. Supported choices are: {list(div_map.keys())}.")
-
     # Convert to C-types
-    cdef int ND = np
-    cdef int NQ = nq
+    cdef bann_idx ND = np
+    cdef bann_idx NQ = nq
     cdef int D = dim
     cdef double Eps = eps
-    cdef int divChoice = DivChoice
+    cdef int divChoice = _div_choice(div)
+    cdef int Lazy = lazy
 
     cdef numpy.ndarray[double, ndim=1] data_c = numpy.ascontiguousarray(setp.ravel(), dtype=numpy.double)
     cdef numpy.ndarray[double, ndim=1] query_c = numpy.ascontiguousarray(setq.ravel(), dtype=numpy.double)
     cdef double *data_ptr = &data_c[0] if data_c.size else NULL
     cdef double *query_ptr = &query_c[0] if query_c.size else NULL
+    return_nn_dists = return_nn_dists or out_nn_dists is not None
+    cdef numpy.ndarray nn_dists = _out_array(out_nn_dists, (NQ,), numpy.double, "out_nn_dists") if return_nn_dists else None
+    cdef double *dists_ptr = <double *> numpy.PyArray_DATA(nn_dists) if return_nn_dists else NULL
+
+    cdef double haus_div
+    with nogil:
+        haus_div = bann_haus( data_ptr, &ND, query_ptr, &NQ, &D, &Eps, &divChoice, dists_ptr, &Lazy )
+
+    return (haus_div, nn_dists) if return_nn_dists else haus_div
+
+def numa_k_search(
+    numpy.ndarray[double, ndim=2] data,
+    numpy.ndarray[double, ndim=2] query,
+    int k = 1, double eps = 0, str div = 'kl',
+    int threads = 1, int numa_nodes = 0):
+    """
+    NUMA-aware Bregman Nearest Neighbour search
+    As k_search, but the queries are searched by several worker threads. The data
+    points and the kd-tree are replicated once per NUMA node, each replica is built
+    in its node's memory, and every worker is bound to the node of its replica.
+    This builds an Index(data, numa_nodes = numa_nodes) for the call; build it once
+    to search the same data repeatedly.
+
+    Parameters
+    ----------
+    data, query, k, eps, div :
+        As for k_search.
+    threads : int, optional
+        The number of search workers. Default is 1.
+    numa_nodes : int, optional
+        The number of replicas. Default is 0, which uses one replica per NUMA node
+        of the machine. Any other value simulates that many nodes, which allows the
+        placement policy to be exercised on a single-socket machine.
+
+    Returns
+    -------
+    indices : numpy.ndarray
+        As for k_search.
+    stats : dict
+        Placement statistics:
+           'replicas'       - number of replicas
+           'simulated'      - True if numa_nodes overrides the machine topology
+           'replica_node'   - NUMA node holding each replica, -1 if it does not exist
+           'worker_replica' - replica each worker was bound to
+           'served'         - number of queries searched on each replica
+    """
+    if threads <= 0:
+        raise ValueError("Must search with at least 1 thread.")
+    if numa_nodes < 0:
+        raise ValueError("Number of NUMA nodes must be nonnegative.")
+    index = Index(data, numa_nodes = numa_nodes)
+    nn_index = index.k_search(query, k, eps, div, threads = threads)
+    st = index.stats()
+    stats = {
+        'replicas': st['replicas'],
+        'simulated': st['simulated'],
+        'replica_node': st['replica_node'],
+        'worker_replica': [w % st['replicas'] for w in range(threads)],
+        'served': st['served']
+    }
+    return nn_index, stats
+
+
+#--------------------------------------------------------------------------------------------------
+# Persistent index
+#--------------------------------------------------------------------------------------------------
+cdef class Index:
+    """
+    Bregman nearest neighbour index
+    Builds the kd-tree over a data set once, and searches it any number of times with any
+    of the supported divergences. k_search and bhaus build a new tree for every call; an
+    Index avoids this when the same data set is queried repeatedly.
+
+    The GIL is released while searching, and searches only read the tree, so one Index
+    may be searched from several threads at once.
+
+    Parameters
+    ----------
+    data : numpy.ndarray
+        A 2D array of shape (n_points, dim) representing the data set.
+    copy : bool, optional
+        Default is False, in which case the kd-tree is built directly over the buffer of data,
+        which the Index keeps a reference to. This needs no copy for float64 arrays whose
+        rows each hold consecutive coordinates, such as C-contiguous arrays, row slices
+        (data[::2]), column ranges of a wider array (data[:, :8]) and read-only memory maps.
+        Other arrays are copied once. The array must not be modified while the Index exists.
+        If True, the points are always copied, and the array may be changed afterwards.
+    split : str, optional
+        The splitting rule of the kd-tree, a key of split_map. Default is 'suggest', the sliding
+        midpoint rule, which bisects the longest side of each cell. 'sqrt' and 'log' bisect it
+        in the coordinates sqrt(x) and log(x) instead, in which the 'kl' and 'dkl', and the 'is'
+        and 'dis' divergences respectively are locally Euclidean. On data spread over several
+        orders of magnitude their cells have better shapes for these divergences, and searches
+        are faster. They apply to positive data; cells reaching other values are split as by
+        'suggest'. 'std', 'midpt', 'fair', 'sl_midpt' and 'sl_fair' are the other rules of ANN.
+    workload : numpy.ndarray, optional
+        A representative sample of the query points, of shape (m_points, dim). If given, the
+        kd-tree is built for searches of these queries for their workload_k nearest neighbours
+        with workload_div, instead of by split: cells that their searches reach are cut where
+        a cost model of the points and leaves visited by the sample finds it pays, down to
+        single points in the densest query regions, and the other cells are built coarsely
+        into buckets of max_bucket points. Building takes about as long as searching the
+        sample. Results of searches do not depend on the sample, only their speed does.
+    workload_k : int, optional
+        Default is 1.
+    workload_div : str, optional
+        Default is 'kl'.
+    subspace : int or sequence of int, optional
+        For high-dimensional data, such as histograms over many bins, whose points vary mostly
+        along a few coordinates. If given, the kd-tree only cuts along those coordinates: the
+        given ones, or this many ranked by subspace_rank. The points are copied with these
+        coordinates first and the others following by rank, and searches compare a query with
+        the points of a leaf in that order, dropping a point as soon as the divergence summed so
+        far exceeds the k-th closest one. Every divergence component is nonnegative, so the sum
+        over the subset is a lower bound on the divergence, and results are the same as those
+        of the other trees. Such an Index cannot be saved or published.
+    subspace_rank : str, optional
+        How coordinates are ranked: 'spread', by the spread of the points along them, or a
+        divergence name, by the mean divergence along them between sample pairs of points.
+        Default is 'spread'.
+    max_bucket : int, optional
+        The largest number of points in a leaf of a tree built for a workload or a subspace.
+        Default is 8.
+    pad_rows : bool, optional
+        If True, the points are copied as with copy = True, into rows padded to a SIMD
+        boundary (see annRowStride), so that no short row straddles a cache line. Not
+        available with subspace. Default is False.
+    numa_nodes : int, optional
+        If given, the points and the kd-tree are replicated once per NUMA node, as for
+        numa_k_search: 0 for one replica per node of the machine, or the number of nodes to
+        simulate. Each replica is built by a thread pinned to its node, in that node's memory,
+        and k_search with several threads runs each worker on the node of its replica. Several
+        replicas are always copies of the points. Not available with workload or subspace.
+        Default is None, a single tree.
+
+    Attributes
+    ----------
+    n_points : int
+        Number of data points.
+    dim : int
+        Dimension of the data points.
+    data : numpy.ndarray or None
+        The array searched in place, or None if the points were copied into the Index or
+        the Index was loaded from a file.
+    subspace : numpy.ndarray or None
+        The coordinates the kd-tree cuts along, for an Index built with subspace, otherwise
+        None.
+    metadata : object
+        For an Index loaded from a file, the metadata passed to save, otherwise None.
+    build_time : int
+        For an Index loaded from a file, the time it was saved (seconds since the epoch),
+        otherwise 0.
+    """
+    cdef bann_index *index
+    cdef readonly bann_idx n_points
+    cdef readonly int dim
+    cdef readonly object data
+    cdef readonly object subspace
+    cdef readonly object metadata
+    cdef readonly long long build_time
+
+    def __cinit__(self, *args, **kwargs):
+        self.index = NULL
+
+    def __init__(self, data, bint copy = False, str split = 'suggest', workload = None,
+                 int workload_k = 1, str workload_div = 'kl', subspace = None,
+                 str subspace_rank = 'spread', int max_bucket = 8, bint pad_rows = False,
+                 numa_nodes = None):
+        data = numpy.asarray(data)
+        if data.ndim != 2:
+            raise ValueError("Data must be a 2 dimensional array.")
+        if data.shape[0] <= 0 or data.shape[1] <= 0:
+            raise ValueError("Data must contain at least 1 point of dimension at least 1.")
+
+        # Rows may lie at any distance apart, but the coordinates of a row must be consecutive
+        # float64 values, aligned as doubles
+        cdef Py_ssize_t itemsize = sizeof(double)
+        if (data.dtype != numpy.double
+                or (data.shape[1] > 1 and data.strides[1] != itemsize)
+                or data.strides[0] % itemsize != 0
+                or data.__array_interface__['data'][0] % itemsize != 0):
+            data = numpy.ascontiguousarray(data, dtype = numpy.double)
+
+        cdef const double[:, :] view = data
+        cdef bann_idx ND = view.shape[0]
+        cdef int D = view.shape[1]
+        cdef long Stride = view.strides[0] // itemsize if ND > 1 else D
+        cdef int Copy = 2 if pad_rows else copy
+        if split.lower() not in split_map:
+            raise ValueError(f"Unknown splitting rule '{split}'. Supported rules are: {list(split_map.keys())}.")
+        cdef int Split = split_map[split.lower()]
+        cdef double *data_ptr = <double *> &view[0, 0]
+        if workload is not None and subspace is not None:
+            raise ValueError("An Index is built either for a workload or along a subspace.")
+        if pad_rows and subspace is not None:
+            raise ValueError("An Index built along a subspace cannot pad its rows.")
+        if numa_nodes is not None and (workload is not None or subspace is not None):
+            raise ValueError("An Index built for a workload or along a subspace cannot be replicated.")
+        if numa_nodes is not None and numa_nodes < 0:
+            raise ValueError("Number of NUMA nodes must be nonnegative.")
+        cdef int NNodes = numa_nodes if numa_nodes is not None else 0
+        cdef int Simulated
+        if workload is not None:
+            self._build_workload(data_ptr, ND, D, Stride, Copy, workload, workload_k,
+                                 workload_div, max_bucket)
+        elif subspace is not None:
+            self._build_subspace(data_ptr, ND, D, Stride, subspace, subspace_rank, max_bucket)
+            Copy = 1
+        elif numa_nodes is not None:
+            with nogil:
+                self.index = bann_index_build_numa(data_ptr, &ND, &D, &Stride, &Copy, &Split, &NNodes)
+            if bann_index_replicas(self.index, NULL, NULL, &Simulated) > 1:
+                Copy = 1                # each replica holds its own copy
+        else:
+            with nogil:
+                self.index = bann_index_build(data_ptr, &ND, &D, &Stride, &Copy, &Split)
+        self.n_points = ND
+        self.dim = D
+        self.data = None if Copy else data
+
+    cdef _build_workload(self, double *data_ptr, bann_idx ND, int D, long Stride, int Copy,
+                         workload, int k, str div, int max_bucket):
+        cdef numpy.ndarray[double, ndim=2] sample = numpy.ascontiguousarray(workload, dtype=numpy.double)
+        if sample.shape[1] != D:
+            raise ValueError("Workload and data points must lie in the same dimension.")
+        if k <= 0 or k > ND:
+            raise ValueError("Must search for at least 1 nearest neighbour and less neighbours than data.")
+        if max_bucket <= 0:
+            raise ValueError("Buckets must hold at least 1 point.")
+        cdef int divChoice = _div_choice(div)
+        cdef bann_idx NQ = sample.shape[0]
+        cdef double *sample_ptr = <double *> numpy.PyArray_DATA(sample)
+        with nogil:
+            self.index = bann_index_build_workload(data_ptr, &ND, &D, &Stride, &Copy, sample_ptr,
+                                                   &NQ, &k, &divChoice, &max_bucket)
+
+    cdef _build_subspace(self, double *data_ptr, bann_idx ND, int D, long Stride, subspace,
+                         str rank, int max_bucket):
+        if max_bucket <= 0:
+            raise ValueError("Buckets must hold at least 1 point.")
+        cdef int divChoice = -1 if rank.lower() == 'spread' else _div_choice(rank)
+        cdef numpy.ndarray[int, ndim=1] order = numpy.empty(D, dtype=numpy.intc)
+        with nogil:
+            bann_rank_dims(data_ptr, &ND, &D, &Stride, &divChoice, &order[0])
+        if numpy.ndim(subspace) == 0:
+            if subspace <= 0 or subspace > D:
+                raise ValueError("A subspace must hold between 1 and dim coordinates.")
+            dims = order[:subspace]
+        else:
+            dims = numpy.asarray(subspace, dtype=numpy.intc)
+            if (dims.ndim != 1 or dims.size == 0 or dims.min() < 0 or dims.max() >= D
+                    or numpy.unique(dims).size != dims.size):
+                raise ValueError("A subspace must hold distinct coordinates between 0 and dim - 1.")
+            order = numpy.concatenate([dims, order[~numpy.isin(order, dims)]]).astype(numpy.intc)
+        cdef int NDims = len(dims)
+        with nogil:
+            self.index = bann_index_build_subspace(data_ptr, &ND, &D, &Stride, &order[0], &NDims,
+                                                   &max_bucket)
+        self.subspace = numpy.array(dims, dtype=numpy.intc)
+
+    def __dealloc__(self):
+        if self.index != NULL:
+            bann_index_free(self.index)
+
+    @property
+    def handle(self):
+        """
+        Address of the C index handle, the first argument of the functions in
+        bann.c_functions. It is valid while the Index exists.
+        """
+        return <size_t> self.index
+
+    cdef _check_query(self, numpy.ndarray query):
+        if query.shape[1] != self.dim:
+            raise ValueError("Data points and query points must lie in the same dimension.")
+
+    def k_search(self, numpy.ndarray[double, ndim=2] query,
+                 int k = 1, double eps = 0, str div = 'kl', int block = 1,
+                 bint return_dists = False, out_indices = None, out_dists = None,
+                 bint reorder = False, bint dual = False, int threads = 1):
+        """
+        Bregman Nearest Neighbour search on the indexed data set.
+        Parameters and result are those of bann.k_search, with one more parameter:
+
+        Parameters
+        ----------
+        threads : int, optional
+            The number of worker threads, each searching a contiguous part of the queries.
+            On an Index built with numa_nodes, worker w runs on the node of replica
+            w % replicas and searches that replica. Not available with dual. Default is 1.
+        """
+        self._check_query(query)
+        if k > self.n_points or k <= 0:
+            raise ValueError("Must search for at least 1 nearest neighbour and less neighbours than data.")
+        if block <= 0:
+            raise ValueError("Blocks must hold at least 1 query point.")
+        if threads <= 0:
+            raise ValueError("Must search with at least 1 thread.")
+        if dual and threads > 1:
+            raise ValueError("Dual-tree searches run on a single thread.")
+
+        cdef int divChoice = _div_choice(div)
+        cdef bann_idx NQ = query.shape[0]
+        cdef int K = k
+        cdef double Eps = eps
+        cdef int Block = block
+        cdef int Order = reorder
+        cdef bint Dual = dual
+        cdef int NThreads = threads
+
+        cdef numpy.ndarray[double, ndim=1] query_c = numpy.ascontiguousarray(query.ravel(), dtype=numpy.double)
+        cdef double *query_ptr = &query_c[0] if query_c.size else NULL
+        return_dists = return_dists or out_dists is not None
+        cdef numpy.ndarray nn_index = _out_array(out_indices, (NQ, K), idx_dtype, "out_indices")
+        cdef numpy.ndarray nn_dists = _out_array(out_dists, (NQ, K), numpy.double, "out_dists") if return_dists else None
+        cdef bann_idx *index_ptr = <bann_idx *> numpy.PyArray_DATA(nn_index)
+        cdef double *dists_ptr = <double *> numpy.PyArray_DATA(nn_dists) if return_dists else NULL
+
+        with nogil:
+            if Dual:
+                bann_index_search_dual(self.index, query_ptr, &NQ, &K, index_ptr, dists_ptr, &Eps, &divChoice)
+            else:
+                bann_index_search(self.index, query_ptr, &NQ, &K, index_ptr, dists_ptr, &Eps, &divChoice, &Block, &Order,
+                                  &NThreads)
+
+        return (nn_index, nn_dists) if return_dists else nn_index
+
+    def k_search_stream(self, queries, int k = 1, double eps = 0, str div = 'kl', int block = 1,
+                        Py_ssize_t chunk_size = 65536, int threads = 1, callback = None,
+                        bint return_dists = False, out_indices = None, out_dists = None):
+        """
+        Streaming Bregman Nearest Neighbour search on the indexed data set.
+        Parameters and result are those of bann.k_search_stream.
+        """
+        return _stream_k_search(self, queries, k, eps, div, block, chunk_size, threads,
+                                callback, return_dists, out_indices, out_dists)
+
+    def k_search_budget(self, numpy.ndarray[double, ndim=2] query,
+                        int k = 1, double eps = 0, str div = 'kl', str mode = 'standard',
+                        int max_points = 0, int max_leaves = 0, double max_time = 0,
+                        bint return_dists = False):
+        """
+        Bregman Nearest Neighbour search on the indexed data set with a budget per query.
+        Each query stops once it has visited max_points points or max_leaves leaves, or has
+        taken max_time seconds, and returns the closest points found so far. The budget is
+        checked before each node is entered, so a query may exceed it by one bucket.
+
+        Parameters
+        ----------
+        query, k, eps, div, return_dists :
+            As for k_search.
+        mode : str, optional
+            'standard' for the depth-first search of k_search, or 'priority' for the best-first
+            search, which visits the cells in increasing order of their divergence from the query
+            and so finds good neighbours sooner when the budget is tight. Default is 'standard'.
+        max_points, max_leaves : int, optional
+            Limits on the data points and kd-tree leaves visited per query, 0 for no limit.
+            Default is 0.
+        max_time : float, optional
+            Limit on the seconds taken per query, 0 for no limit. Default is 0.
+
+        Returns
+        -------
+        indices : numpy.ndarray
+            As for k_search. A stopped query that did not reach k points has -1 in the missing
+            places, at divergence inf.
+        dists : numpy.ndarray
+            Only if return_dists is True, as for k_search.
+        truncated : numpy.ndarray
+            A boolean array of shape (m_points,), True for the queries stopped by the budget and
+            False for those that completed, whose results are those of k_search.
+        """
+        self._check_query(query)
+        if k > self.n_points or k <= 0:
+            raise ValueError("Must search for at least 1 nearest neighbour and less neighbours than data.")
+        if mode not in ('standard', 'priority'):
+            raise ValueError(f"Unknown search mode '{mode}'. Supported modes are: ['standard', 'priority'].")
+        if max_points < 0 or max_leaves < 0 or max_time < 0:
+            raise ValueError("Budgets must not be negative.")
+
+        cdef int divChoice = _div_choice(div)
+        cdef bann_idx NQ = query.shape[0]
+        cdef int K = k
+        cdef double Eps = eps
+        cdef int Priority = mode == 'priority'
+        cdef int MaxPts = max_points
+        cdef int MaxLeaves = max_leaves
+        cdef double MaxTime = max_time
+
+        cdef numpy.ndarray[double, ndim=1] query_c = numpy.ascontiguousarray(query.ravel(), dtype=numpy.double)
+        cdef double *query_ptr = &query_c[0] if query_c.size else NULL
+        cdef numpy.ndarray nn_index = numpy.zeros((NQ, K), dtype = idx_dtype)
+        cdef numpy.ndarray nn_dists = numpy.zeros((NQ, K), dtype = numpy.double) if return_dists else None
+        cdef numpy.ndarray truncated = numpy.zeros(NQ, dtype = numpy.bool_)
+        cdef bann_idx *index_ptr = <bann_idx *> numpy.PyArray_DATA(nn_index)
+        cdef double *dists_ptr = <double *> numpy.PyArray_DATA(nn_dists) if return_dists else NULL
+        cdef unsigned char *truncated_ptr = <unsigned char *> numpy.PyArray_DATA(truncated)
+
+        with nogil:
+            bann_index_search_budget(self.index, query_ptr, &NQ, &K, index_ptr, dists_ptr, &Eps,
+                                     &divChoice, &Priority, &MaxPts, &MaxLeaves, &MaxTime,
+                                     truncated_ptr)
+
+        return (nn_index, nn_dists, truncated) if return_dists else (nn_index, truncated)
+
+    def k_search_seeded(self, numpy.ndarray[double, ndim=2] query, seeds = None,
+                        int k = 1, double eps = 0, str div = 'kl', bint chain = False,
+                        bint return_dists = False, out_indices = None, out_dists = None):
+        """
+        Bregman Nearest Neighbour search on the indexed data set, starting from candidates.
+        Each query is first compared with its candidate neighbours, so that the search starts
+        with the k-th closest divergence among them as its bound instead of an infinite one and
+        prunes from the first leaf on. Good candidates, e.g. the neighbours of the same point in
+        the previous frame, leave few nodes to visit. The result is that of k_search.
+
+        Parameters
+        ----------
+        query : numpy.ndarray
+            A 2D array of shape (m_points, dim) of query points.
+        seeds : numpy.ndarray, optional
+            An integer array of shape (m_points, s), row i holding candidate indices for query i.
+            Entries that are not indices of data points, such as -1 for padding, are ignored.
+            Default is None, for no candidates.
+        chain : bool, optional
+            If True, each query is also seeded with the neighbours found for the previous query,
+            which suits query sets ordered so that consecutive queries lie close together.
+            Default is False.
+        k, eps, div, return_dists, out_indices, out_dists :
+            As for k_search.
+        """
+        self._check_query(query)
+        if k > self.n_points or k <= 0:
+            raise ValueError("Must search for at least 1 nearest neighbour and less neighbours than data.")
+
+        cdef int divChoice = _div_choice(div)
+        cdef bann_idx NQ = query.shape[0]
+        cdef int K = k
+        cdef double Eps = eps
+        cdef int Chain = chain
+        cdef int NSeeds = 0
+        cdef numpy.ndarray seeds_c = None
+        if seeds is not None:
+            seeds_c = numpy.ascontiguousarray(seeds, dtype = idx_dtype)
+            if seeds_c.ndim != 2 or seeds_c.shape[0] != NQ:
+                raise ValueError("Seeds must be a 2 dimensional array with a row per query point.")
+            NSeeds = seeds_c.shape[1]
+        cdef bann_idx *seeds_ptr = <bann_idx *> numpy.PyArray_DATA(seeds_c) if NSeeds else NULL
+
+        cdef numpy.ndarray[double, ndim=1] query_c = numpy.ascontiguousarray(query.ravel(), dtype=numpy.double)
+        cdef double *query_ptr = &query_c[0] if query_c.size else NULL
+        return_dists = return_dists or out_dists is not None
+        cdef numpy.ndarray nn_index = _out_array(out_indices, (NQ, K), idx_dtype, "out_indices")
+        cdef numpy.ndarray nn_dists = _out_array(out_dists, (NQ, K), numpy.double, "out_dists") if return_dists else None
+        cdef bann_idx *index_ptr = <bann_idx *> numpy.PyArray_DATA(nn_index)
+        cdef double *dists_ptr = <double *> numpy.PyArray_DATA(nn_dists) if return_dists else NULL
+
+        with nogil:
+            bann_index_search_seeded(self.index, query_ptr, &NQ, &K, seeds_ptr, &NSeeds, &Chain,
+                                     index_ptr, dists_ptr, &Eps, &divChoice)
+
+        return (nn_index, nn_dists) if return_dists else nn_index
+
+    def bhaus(self, numpy.ndarray[double, ndim=2] query,
+              double eps = 0, str div = 'kl', bint return_nn_dists = False, out_nn_dists = None):
+        """
+        (Approximate) Bregman--Hausdorff divergence between the indexed data set and the query
+        set, as bann.bhaus(data, query, eps, div, return_nn_dists, out_nn_dists).
+        """
+        self._check_query(query)
+
+        cdef int divChoice = _div_choice(div)
+        cdef bann_idx NQ = query.shape[0]
+        cdef double Eps = eps
+
+        cdef numpy.ndarray[double, ndim=1] query_c = numpy.ascontiguousarray(query.ravel(), dtype=numpy.double)
+        cdef double *query_ptr = &query_c[0] if query_c.size else NULL
+        return_nn_dists = return_nn_dists or out_nn_dists is not None
+        cdef numpy.ndarray nn_dists = _out_array(out_nn_dists, (NQ,), numpy.double, "out_nn_dists") if return_nn_dists else None
+        cdef double *dists_ptr = <double *> numpy.PyArray_DATA(nn_dists) if return_nn_dists else NULL
+
+        cdef double haus_div
+        with nogil:
+            haus_div = bann_index_haus(self.index, query_ptr, &NQ, &Eps, &divChoice, dists_ptr, NULL)
+        return (haus_div, nn_dists) if return_nn_dists else haus_div
+
+    def bhaus_stream(self, queries, double eps = 0, str div = 'kl', Py_ssize_t chunk_size = 65536):
+        """
+        (Approximate) Bregman--Hausdorff divergence between the indexed data set and a query
+        set read chunk by chunk, as bann.bhaus_stream.
+        """
+        if chunk_size <= 0:
+            raise ValueError("Chunks must hold at least 1 query point.")
+
+        cdef int divChoice = _div_choice(div)
+        cdef double Eps = eps
+        cdef bann_idx NQ
+        cdef numpy.ndarray chunk_c
+        cdef double *query_ptr
+        cdef double lower = 0.0
+
+        # The divergence reached by earlier chunks is the threshold of the searches of the next
+        for chunk in _query_chunks(queries, chunk_size):
+            self._check_query(chunk)
+            chunk_c = numpy.ascontiguousarray(chunk, dtype=numpy.double)
+            NQ = chunk_c.shape[0]
+            query_ptr = <double *> numpy.PyArray_DATA(chunk_c)
+            with nogil:
+                lower = bann_index_haus(self.index, query_ptr, &NQ, &Eps, &divChoice, NULL, &lower)
+        return lower
+
+    def range_search(self, numpy.ndarray[double, ndim=2] query,
+                     radius, double eps = 0, str div = 'kl') -> list:
+        """
+        Fixed-radius search on the indexed data set.
+        Finds, for each query point, the data points whose divergence from it is at most
+        radius, measured in the same direction as k_search.
+
+        Parameters
+        ----------
+        query : numpy.ndarray
+            A 2D numpy array of shape (m_points, dim) representing the query points.
+        radius : float or numpy.ndarray
+            The search radius, as a divergence (a squared distance for 'se'), or an array of
+            shape (m_points,) holding a radius per query point.
+        eps : float, optional
+            The error tolerance. Points within radius / (1+eps) are always reported, points
+            further than radius never are. Default is 0.0.
+        div : str, optional
+            The divergence, as for k_search. Default is 'kl'.
+
+        Returns
+        -------
+        indices : list of numpy.ndarray
+            For each query point, the indices of the data points in range, closest first.
+        """
+        offsets, nn_index = self.range_search_csr(query, radius, eps, div, return_dists = False)
+        return numpy.split(nn_index, offsets[1:-1])
+
+    def range_search_csr(self, numpy.ndarray[double, ndim=2] query,
+                         radius, double eps = 0, str div = 'kl', bint sort = True,
+                         bint return_dists = True):
+        """
+        Fixed-radius search on the indexed data set, with the results of all queries in
+        compressed sparse row (CSR) layout.
+        Each query is searched once, appending every data point in range as it is found, so
+        the cost is linear in the number of points reported however many there are.
+
+        Parameters
+        ----------
+        query, radius, eps, div :
+            As for range_search.
+        sort : bool, optional
+            If True, the points of each query are sorted closest first, otherwise they are in
+            the order the search met them. Default is True.
+        return_dists : bool, optional
+            If True, the divergences of the points are returned as well. Default is True.
+
+        Returns
+        -------
+        offsets : numpy.ndarray
+            An array of shape (m_points + 1,) and dtype idx_dtype: the points of query i are
+            entries offsets[i] to offsets[i + 1] - 1 of indices and dists.
+        indices : numpy.ndarray
+            The indices of the data points in range, query after query.
+        dists : numpy.ndarray
+            Only if return_dists is True: the divergence of each of these points from its query.
+        """
+        self._check_query(query)
+        cdef numpy.ndarray radii = numpy.ascontiguousarray(numpy.atleast_1d(radius), dtype=numpy.double)
+        if radii.ndim != 1 or radii.shape[0] not in (1, query.shape[0]):
+            raise ValueError("Radius must be a number or an array with a radius per query point.")
+        if (radii < 0).any():
+            raise ValueError("Radius must be nonnegative.")
+
+        cdef int divChoice = _div_choice(div)
+        cdef bann_idx NQ = query.shape[0]
+        cdef bann_idx NRadii = radii.shape[0]
+        cdef double Eps = eps
+        cdef int Sorted = sort
+
+        cdef numpy.ndarray[double, ndim=1] query_c = numpy.ascontiguousarray(query.ravel(), dtype=numpy.double)
+        cdef double *query_ptr = &query_c[0] if query_c.size else NULL
+        cdef double *radii_ptr = <double *> numpy.PyArray_DATA(radii)
+        cdef numpy.ndarray offsets = numpy.zeros(NQ + 1, dtype=idx_dtype)
+        cdef bann_idx *offsets_ptr = <bann_idx *> numpy.PyArray_DATA(offsets)
+        cdef bann_range_result *found
+        with nogil:
+            found = bann_index_range_all(self.index, query_ptr, &NQ, radii_ptr, &NRadii, &Eps,
+                                         &divChoice, &Sorted, offsets_ptr)
+        if found == NULL:
+            raise ValueError(f"Unknown divergence choice '{div}'.")
+
+        # Copy the points out of the growable C++ arrays they were collected in
+        cdef numpy.ndarray nn_index = numpy.empty(offsets[NQ], dtype=idx_dtype)
+        cdef numpy.ndarray nn_dists = numpy.empty(offsets[NQ], dtype=numpy.double) if return_dists else None
+        cdef bann_idx *index_ptr = <bann_idx *> numpy.PyArray_DATA(nn_index)
+        cdef double *dists_ptr = <double *> numpy.PyArray_DATA(nn_dists) if return_dists else NULL
+        bann_range_result_copy(found, index_ptr, dists_ptr)
+        bann_range_result_free(found)
+
+        return (offsets, nn_index, nn_dists) if return_dists else (offsets, nn_index)
+
+    def range_count(self, numpy.ndarray[double, ndim=2] query,
+                    radius, double eps = 0, str div = 'kl') -> numpy.ndarray:
+        """
+        Number of data points within a fixed radius of each query point.
+        Counts the points range_search would report without listing them: whole subtrees
+        whose cells lie within the radius are counted from their sizes, so the cost grows with
+        the boundary of the range rather than with the number of points in it.
+
+        Parameters
+        ----------
+        query, radius, eps, div :
+            As for range_search.
 
-    haus_div = bann_haus( data_ptr, &ND, query_ptr, &NQ, &D, &Eps, &divChoice )
+        Returns
+        -------
+        counts : numpy.ndarray
+            An array of shape (m_points,) and dtype idx_dtype.
+        """
+        self._check_query(query)
+        cdef numpy.ndarray radii = numpy.ascontiguousarray(numpy.atleast_1d(radius), dtype=numpy.double)
+        if radii.ndim != 1 or radii.shape[0] not in (1, query.shape[0]):
+            raise ValueError("Radius must be a number or an array with a radius per query point.")
+        if (radii < 0).any():
+            raise ValueError("Radius must be nonnegative.")
 
-    return haus_div
+        cdef int divChoice = _div_choice(div)
+        cdef bann_idx NQ = query.shape[0]
+        cdef bann_idx NRadii = radii.shape[0]
+        cdef double Eps = eps
+
+        cdef numpy.ndarray[double, ndim=1] query_c = numpy.ascontiguousarray(query.ravel(), dtype=numpy.double)
+        cdef double *query_ptr = &query_c[0] if query_c.size else NULL
+        cdef double *radii_ptr = <double *> numpy.PyArray_DATA(radii)
+        cdef numpy.ndarray counts = numpy.zeros(NQ, dtype=idx_dtype)
+        cdef bann_idx *counts_ptr = <bann_idx *> numpy.PyArray_DATA(counts)
+        with nogil:
+            bann_index_range_count(self.index, query_ptr, &NQ, radii_ptr, &NRadii, &Eps,
+                                   &divChoice, counts_ptr)
+        return counts
+
+    def stats(self) -> dict:
+        """
+        Statistics of the kd-tree:
+           'dim', 'n_pts', 'bkt_size'  - dimension, number of points and bucket size
+           'n_lf', 'n_tl'              - number of leaves, and of those, trivial (empty) leaves
+           'n_spl', 'n_shr'            - number of splitting and shrinking nodes
+           'depth'                     - depth of the tree
+           'avg_ar'                    - average aspect ratio of the leaves
+           'build'                     - how the tree was built: 'split', 'workload' or
+                                         'subspace' (as recorded in the file, if loaded)
+           'split'                     - the key of split_map it was built by, or None
+           'replicas'                  - number of NUMA replicas, 0 unless built with numa_nodes
+           'simulated'                 - True if numa_nodes overrode the machine topology
+           'replica_node'              - NUMA node holding each replica, -1 if it does not exist
+           'served'                    - number of queries searched on each replica so far
+        """
+        cdef numpy.ndarray st = numpy.zeros(8, dtype=idx_dtype)
+        cdef bann_idx *st_ptr = <bann_idx *> numpy.PyArray_DATA(st)
+        cdef double avg_ar
+        cdef int Split
+        cdef int kind
+        with nogil:
+            bann_index_stats(self.index, st_ptr, &avg_ar)
+            kind = bann_index_build_info(self.index, &Split)
+        keys = ['dim', 'n_pts', 'bkt_size', 'n_lf', 'n_tl', 'n_spl', 'n_shr', 'depth']
+        result = dict(zip(keys, st.tolist()))
+        result['avg_ar'] = avg_ar
+        result['build'] = _build_kinds[kind]
+        result['split'] = next((name for name, rule in split_map.items() if rule == Split), None)
+        cdef int simulated
+        cdef int n_repl = bann_index_replicas(self.index, NULL, NULL, &simulated)
+        cdef numpy.ndarray[int, ndim=1] repl_node = numpy.empty(n_repl, dtype=numpy.intc)
+        cdef numpy.ndarray served = numpy.empty(n_repl, dtype=idx_dtype)
+        if n_repl > 0:
+            bann_index_replicas(self.index, &repl_node[0], <bann_idx *> numpy.PyArray_DATA(served),
+                                &simulated)
+        result['replicas'] = n_repl
+        result['simulated'] = simulated != 0
+        result['replica_node'] = repl_node.tolist()
+        result['served'] = served.tolist()
+        return result
+
+    def save(self, path, metadata = None):
+        """
+        Save the Index in the binary BANN index format.
+        The points, their order in the tree, the tree nodes and its bounding box are written in
+        page-aligned sections with checksums, so that Index.load can search the file in place.
+
+        Parameters
+        ----------
+        path : str or os.PathLike
+            The file to write.
+        metadata : object, optional
+            Build metadata to store with the Index, such as the data set it was built from.
+            It must be serialisable as JSON in at most 255 bytes.
+        """
+        if self.subspace is not None:
+            raise ValueError("An Index built along a subspace cannot be saved.")
+        cdef bytes meta = _index_meta(metadata)
+        cdef bytes path_b = os.fsencode(path)
+        cdef const char *path_ptr = path_b
+        cdef const char *meta_ptr = meta
+        cdef int status
+        with nogil:
+            status = bann_index_save(self.index, path_ptr, meta_ptr)
+        if status != 0:
+            raise OSError("Cannot write BANN index file %r." % (path,))
+
+    def publish(self, name, metadata = None):
+        """
+        Publish the Index in a new named shared-memory segment, in the format of Index.save.
+        Other processes attach to it with Index.attach, and share one physical copy of the
+        points and tree. The segment outlives the publishing process, and stays until
+        Index.unlink_shared removes its name and the last attached Index is freed.
+        Linux only.
+
+        Parameters
+        ----------
+        name : str
+            Name of the segment, such as 'bann-index' (a leading '/' is added if missing).
+        metadata : object, optional
+            As for Index.save.
+        """
+        if self.subspace is not None:
+            raise ValueError("An Index built along a subspace cannot be published.")
+        cdef bytes meta = _index_meta(metadata)
+        cdef bytes name_b = _shm_name(name)
+        cdef const char *name_ptr = name_b
+        cdef const char *meta_ptr = meta
+        cdef int status
+        with nogil:
+            status = bann_index_publish(self.index, name_ptr, meta_ptr)
+        if status == 5:
+            raise FileExistsError("Shared-memory segment %r exists already." % (name,))
+        if status == 4:
+            raise OSError("Shared-memory indexes are not supported on this platform.")
+        if status != 0:
+            raise OSError("Cannot publish shared-memory segment %r." % (name,))
+
+    @staticmethod
+    def load(path, bint verify = False):
+        """
+        Load an Index saved by Index.save.
+        The file is memory mapped and searched in place: loading only reads the tree nodes,
+        and the points are paged in as searches reach them. The file must not be modified
+        while the Index exists.
+
+        Parameters
+        ----------
+        path : str or os.PathLike
+            The file to read.
+        verify : bool, optional
+            Default is False, in which case only the checksums of the header and the tree nodes
+            are checked. If True, those of the points and their order are checked as well, which
+            reads the whole file.
+
+        Returns
+        -------
+        index : bann.Index
+        """
+        return _load_index(os.fsencode(path), verify, False, "BANN index file %r" % (path,))
+
+    @staticmethod
+    def attach(name, bint verify = False):
+        """
+        Attach to an Index published by Index.publish, possibly in another process.
+        The segment is mapped read-only and nothing is copied; attaching only reads the tree
+        nodes. The Index remains valid if the publishing process exits or the segment is
+        unlinked.
+
+        Parameters
+        ----------
+        name : str
+            Name of the segment, as given to Index.publish.
+        verify : bool, optional
+            As for Index.load.
+
+        Returns
+        -------
+        index : bann.Index
+        """
+        return _load_index(_shm_name(name), verify, True, "Shared-memory segment %r" % (name,))
+
+    @staticmethod
+    def unlink_shared(name):
+        """
+        Remove the name of a shared-memory segment created by Index.publish. Indexes attached
+        to it remain valid, and its memory is released when the last of them is freed.
+        """
+        cdef bytes name_b = _shm_name(name)
+        if bann_unlink_shared(name_b) != 0:
+            raise FileNotFoundError("No shared-memory segment %r." % (name,))
+
+
+cdef bytes _index_meta(metadata):
+    meta = json.dumps(metadata).encode()
+    if len(meta) > 255:
+        raise ValueError("Metadata must be at most 255 bytes as JSON.")
+    return meta
+
+cdef bytes _shm_name(name):
+    name = os.fsencode(name)
+    return name if name.startswith(b'/') else b'/' + name
+
+cdef Index _load_index(bytes path, bint verify, bint shared, str what):
+    """
+    Map a saved or published index, raising OSError if it cannot be read and ValueError if
+    it is not a compatible index or fails its checksums.
+    """
+    cdef const char *path_ptr = path
+    cdef int Verify = verify
+    cdef int Shared = shared
+    cdef int status
+    cdef bann_index *loaded
+    with nogil:
+        loaded = bann_index_load(path_ptr, &Verify, &Shared, &status)
+    if status == 1:
+        raise OSError("Cannot read %s." % what)
+    if status == 2:
+        raise ValueError("%s is not a compatible BANN index." % what)
+    if status == 4:
+        raise OSError("Shared-memory indexes are not supported on this platform.")
+    if status != 0:
+        raise ValueError("%s is corrupted (checksum mismatch)." % what)
+
+    cdef Index result = Index.__new__(Index)
+    cdef char meta[256]
+    result.index = loaded
+    result.build_time = bann_index_meta(loaded, meta)
+    cdef bytes meta_b = meta
+    result.metadata = json.loads(meta_b) if meta_b else None
+    result.n_points = loaded.nData
+    result.dim = loaded.dim
+    return result
+
+
+#--------------------------------------------------------------------------------------------------
+# C entry points
+#--------------------------------------------------------------------------------------------------
+# Single query searches on an Index handle, as ctypes function pointers that Numba can call from
+# nopython code and whose addresses (ctypes.cast(f, ctypes.c_void_p).value) may be cast to C
+# function pointers in Cython. Pointer arguments take addresses, e.g. array.ctypes.data.
+#
+#   int knn(handle, const double *query, int k, int div, double eps, idx *indices, double *dists)
+#       Stores the k nearest neighbours of the query point, and their divergences unless dists
+#       is NULL. div is a value of div_map. Returns 0, or -1 if div or k is invalid.
+#   double haus(handle, const double *query, int div, double eps, double threshold)
+#       Divergence of the query point from its nearest index point in the direction of bhaus,
+#       or a value no larger than threshold once a point within threshold is found. The
+#       maximum over a query set, passed back in as threshold, is its Bregman--Hausdorff
+#       divergence. Returns -1 if div is invalid.
+c_functions = {
+    'knn': ctypes.CFUNCTYPE(ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int,
+                            ctypes.c_int, ctypes.c_double, ctypes.c_void_p,
+                            ctypes.c_void_p)(<size_t> <void *> &bann_index_knn1),
+    'haus': ctypes.CFUNCTYPE(ctypes.c_double, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int,
+                             ctypes.c_double, ctypes.c_double)(<size_t> <void *> &bann_index_haus1),
+}
+
+
+#--------------------------------------------------------------------------------------------------
+# Asynchronous submission
+#--------------------------------------------------------------------------------------------------
+class SearchQueue:
+    """
+    Asynchronous Bregman Nearest Neighbour search
+    Requests submitted to the queue return a concurrent.futures.Future at once. A dispatcher
+    thread collects the requests that arrive within a short window, coalesces those against
+    the same bann.Index with the same k, eps and divergence into one batch, and searches the
+    batch on a pool of threads with the GIL released. The tree of the index is built once,
+    when the index is, and shared by every batch. The dispatcher hands each batch to the pool
+    and goes on to the next without waiting; the thread finishing the last slice of a batch
+    completes each of its futures with its own slice of the batch result.
+
+    Parameters
+    ----------
+    threads : int, optional
+        The number of threads searching each batch. Default is 1.
+    window : float, optional
+        Seconds to wait for further requests once one has arrived. Default is 0.001.
+    max_batch : int, optional
+        Maximum number of query points in one internal batch. Default is 65536.
+
+    Attributes
+    ----------
+    requests : int
+        Number of requests submitted.
+    batches : int
+        Number of internal batches searched.
+    """
+    def __init__(self, int threads = 1, double window = 0.001, int max_batch = 65536):
+        if threads <= 0:
+            raise ValueError("Must search with at least 1 thread.")
+        if max_batch <= 0:
+            raise ValueError("Batches must hold at least 1 query point.")
+        self.threads = threads
+        self.window = window
+        self.max_batch = max_batch
+        self.requests = 0
+        self.batches = 0
+        self._pending = []
+        self._closed = False
+        self._cond = threading.Condition()
+        self._pool = ThreadPoolExecutor(threads)
+        self._dispatcher = threading.Thread(target = self._dispatch, daemon = True)
+        self._dispatcher.start()
+
+    def submit(self, index, query, k = 1, eps = 0, div = 'kl') -> Future:
+        """
+        Enqueue a k-nearest neighbour search on index, with the arguments of Index.k_search.
+
+        Returns
+        -------
+        future : concurrent.futures.Future
+            Completes with the (m_points, k) array of neighbour indices.
+        """
+        if not isinstance(index, Index):
+            raise TypeError("SearchQueue searches a bann.Index; build one with bann.Index(data).")
+        if not isinstance(query, numpy.ndarray):
+            raise TypeError("Query must be a numpy array.")
+        if query.ndim != 2:
+            raise ValueError("Query must be a 2 dimensional array.")
+        if query.shape[1] != index.dim:
+            raise ValueError("Data points and query points must lie in the same dimension.")
+        if k > index.n_points or k <= 0:
+            raise ValueError("Must search for at least 1 nearest neighbour and less neighbours than data.")
+        _div_choice(div)
+
+        future = Future()
+        with self._cond:
+            if self._closed:
+                raise RuntimeError("Cannot submit to a closed SearchQueue.")
+            # The index is held by the request, so its id stays unique while pending
+            self._pending.append(((id(index), int(k), float(eps), div.lower()), index,
+                                  numpy.asarray(query, dtype = numpy.double), future))
+            self.requests += 1
+            self._cond.notify()
+        return future
+
+    async def k_search(self, index, query, k = 1, eps = 0, div = 'kl'):
+        """
+        Awaitable k_search, for use from an asyncio event loop.
+        """
+        return await asyncio.wrap_future(self.submit(index, query, k, eps, div))
+
+    def close(self):
+        """
+        Search the requests still pending, then stop the dispatcher thread.
+        """
+        with self._cond:
+            self._closed = True
+            self._cond.notify()
+        self._dispatcher.join()
+        self._pool.shutdown()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def _dispatch(self):
+        while True:
+            with self._cond:
+                while not self._pending and not self._closed:
+                    self._cond.wait()
+                if not self._pending:
+                    return
+            if self.window > 0:
+                time.sleep(self.window)
+            with self._cond:
+                pending, self._pending = self._pending, []
+
+            # Group by index and search parameters, keeping submission order
+            groups = {}
+            for request in pending:
+                groups.setdefault(request[0], []).append(request)
+            for (_, k, eps, div), requests in groups.items():
+                index = requests[0][1]
+                start = 0
+                while start < len(requests):
+                    stop, npts = start + 1, requests[start][2].shape[0]
+                    while stop < len(requests) and npts + requests[stop][2].shape[0] <= self.max_batch:
+                        npts += requests[stop][2].shape[0]
+                        stop += 1
+                    self._search(index, requests[start:stop], k, eps, div)
+                    start = stop
+
+    def _search(self, index, requests, k, eps, div):
+        live = [r for r in requests if r[3].set_running_or_notify_cancel()]
+        if not live:
+            return
+        try:
+            query = numpy.vstack([r[2] for r in live])
+            nn_index = numpy.empty((query.shape[0], k), dtype = idx_dtype)
+            # Split the batch evenly between the threads, each writing its own rows
+            bounds = [query.shape[0] * t // self.threads for t in range(self.threads + 1)]
+            slices = [(bounds[t], bounds[t+1]) for t in range(self.threads) if bounds[t] < bounds[t+1]]
+        except BaseException as err:
+            self._complete(live, None, err)
+            return
+
+        remaining = [len(slices)]
+        errors = []
+        lock = threading.Lock()
+        def finished(search):
+            err = search.exception()
+            with lock:
+                if err is not None:
+                    errors.append(err)
+                remaining[0] -= 1
+                if remaining[0] > 0:
+                    return
+            self._complete(live, nn_index, errors[0] if errors else None)
+        for a, b in slices:
+            self._pool.submit(index.k_search, query[a:b], k, eps, div, 1, False,
+                              nn_index[a:b]).add_done_callback(finished)
+
+    def _complete(self, live, nn_index, err):
+        if err is not None:
+            for r in live:
+                r[3].set_exception(err)
+            return
+        with self._cond:
+            self.batches += 1
+        start = 0
+        for r in live:
+            stop = start + r[2].shape[0]
+            r[3].set_result(nn_index[start:stop])
+            start = stop
+
+_default_queue = None
+_default_queue_lock = threading.Lock()
+
+async def k_search_async(index, query, k = 1, eps = 0, div = 'kl'):
+    """
+    Awaitable Index.k_search on a module-wide SearchQueue, so that concurrent coroutines
+    searching the same index are coalesced into shared batches.
+    """
+    global _default_queue
+    with _default_queue_lock:
+        if _default_queue is None:
+            _default_queue = SearchQueue()
+    return await _default_queue.k_search(index, query, k, eps, div)
+
+
+#--------------------------------------------------------------------------------------------------
+# Tracking
+#--------------------------------------------------------------------------------------------------
+class Tracker:
+    """
+    Nearest neighbour tracking of moving query points
+    Searches an Index for a set of query points that moves a little between calls, such as
+    the tracked objects of consecutive frames. Each query is seeded (see
+    Index.k_search_seeded) with the neighbours found for the same row by the previous call,
+    so that a search mostly confirms the previous result.
+
+    Parameters
+    ----------
+    index : Index
+        The indexed data set.
+    k, eps, div :
+        As for k_search.
+    chain : bool, optional
+        If True, each query is also seeded with the neighbours of the previous row of the same
+        call. Default is False.
+
+    Attributes
+    ----------
+    last : numpy.ndarray or None
+        The neighbour indices of the previous call, or None after reset.
+    """
+    def __init__(self, Index index, int k = 1, double eps = 0, str div = 'kl',
+                 bint chain = False):
+        if k > index.n_points or k <= 0:
+            raise ValueError("Must search for at least 1 nearest neighbour and less neighbours than data.")
+        _div_choice(div)
+        self.index = index
+        self.k = k
+        self.eps = eps
+        self.div = div
+        self.chain = chain
+        self.last = None
+
+    def search(self, query, bint return_dists = False):
+        """
+        k-nearest neighbours of the rows of query, as Index.k_search. The previous result
+        seeds the search if it has as many rows as query.
+        """
+        query = numpy.asarray(query, dtype = numpy.double)
+        seeds = self.last if self.last is not None and self.last.shape[0] == query.shape[0] else None
+        result = self.index.k_search_seeded(query, seeds, self.k, self.eps, self.div, self.chain,
+                                            return_dists)
+        self.last = result[0] if return_dists else result
+        return result
+
+    def reset(self):
+        """
+        Forget the previous result, e.g. when the tracked points change.
+        """
+        self.last = None
+
+#--------------------------------------------------------------------------------------------------
+# Streaming search
+#--------------------------------------------------------------------------------------------------
+def k_search_stream(data, queries, int k = 1, double eps = 0, str div = 'kl', int block = 1,
+                    Py_ssize_t chunk_size = 65536, int threads = 1, callback = None,
+                    bint return_dists = False, out_indices = None, out_dists = None):
+    """
+    Streaming Bregman Nearest Neighbour search
+    Searches the query set chunk by chunk, as bann.k_search would search each chunk, so that
+    only a few chunks of query points and results are held in memory at any time, however
+    many query points there are. Results are passed to a callback or written to output arrays
+    (e.g. memory maps) as each chunk is done.
+
+    Parameters
+    ----------
+    data : numpy.ndarray
+        A 2D numpy array of shape (n_points, dim) representing the data set. The kd-tree is
+        built once, over the buffer of data, as by bann.Index(data).
+    queries : numpy.ndarray or iterable
+        A 2D array of shape (m_points, dim), such as a memory map, which is read one slice of
+        chunk_size rows at a time; or an iterable of query points and 2D arrays of query
+        points, which are gathered into chunks of chunk_size points as they arrive.
+    k, eps, div, block :
+        As for bann.k_search.
+    chunk_size : int, optional
+        Number of query points searched together. Default is 65536.
+    threads : int, optional
+        Number of chunks searched at the same time, each on its own thread with the GIL
+        released. Default is 1.
+    callback : callable, optional
+        Called as callback(start, nn_indices) for each chunk, or callback(start, nn_indices,
+        nn_dists) with return_dists, in order of the query points. start is the position of
+        the first query point of the chunk, and the arrays hold the results of its points.
+    return_dists : bool, optional
+        If True, the divergences of the neighbours are passed to the callback as well.
+        Default is False.
+    out_indices, out_dists : numpy.ndarray, optional
+        Writable C-contiguous arrays with k columns, of dtype idx_dtype and float64, with a
+        row for each query point. The results of each chunk are written to its rows, and
+        the callback is given views of those rows. Giving out_dists implies return_dists.
+
+    Returns
+    -------
+    int
+        The number of query points searched.
+    """
+    return Index(data).k_search_stream(queries, k, eps, div, block, chunk_size, threads,
+                                       callback, return_dists, out_indices, out_dists)
+
+def bhaus_stream(setp, queries, double eps = 0, str div = 'kl', Py_ssize_t chunk_size = 65536):
+    """
+    Streaming (approximate) Bregman--Hausdorff divergence
+    Computes bann.bhaus(setp, setq) for a query set setq that is read chunk by chunk, so that
+    it need not fit in memory. The divergence reached by the chunks searched so far is kept
+    as the early termination threshold of the searches of the next chunk, so the result and
+    the work done are those of a single call on the whole set.
+
+    Parameters
+    ----------
+    setp : numpy.ndarray
+        A 2D numpy array of shape (n_points, dim); the kd-tree is built over it once.
+    queries : numpy.ndarray or iterable
+        The query set, as for bann.k_search_stream: a 2D array such as a memory map, or an
+        iterable of query points and 2D arrays of query points.
+    eps, div :
+        As for bann.bhaus.
+    chunk_size : int, optional
+        Number of query points searched together. Default is 65536.
+
+    Returns
+    -------
+    float
+        The (approximate) Bregman--Hausdorff divergence.
+    """
+    return Index(setp).bhaus_stream(queries, eps, div, chunk_size)
+
+def _query_chunks(queries, Py_ssize_t chunk_size):
+    """
+    Split a query set into float64 arrays of at most chunk_size points. Arrays are sliced in
+    place; the points of an iterable are gathered until a chunk is full.
+    """
+    if isinstance(queries, numpy.ndarray):
+        if queries.ndim != 2:
+            raise ValueError("Query points must be given as a 2 dimensional array.")
+        for start in range(0, queries.shape[0], chunk_size):
+            yield numpy.asarray(queries[start:start + chunk_size], dtype = numpy.double)
+        return
+    pending = []
+    cdef Py_ssize_t count = 0
+    cdef Py_ssize_t take
+    for item in queries:
+        item = numpy.asarray(item, dtype = numpy.double)
+        if item.ndim == 1:
+            item = item.reshape(1, -1)
+        elif item.ndim != 2:
+            raise ValueError("Query iterables must yield points or 2 dimensional arrays of points.")
+        while item.shape[0] > 0:
+            take = min(chunk_size - count, item.shape[0])
+            pending.append(item[:take])
+            count += take
+            item = item[take:]
+            if count == chunk_size:
+                yield numpy.vstack(pending)
+                pending = []
+                count = 0
+    if count > 0:
+        yield numpy.vstack(pending)
+
+def _stream_out(out, int k, dtype, str name):
+    """
+    Check an output array of a streaming search, whose rows are filled chunk by chunk.
+    """
+    if out is not None and (not isinstance(out, numpy.ndarray) or out.ndim != 2
+                            or out.shape[1] != k or out.dtype != dtype
+                            or not out.flags.c_contiguous or not out.flags.writeable):
+        raise ValueError(f"{name} must be a writable C-contiguous {numpy.dtype(dtype).name} "
+                         f"array with {k} columns.")
+
+def _stream_k_search(Index index, queries, int k, double eps, str div, int block,
+                     Py_ssize_t chunk_size, int threads, callback, bint return_dists,
+                     out_indices, out_dists):
+    if chunk_size <= 0:
+        raise ValueError("Chunks must hold at least 1 query point.")
+    if threads <= 0:
+        raise ValueError("Must search with at least 1 thread.")
+    if callback is None and out_indices is None and out_dists is None:
+        raise ValueError("Streaming searches need a callback or output arrays for the results.")
+    _div_choice(div)
+    return_dists = return_dists or out_dists is not None
+    _stream_out(out_indices, k, idx_dtype, "out_indices")
+    _stream_out(out_dists, k, numpy.double, "out_dists")
+    outs = [out for out in (out_indices, out_dists) if out is not None]
+    if isinstance(queries, numpy.ndarray) and any(out.shape[0] != queries.shape[0] for out in outs):
+        raise ValueError("Output arrays must have a row for each query point.")
+
+    def emit(start, result):
+        if callback is not None:
+            if return_dists:
+                callback(start, result[0], result[1])
+            else:
+                callback(start, result)
+
+    def search(first, chunk, oi, od):
+        return first, index.k_search(chunk, k, eps, div, block, return_dists, oi, od)
+
+    # Chunks are searched on a pool of threads, with at most threads chunks in flight, and
+    # their results are passed on in order of the query points
+    pending = deque()
+    cdef Py_ssize_t start = 0
+    cdef Py_ssize_t stop
+    with ThreadPoolExecutor(threads) as pool:
+        for chunk in _query_chunks(queries, chunk_size):
+            stop = start + chunk.shape[0]
+            if any(out.shape[0] < stop for out in outs):
+                raise ValueError("Output arrays must have a row for each query point.")
+            if len(pending) == threads:
+                emit(*pending.popleft().result())
+            pending.append(pool.submit(search, start, chunk,
+                                       out_indices[start:stop] if out_indices is not None else None,
+                                       out_dists[start:stop] if out_dists is not None else None))
+            start = stop
+        while pending:
+            emit(*pending.popleft().result())
+    return start
 
 
 #--------------------------------------------------------------------------------------------------
@@ -191,39 +1612,27 @@ def __timed_k_search(
     if k > ndata or k <= 0:
         raise ValueError("Must search for at least 1 nearest neighbour and less neighbours than data.")
 
-    div_map = {
-        'se': 0,
-        'kl': 1,
-        'dkl': 2,
-        'is': 3,
-        'dis': 4
-    }
-    if not isinstance(div, str):
-        raise ValueError("Divergence choice must be a string.")
-    try:
-        DivChoice = div_map[div.lower()]
-    except KeyError:
-        raise ValueError(f"Unknown divergence choice '{div}'. Supported choices are: {list(div_map.keys())}.")
-
     # Convert to C-types
-    cdef int ND = ndata
-    cdef int NQ = nquery
+    cdef bann_idx ND = ndata
+    cdef bann_idx NQ = nquery
     cdef int D = dim
     cdef int K = k
     cdef double Eps = eps
-    cdef int divChoice = DivChoice
+    cdef int divChoice = _div_choice(div)
 
     cdef numpy.ndarray[double, ndim=1] data_c = numpy.ascontiguousarray(data.ravel(), dtype=numpy.double)
     cdef numpy.ndarray[double, ndim=1] query_c = numpy.ascontiguousarray(query.ravel(), dtype=numpy.double)
     cdef double *data_ptr = &data_c[0] if data_c.size else NULL
     cdef double *query_ptr = &query_c[0] if query_c.size else NULL
     # Prepare output array
-    cdef numpy.ndarray[int, ndim=1] nn_index = numpy.empty(NQ * K, dtype=numpy.intc)
+    cdef numpy.ndarray nn_index = numpy.empty(max(NQ * K, 1), dtype=idx_dtype)
+    cdef bann_idx *index_ptr = <bann_idx *> numpy.PyArray_DATA(nn_index)
 
     # Call to C++ (Release Global Interpreter Lock since ANN is pure C++)
-    timed_search(data_ptr, &ND, query_ptr, &NQ, &D, &K, &nn_index[0], &Eps, &divChoice)
+    with nogil:
+        timed_search(data_ptr, &ND, query_ptr, &NQ, &D, &K, index_ptr, &Eps, &divChoice)
 
-    return nn_index.reshape((NQ, K))
+    return nn_index[:NQ * K].reshape((NQ, K))
 
 def __timed_bhaus(
     numpy.ndarray[double, ndim=2] data,
@@ -235,31 +1644,19 @@ def __timed_bhaus(
     if dim != qdim:
         raise ValueError("Data points and query points must lie in the same dimension.")
 
-    div_map = {
-        'se': 0,
-        'kl': 1,
-        'dkl': 2,
-        'is': 3,
-        'dis': 4
-    }
-    if not isinstance(div, str):
-        raise ValueError("Divergence choice must be a string.")
-    try:
-        DivChoice = div_map[div.lower()]
-    except KeyError:
-        raise ValueError(f"Unknown divergence choice '{div}'. Supported choices are: {list(div_map.keys())}.")
-
     # Convert to C-types
-    cdef int ND = ndata
-    cdef int NQ = nquery
+    cdef bann_idx ND = ndata
+    cdef bann_idx NQ = nquery
     cdef int D = dim
     cdef double Eps = eps
-    cdef int divChoice = DivChoice
+    cdef int divChoice = _div_choice(div)
 
     cdef numpy.ndarray[double, ndim=1] data_c = numpy.ascontiguousarray(data.ravel(), dtype=numpy.double)
     cdef numpy.ndarray[double, ndim=1] query_c = numpy.ascontiguousarray(query.ravel(), dtype=numpy.double)
     cdef double *data_ptr = &data_c[0] if data_c.size else NULL
     cdef double *query_ptr = &query_c[0] if query_c.size else NULL
 
-    haus = timed_haus(data_ptr, &ND, query_ptr, &NQ, &D, &Eps, &divChoice)
+    cdef double haus
+    with nogil:
+        haus = timed_haus(data_ptr, &ND, query_ptr, &NQ, &D, &Eps, &divChoice)
     return haus
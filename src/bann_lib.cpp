@@ -0,0 +1,196 @@
+/* bann_lib.cpp
+ *  The C interface of bann.h, over the wrappers of ann_call.cpp. Built
+ *  together with ann_namespace.cpp into the shared library libbann.so by
+ *  setup.py build_ext, next to the extension module.
+ *  The arguments are checked here, since the wrappers assume valid ones.
+ */
+#include "bann.h"
+#include "ann_call.cpp"
+
+extern "C" {
+  int bann_api_version(void)
+  {
+    return BANN_API_VERSION;
+  }
+
+  int bann_idx_size(void)
+  {
+    return (int) sizeof(bann_idx);
+  }
+
+  static bann_index *bann_fail(int *status, int code)
+  {
+    if (status != NULL) {
+      *status = code;
+    }
+    return NULL;
+  }
+
+  bann_index *bann_create(const double *data, bann_idx n, int dim, long stride, int copy,
+                          int *status)
+  {
+    if (data == NULL || n <= 0 || dim <= 0 || stride < dim) {
+      return bann_fail(status, BANN_EINVAL);
+    }
+    if (status != NULL) {
+      *status = BANN_OK;
+    }
+    int split = ann_namespace::ANN_KD_SUGGEST;
+    return bann_index_build((double *) data, &n, &dim, &stride, &copy, &split);
+  }
+
+  bann_index *bann_open(const char *path, int verify, int *status)
+  {
+    if (path == NULL) {
+      return bann_fail(status, BANN_EINVAL);
+    }
+    int shared = 0;
+    int st;
+    bann_index *index = bann_index_load(path, &verify, &shared, &st);
+    if (status != NULL) {
+      *status = st;
+    }
+    return index;
+  }
+
+  bann_index *bann_attach(const char *name, int verify, int *status)
+  {
+    if (name == NULL) {
+      return bann_fail(status, BANN_EINVAL);
+    }
+    int shared = 1;
+    int st;
+    bann_index *index = bann_index_load(name, &verify, &shared, &st);
+    if (status != NULL) {
+      *status = st;
+    }
+    return index;
+  }
+
+  /* Metadata must fit the header with its terminating null */
+  static bool bann_meta_fits(const char *meta)
+  {
+    return meta == NULL || strlen(meta) < ann_namespace::ANN_BIN_META;
+  }
+
+  int bann_save(const bann_index *index, const char *path, const char *meta)
+  {
+    if (index == NULL || path == NULL || !bann_meta_fits(meta)) {
+      return BANN_EINVAL;
+    }
+    return bann_index_save((bann_index *) index, path, meta);
+  }
+
+  int bann_publish(const bann_index *index, const char *name, const char *meta)
+  {
+    if (index == NULL || name == NULL || !bann_meta_fits(meta)) {
+      return BANN_EINVAL;
+    }
+    return bann_index_publish((bann_index *) index, name, meta);
+  }
+
+  void bann_destroy(bann_index *index)
+  {
+    if (index != NULL) {
+      bann_index_free(index);
+    }
+  }
+
+  int bann_dim(const bann_index *index)
+  {
+    return index->dim;
+  }
+
+  bann_idx bann_size(const bann_index *index)
+  {
+    return index->nData;
+  }
+
+  int bann_knn(const bann_index *index, const double *queries, bann_idx nq, int k,
+               int div, double eps, bann_idx *indices, double *dists)
+  {
+    if (index == NULL || nq < 0 || (nq > 0 && (queries == NULL || indices == NULL)) ||
+        k <= 0 || k > index->nData || !knn_divergence(div)) {
+      return BANN_EINVAL;
+    }
+    int block = 1;
+    int order = 0;
+    int threads = 1;
+    bann_index_search((bann_index *) index, (double *) queries, &nq, &k, indices, dists,
+                      &eps, &div, &block, &order, &threads);
+    return BANN_OK;
+  }
+
+  int bann_hausdorff(const bann_index *index, const double *queries, bann_idx nq, int div,
+                     double eps, double *result, double *nn_dists)
+  {
+    if (index == NULL || nq < 0 || (nq > 0 && queries == NULL) || result == NULL ||
+        !haus_divergence(div)) {
+      return BANN_EINVAL;
+    }
+    *result = bann_index_haus((bann_index *) index, (double *) queries, &nq, &eps, &div,
+                              nn_dists, NULL);
+    return BANN_OK;
+  }
+
+  int bann_range(const bann_index *index, const double *queries, bann_idx nq, double radius,
+                 int div, double eps, bann_idx *counts, bann_idx *indices)
+  {
+    if (index == NULL || nq < 0 || (nq > 0 && (queries == NULL || counts == NULL)) ||
+        !knn_divergence(div)) {
+      return BANN_EINVAL;
+    }
+    std::vector<bann_idx> offsets(nq + 1);
+    bann_range_result *found;
+    int status = bann_range_all(index, queries, nq, &radius, 1, div, eps, indices != NULL,
+                                offsets.data(), &found);
+    if (status != BANN_OK) {
+      return status;
+    }
+    for (bann_idx i = 0; i < nq; i++) {
+      counts[i] = offsets[i + 1] - offsets[i];
+    }
+    if (indices != NULL) {
+      bann_range_result_copy(found, indices, NULL);
+    }
+    bann_range_result_free(found);
+    return BANN_OK;
+  }
+
+  int bann_range_all(const bann_index *index, const double *queries, bann_idx nq,
+                     const double *radii, bann_idx nradii, int div, double eps, int sorted,
+                     bann_idx *offsets, bann_range_result **result)
+  {
+    if (index == NULL || nq < 0 || (nq > 0 && queries == NULL) || offsets == NULL ||
+        result == NULL || radii == NULL || (nradii != 1 && nradii != nq) ||
+        !knn_divergence(div)) {
+      return BANN_EINVAL;
+    }
+    for (bann_idx i = 0; i < nradii; i++) {
+      if (!(radii[i] >= 0)) {
+        return BANN_EINVAL;
+      }
+    }
+    *result = bann_index_range_all((bann_index *) index, (double *) queries, &nq,
+                                   (double *) radii, &nradii, &eps, &div, &sorted, offsets);
+    return BANN_OK;
+  }
+
+  int bann_get_stats(const bann_index *index, bann_stats *stats)
+  {
+    if (index == NULL || stats == NULL) {
+      return BANN_EINVAL;
+    }
+    bann_idx st[8];
+    bann_index_stats((bann_index *) index, st, &stats->avg_ar);
+    stats->dim = (int) st[0];
+    stats->n_pts = st[1];
+    stats->bkt_size = (int) st[2];
+    stats->n_lf = st[3];
+    stats->n_tl = st[4];
+    stats->n_spl = st[5];
+    stats->n_shr = st[6];
+    stats->depth = (int) st[7];
+    return BANN_OK;
+  }
+}
@@ -30,6 +30,15 @@
 #include <ANNx.h>							// all ANN includes
 #include <ANNperf.h>						// ANN performance 
 
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+#ifdef __linux__
+  #include <sys/mman.h>						// huge page mappings
+#endif
+
 using namespace std;						// make std:: accessible
 
 //----------------------------------------------------------------------
@@ -101,7 +110,13 @@ void annPrintPt(						// print a point
 //
 //		annDeallocPts() should only be used on point arrays allocated
 //		by annAllocPts since it assumes that points are allocated in
-//		a block.
+//		a block.  The block starts on a cache line; rows in it are dim
+//		coordinates apart, or annRowStride() if pad is set, so that
+//		each starts on a SIMD boundary at the cost of the padding.
+//
+//		annViewPts() builds an array of points over coordinates that
+//		the caller owns, without copying them.  annDeallocViewPts()
+//		frees only the array.
 //
 //		annCopyPt() copies a point taking care to allocate storage
 //		for the new point.
@@ -118,12 +133,15 @@ ANNpoint annAllocPt(int dim, ANNcoord c)		// allocate 1 point
 	return p;
 }
    
-ANNpointArray annAllocPts(int n, int dim)		// allocate n pts in dim
+ANNpointArray annAllocPts(ANNidx n, int dim, ANNbool pad)	// allocate n pts
 {
-	ANNpointArray pa = new ANNpoint[n];			// allocate points
-	ANNpoint	  p  = new ANNcoord[n*dim];		// allocate space for coords
-	for (int i = 0; i < n; i++) {
-		pa[i] = &(p[i*dim]);
+	int stride = pad ? annRowStride(dim) : dim;	// coords between rows
+	ANNpointArray pa = new ANNpoint[n > 0 ? n : 1];	// allocate points
+	ANNpoint	  p  = (ANNpoint) annAllocAligned(	// allocate space for coords
+						(size_t) n * stride * sizeof(ANNcoord));
+	pa[0] = p;
+	for (ANNidx i = 0; i < n; i++) {
+		pa[i] = &(p[(size_t) i*stride]);
 	}
 	return pa;
 }
@@ -136,17 +154,174 @@ void annDeallocPt(ANNpoint &p)					// deallocate 1 point
    
 void annDeallocPts(ANNpointArray &pa)			// deallocate points
 {
-	delete [] pa[0];							// dealloc coordinate storage
+	annDeallocAligned(pa[0]);					// dealloc coordinate storage
 	delete [] pa;								// dealloc points
 	pa = NULL;
 }
    
+ANNpointArray annViewPts(ANNcoord *data, ANNidx n, long stride)	// view n pts
+{
+	ANNpointArray pa = new ANNpoint[n > 0 ? n : 1];	// allocate points
+	pa[0] = data;
+	for (ANNidx i = 0; i < n; i++) {
+		pa[i] = data + (ptrdiff_t) i*stride;
+	}
+	return pa;
+}
+
+void annDeallocViewPts(ANNpointArray &pa)		// deallocate point view
+{
+	delete [] pa;								// coordinates are not ours
+	pa = NULL;
+}
+
 ANNpoint annCopyPt(int dim, ANNpoint source)	// copy point
 {
 	ANNpoint p = new ANNcoord[dim];
 	for (int i = 0; i < dim; i++) p[i] = source[i];
 	return p;
 }
+
+//----------------------------------------------------------------------
+//	Aligned storage
+//		Blocks taken from explicit huge pages are mapped, not allocated,
+//		so they are remembered in ANNhugeBlocks until they are unmapped.
+//		Everything else comes from posix_memalign() and is released
+//		with free().  Blocks smaller than a huge page are never mapped,
+//		so callers that know the size free them without the lock.
+//----------------------------------------------------------------------
+
+static std::map<void*, size_t>	ANNhugeBlocks;	// mapped huge page blocks
+static std::mutex				ANNhugeLock;	// guards ANNhugeBlocks
+
+void* annAllocAligned(size_t bytes)				// allocate aligned storage
+{
+	void *p = NULL;
+	if (bytes == 0) bytes = 1;
+#ifdef __linux__
+	if (bytes >= ANN_HUGE_PAGE) {				// large enough for huge pages?
+		size_t len = (bytes + ANN_HUGE_PAGE - 1) / ANN_HUGE_PAGE * ANN_HUGE_PAGE;
+		p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (p != MAP_FAILED) {					// explicit huge pages
+			std::lock_guard<std::mutex> guard(ANNhugeLock);
+			ANNhugeBlocks[p] = len;
+			return p;
+		}
+		if (posix_memalign(&p, ANN_HUGE_PAGE, len) == 0) {
+			madvise(p, len, MADV_HUGEPAGE);		// transparent huge pages
+			return p;
+		}
+	}
+#endif
+	if (posix_memalign(&p, ANN_CACHE_LINE, bytes) != 0)
+		throw std::bad_alloc();
+	return p;
+}
+
+void annDeallocAligned(void *p)					// deallocate aligned storage
+{
+	if (p == NULL) return;
+#ifdef __linux__
+	{
+		std::lock_guard<std::mutex> guard(ANNhugeLock);
+		std::map<void*, size_t>::iterator b = ANNhugeBlocks.find(p);
+		if (b != ANNhugeBlocks.end()) {
+			munmap(p, b->second);
+			ANNhugeBlocks.erase(b);
+			return;
+		}
+	}
+#endif
+	free(p);
+}
+
+void annDeallocAligned(void *p, size_t bytes)	// deallocate, size known
+{
+	if (bytes < ANN_HUGE_PAGE)					// never mapped
+		free(p);
+	else
+		annDeallocAligned(p);
+}
+
+//----------------------------------------------------------------------
+//	Node storage
+//		Nodes are rounded up to whole cache lines and cut in turn from
+//		the last block of ANNnodeBlocks.  A freed node goes on the free
+//		list of its size, through its first word, and is reused by the
+//		next node of that size.  The blocks are released when the last
+//		node is freed.  Nodes of more than ANN_NODE_LINES lines, which
+//		the trees do not have, are left to annAllocAligned().
+//----------------------------------------------------------------------
+
+const size_t				ANN_NODE_LINES = 8;	// largest node (lines)
+static std::vector<void*>	ANNnodeBlocks;		// blocks holding nodes
+static char					*ANNnodeNext = NULL;	// free end of last block
+static size_t				ANNnodeLeft = 0;	// bytes left there
+static void					*ANNnodeFree[ANN_NODE_LINES + 1];	// by lines
+static size_t				ANNnodeLive = 0;	// nodes allocated
+static std::mutex			ANNnodeLock;		// guards the above
+
+void* annAllocNode(size_t bytes)				// allocate a tree node
+{
+	size_t lines = (bytes + ANN_CACHE_LINE - 1) / ANN_CACHE_LINE;
+	if (lines == 0) lines = 1;
+	if (lines > ANN_NODE_LINES)					// too large for the blocks
+		return annAllocAligned(bytes);
+
+	std::lock_guard<std::mutex> guard(ANNnodeLock);
+	void *p = ANNnodeFree[lines];
+	if (p != NULL) {							// reuse a freed node
+		ANNnodeFree[lines] = *(void **) p;
+	}
+	else {										// cut a new one
+		size_t len = lines * ANN_CACHE_LINE;
+		if (ANNnodeLeft < len) {
+			ANNnodeNext = (char *) annAllocAligned(ANN_HUGE_PAGE);
+			ANNnodeBlocks.push_back(ANNnodeNext);
+			ANNnodeLeft = ANN_HUGE_PAGE;
+		}
+		p = ANNnodeNext;
+		ANNnodeNext += len;
+		ANNnodeLeft -= len;
+	}
+	ANNnodeLive++;
+	return p;
+}
+
+void annDeallocNode(void *p, size_t bytes)		// deallocate a tree node
+{
+	if (p == NULL) return;
+	size_t lines = (bytes + ANN_CACHE_LINE - 1) / ANN_CACHE_LINE;
+	if (lines == 0) lines = 1;
+	if (lines > ANN_NODE_LINES) {
+		annDeallocAligned(p, bytes);
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard(ANNnodeLock);
+	*(void **) p = ANNnodeFree[lines];
+	ANNnodeFree[lines] = p;
+	if (--ANNnodeLive == 0) {					// last node: release blocks
+		for (size_t i = 0; i < ANNnodeBlocks.size(); i++)
+			annDeallocAligned(ANNnodeBlocks[i]);
+		ANNnodeBlocks.clear();
+		ANNnodeNext = NULL;
+		ANNnodeLeft = 0;
+		for (size_t l = 0; l <= ANN_NODE_LINES; l++)
+			ANNnodeFree[l] = NULL;
+	}
+}
+
+int annRowStride(int dim)						// coords between rows
+{
+	const int simd = ANN_CACHE_LINE / sizeof(ANNcoord);
+	if (dim > simd)								// long rows: whole lines
+		return (dim + simd - 1) / simd * simd;
+	int stride = 1;								// short rows: power of 2
+	while (stride < dim) stride *= 2;
+	return stride;
+}
    
 												// assign one rect to another
 void annAssignRect(int dim, ANNorthRect &dest, const ANNorthRect &source)
@@ -192,7 +367,7 @@ void annError(const char* msg, ANNerr level)
 //----------------------------------------------------------------------
 
 int	ANNmaxPtsVisited = 0;	// maximum number of pts visited
-int	ANNptsVisited;			// number of pts visited in search
+thread_local ANNidx	ANNptsVisited;			// number of pts visited in search
 
 //----------------------------------------------------------------------
 //	Global function declarations
@@ -203,3 +378,65 @@ void annMaxPtsVisit(			// set limit on max. pts to visit in search
 {
 	ANNmaxPtsVisited = maxPts;
 }
+
+//----------------------------------------------------------------------
+//	Search budgets
+//		Unlike ANNmaxPtsVisited, a budget is set per thread, and bounds
+//		the leaves visited and the time taken as well.  It is checked
+//		by the standard and priority searches at each node they are
+//		about to enter (the leaf being scanned is finished), so a
+//		search may overrun it by one bucket.  A search stopped by its
+//		budget returns the closest points found so far, padded with
+//		ANN_NULL_IDX at distance ANN_DIST_INF, and sets ANNtruncated.
+//		The clock is only read at every 16th check.
+//----------------------------------------------------------------------
+
+thread_local ANNbool	ANNbudgetOn;			// is a budget set?
+thread_local ANNbool	ANNtruncated;			// search stopped on budget?
+thread_local int		ANNleavesVisited;		// leaves visited in search
+
+static thread_local int		ANNbudgetPts;		// max. pts to visit (0 none)
+static thread_local int		ANNbudgetLeaves;	// max. leaves to visit (0 none)
+static thread_local double	ANNbudgetTime;		// max. seconds (0 none)
+static thread_local int		ANNbudgetChecks;	// checks since clock read
+static thread_local std::chrono::steady_clock::time_point ANNbudgetEnd;
+
+void annSearchBudget(			// set the budget of each search
+	int					maxPts,			// max. pts to visit (0 for none)
+	int					maxLeaves,		// max. leaves to visit (0 for none)
+	double				maxTime)		// max. seconds (0 for none)
+{
+	ANNbudgetPts = maxPts > 0 ? maxPts : 0;
+	ANNbudgetLeaves = maxLeaves > 0 ? maxLeaves : 0;
+	ANNbudgetTime = maxTime > 0 ? maxTime : 0;
+	ANNbudgetOn = (ANNbool) (ANNbudgetPts > 0 || ANNbudgetLeaves > 0 || ANNbudgetTime > 0);
+}
+
+ANNbool annSearchTruncated()	// did the last search stop on budget?
+{
+	return ANNtruncated;
+}
+
+void annBudgetStart()			// start the budget of a search
+{
+	ANNtruncated = ANNfalse;
+	ANNleavesVisited = 0;
+	ANNbudgetChecks = 0;
+	if (ANNbudgetTime > 0) {
+		ANNbudgetEnd = std::chrono::steady_clock::now() +
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>(ANNbudgetTime));
+	}
+}
+
+ANNbool annBudgetSpent()		// is the budget of the search spent?
+{
+	if (!ANNtruncated &&
+		((ANNbudgetPts > 0 && ANNptsVisited >= ANNbudgetPts) ||
+		 (ANNbudgetLeaves > 0 && ANNleavesVisited >= ANNbudgetLeaves) ||
+		 (ANNbudgetTime > 0 && (ANNbudgetChecks++ & 15) == 0 &&
+		  std::chrono::steady_clock::now() >= ANNbudgetEnd))) {
+		ANNtruncated = ANNtrue;
+	}
+	return ANNtruncated;
+}
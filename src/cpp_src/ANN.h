@@ -93,6 +93,7 @@
 #include <cmath>			// math includes
 #include <iostream>			// I/O streams
 #include <cstring>			// C-style strings
+#include <vector>			// growable arrays (annRangeSearch)
 /// #include <cassert>
 
 #define assert(ignore) ((void)0)
@@ -174,9 +175,19 @@ typedef double	ANNdist;				// distance data type
 //		there are not k nearest neighbors within the search radius.  To
 //		indicate this, the algorithm returns ANN_NULL_IDX as its result.
 //		It should be distinguishable from any valid array index.
+//
+//		ANNidx is also the type of point counts, so it bounds the size
+//		of the point set.  It is a 32-bit int unless ANN_IDX64 is
+//		defined at compile time, in which case it is 64 bits wide and
+//		more than 2^31 points may be indexed, at the cost of twice the
+//		memory for the point permutation and the result arrays.
 //----------------------------------------------------------------------
 
+#ifdef ANN_IDX64
+typedef long long	ANNidx;				// point index (64 bits)
+#else
 typedef int		ANNidx;					// point index
+#endif
 const ANNidx	ANN_NULL_IDX = -1;		// a NULL point index
 
 //----------------------------------------------------------------------
@@ -424,13 +435,45 @@ typedef ANNidx*   ANNidxArray;		// an array of point indices
 //				points to point to their respective coordinates.  It
 //				allocates point storage in a contiguous block large
 //				enough to store all the points.  It performs no
-//				initialization.
+//				initialization.  The block comes from annAllocAligned()
+//				and consecutive points are dim coordinates apart, or
+//				annRowStride() apart if pad is set.
+//
+//		annViewPts() and annDeallocViewPts():
+//				Allocate and deallocate an array of points over
+//				coordinates that are stored elsewhere, such as a
+//				caller's buffer.  Point i is taken to start at
+//				data + i*stride, so rows may be padded or strided, but
+//				the coordinates of a point must be consecutive.  No
+//				coordinates are copied or freed; the caller must keep
+//				them alive and unchanged while the array is in use.
 //
 //		annCopyPt():
 //				Creates a copy of a given point, allocating space for
 //				the new point.  It returns a pointer to the newly
 //				allocated copy.
+//
+//		annAllocAligned() and annDeallocAligned():
+//				Allocate and deallocate storage aligned to a cache
+//				line.  Blocks of at least ANN_HUGE_PAGE bytes are taken
+//				from explicit huge pages when the system has them
+//				reserved; otherwise they are aligned to a huge page and
+//				marked for transparent huge pages.  Each step falls
+//				back quietly to the next when it is not available.
+//				Given the size of the block, annDeallocAligned() frees
+//				blocks smaller than a huge page without a lookup.
+//
+//		annRowStride():
+//				The number of coordinates between consecutive points
+//				of an array allocated by annAllocPts() with pad set.
+//				Rows of up to 8 coordinates are padded to a power of 2,
+//				and longer rows to a multiple of 8, so that every row
+//				starts on a SIMD boundary and short rows never straddle
+//				a cache line.
 //----------------------------------------------------------------------
+
+const size_t	ANN_CACHE_LINE	= 64;			// cache line (bytes)
+const size_t	ANN_HUGE_PAGE	= 2 << 20;		// huge page (bytes)
    
 DLL_API ANNdist annDist(
 	int				dim,		// dimension of space
@@ -442,8 +485,9 @@ DLL_API ANNpoint annAllocPt(
 	ANNcoord		c = 0);		// coordinate value (all equal)
 
 DLL_API ANNpointArray annAllocPts(
-	int				n,			// number of points
-	int				dim);		// dimension
+	ANNidx			n,			// number of points
+	int				dim,		// dimension
+	ANNbool			pad = ANNfalse);	// pad rows to annRowStride()?
 
 DLL_API void annDeallocPt(
 	ANNpoint		&p);		// deallocate 1 point
@@ -451,10 +495,31 @@ DLL_API void annDeallocPt(
 DLL_API void annDeallocPts(
 	ANNpointArray	&pa);		// point array
 
+DLL_API ANNpointArray annViewPts(
+	ANNcoord		*data,		// coordinates of the first point
+	ANNidx			n,			// number of points
+	long			stride);	// coords between points
+
+DLL_API void annDeallocViewPts(
+	ANNpointArray	&pa);		// point array
+
 DLL_API ANNpoint annCopyPt(
 	int				dim,		// dimension
 	ANNpoint		source);	// point to copy
 
+DLL_API void* annAllocAligned(
+	size_t			bytes);		// number of bytes
+
+DLL_API void annDeallocAligned(
+	void			*p);		// storage to deallocate
+
+DLL_API void annDeallocAligned(
+	void			*p,			// storage to deallocate
+	size_t			bytes);		// its size
+
+DLL_API int annRowStride(
+	int				dim);		// dimension
+
 //----------------------------------------------------------------------
 //Overall structure: ANN supports a number of different data structures
 //for approximate and exact nearest neighbor searching.  These are:
@@ -491,7 +556,9 @@ DLL_API ANNpoint annCopyPt(
 //		The search algorithm, annkFRSearch, is a fixed-radius kNN
 //		search.  In addition to a query point, it is given a (squared)
 //		radius bound.  (This is done for consistency, because the search
-//		returns distances as squared quantities.) It does two things.
+//		returns distances as squared quantities.)  For a Bregman
+//		divergence the bound is a divergence, measured in the same
+//		direction as for annkSearch.  It does two things.
 //		First, it computes the k nearest neighbors within the radius
 //		bound, and second, it returns the total number of points lying
 //		within the radius bound. It is permitted to set k = 0, in which
@@ -528,7 +595,8 @@ public:
 	   double         haus = 0.0
       ) = 0;
 
-	virtual int annkFRSearch(			// approx fixed-radius kNN search
+	virtual ANNidx annkFRSearch(		// approx fixed-radius kNN search
+		divergence		div_component,	// div choice
 		ANNpoint			q,				// query point
 		ANNdist			sqRad,			// squared radius
 		int				k = 0,			// number of near neighbors to return
@@ -538,7 +606,7 @@ public:
 		) = 0;							// pure virtual (defined elsewhere)
 
 	virtual int theDim() = 0;			// return dimension of space
-	virtual int nPoints() = 0;			// return number of points
+	virtual ANNidx nPoints() = 0;		// return number of points
 										// return pointer to points
 	virtual ANNpointArray thePoints() = 0;
 };
@@ -565,12 +633,12 @@ public:
 
 class DLL_API ANNbruteForce: public ANNpointSet {
 	int				dim;				// dimension
-	int				n_pts;				// number of points
+	ANNidx			n_pts;				// number of points
 	ANNpointArray	pts;				// point array
 public:
 	ANNbruteForce(						// constructor from point array
 		ANNpointArray	pa,				// point array
-		int				n,				// number of points
+		ANNidx			n,				// number of points
 		int				dd);			// dimension
 
 	~ANNbruteForce();					// destructor
@@ -591,7 +659,8 @@ public:
       double         eps = 0.0,
       double         haus = 0.0);
 
-	int annkFRSearch(					// approx fixed-radius kNN search
+	ANNidx annkFRSearch(				// approx fixed-radius kNN search
+		divergence		div_component,	// div choice
 		ANNpoint		q,				// query point
 		ANNdist			sqRad,			// squared radius
 		int				k = 0,			// number of near neighbors to return
@@ -602,7 +671,7 @@ public:
 	int theDim()						// return dimension of space
 		{ return dim; }
 
-	int nPoints()						// return number of points
+	ANNidx nPoints()					// return number of points
 		{ return n_pts; }
 
 	ANNpointArray thePoints()			// return pointer to points
@@ -624,6 +693,14 @@ public:
 //		subjectively) by the implementors as the one giving the
 //		fastest performance, and is the default splitting method.
 //
+//		ANN_KD_SQRT_MIDPT and ANN_KD_LOG_MIDPT apply the sliding
+//		midpoint rule in coordinates where the Kullback-Leibler
+//		(sqrt x) and Itakura-Saito (log x) divergences are locally
+//		Euclidean, which gives better shaped cells for these
+//		divergences on data spread over several orders of magnitude.
+//		Cells reaching nonpositive coordinates are split as by
+//		ANN_KD_SL_MIDPT.  See kd_split.cpp.
+//
 //		As with splitting rules, there are a number of different
 //		shrinking rules.  The shrinking rule ANN_BD_NONE does no
 //		shrinking (and hence produces a kd-tree tree).  The rule
@@ -636,8 +713,10 @@ enum ANNsplitRule {
 		ANN_KD_FAIR				= 2,	// fair split
 		ANN_KD_SL_MIDPT			= 3,	// sliding midpoint splitting method
 		ANN_KD_SL_FAIR			= 4,	// sliding fair split method
-		ANN_KD_SUGGEST			= 5};	// the authors' suggestion for best
-const int ANN_N_SPLIT_RULES		= 6;	// number of split rules
+		ANN_KD_SUGGEST			= 5,	// the authors' suggestion for best
+		ANN_KD_SQRT_MIDPT		= 6,	// sliding midpoint in sqrt coordinates
+		ANN_KD_LOG_MIDPT		= 7};	// sliding midpoint in log coordinates
+const int ANN_N_SPLIT_RULES		= 8;	// number of split rules
 
 enum ANNshrinkRule {
 		ANN_BD_NONE				= 0,	// no shrinking at all (just kd-tree)
@@ -646,6 +725,12 @@ enum ANNshrinkRule {
 		ANN_BD_SUGGEST			= 3};	// the authors' suggested choice
 const int ANN_N_SHRINK_RULES	= 4;	// number of shrink rules
 
+enum ANNbuildKind {
+		ANN_BUILD_UNKNOWN		= 0,	// not recorded (read from a dump)
+		ANN_BUILD_SPLIT			= 1,	// by a splitting rule
+		ANN_BUILD_WORKLOAD		= 2,	// for a query workload
+		ANN_BUILD_SUBSPACE		= 3};	// along a coordinate subset
+
 //----------------------------------------------------------------------
 //	kd-tree:
 //		The main search data structure supported by ANN is a kd-tree.
@@ -660,7 +745,16 @@ const int ANN_N_SHRINK_RULES	= 4;	// number of shrink rules
 //		is assumed to be kept constant throughout the lifetime of the
 //		search structure.  There is also a "load" constructor that
 //		builds a tree from a file description that was created by the
-//		Dump operation.
+//		Dump operation.  With lazy set, subtrees are only built when a
+//		search first reaches them (see kd_lazy.cpp), which saves most of
+//		the construction when a tree is searched once and in part, as
+//		by a Hausdorff search.  A third constructor is given a sample of
+//		queries, the divergence and the number of neighbours they are
+//		searched with, and cuts the cells their searches reach finely
+//		and the others coarsely (see kd_workload.cpp).  A fourth is
+//		given a subset of the coordinates and cuts along those only,
+//		for high-dimensional points varying mostly within them (see
+//		kd_subspace.cpp); annRankDims() helps choosing them.
 //
 //		Search:
 //		-------
@@ -675,6 +769,49 @@ const int ANN_N_SHRINK_RULES	= 4;	// number of shrink rules
 //				distributions the standard search seems to work just
 //				fine, but priority search is safer for worst-case
 //				performance.
+//			Seeded search (annkSearchSeeded()):
+//				Standard search that first compares the query with
+//				candidate points, e.g. the neighbours of the previous
+//				query, so that the k-th closest distance bounds the
+//				traversal from the start.
+//
+//			Range search (annRangeSearch()):
+//				Fixed-radius search (see annkFRSearch()) reporting every
+//				point within the radius, appended to growable arrays in
+//				a single pass, instead of the k closest of them.
+//
+//			Range counting (annRangeCount()):
+//				The number of points within the radius.  Subtrees whose
+//				cells lie inside the ball are counted from the number
+//				of points stored in their nodes, without visiting them.
+//
+//			Block search (annkSearchBlock()):
+//				Standard search for a block of queries at once.  The
+//				block descends the tree together, and each leaf bucket
+//				is compared against all the queries of the block that
+//				reach it, while the bucket is in cache.  This pays off
+//				when neighbouring queries of the block lie close
+//				together.
+//
+//			Query ordering (annLeafOrder()):
+//				Gives an order of a set of queries in which queries
+//				falling into the same or nearby leaves are consecutive,
+//				found by descending the tree once per query.  Searching
+//				queries in this order, alone or in blocks, finds the
+//				nodes and buckets of the previous query still in cache.
+//
+//			Dual-tree search (annkDualSearch()):
+//				Standard search for all the points of a second kd-tree
+//				at once, by walking pairs of nodes of both trees.  A
+//				pair is pruned when the lower bound on the divergence
+//				between the boxes of its nodes exceeds the k-th closest
+//				distance of every query of the query node, so whole
+//				cells of queries are pruned together.
+//
+//			Block and dual-tree searches return for each query the
+//			result of annkSearch(), up to the order in which ties are
+//			broken and, for eps > 0, the choice among points within
+//			the error bound.
 //
 //		Printing:
 //		---------
@@ -738,37 +875,62 @@ const int ANN_N_SHRINK_RULES	= 4;	// number of shrink rules
 class ANNkdStats;				// stats on kd-tree
 class ANNkd_node;				// generic node in a kd-tree
 typedef ANNkd_node*	ANNkd_ptr;	// pointer to a kd-tree node
+struct ANNbinNode;				// node record of a flattened kd-tree
 
 class DLL_API ANNkd_tree: public ANNpointSet {
 protected:
 	int				dim;				// dimension of space
-	int				n_pts;				// number of points in tree
+	ANNidx			n_pts;				// number of points in tree
 	int				bkt_size;			// bucket size
 	ANNpointArray	pts;				// the points
 	ANNidxArray		pidx;				// point indices (to pts array)
 	ANNkd_ptr		root;				// root of kd-tree
 	ANNpoint		bnd_box_lo;			// bounding box low point
 	ANNpoint		bnd_box_hi;			// bounding box high point
+	int				split_rule;			// ANNsplitRule built by, or -1
+	ANNbuildKind	build_kind;			// how the tree was built
 
 	void SkeletonTree(					// construct skeleton tree
-		int				n,				// number of points
+		ANNidx			n,				// number of points
 		int				dd,				// dimension
 		int				bs,				// bucket size
 		ANNpointArray pa = NULL,		// point array (optional)
 		ANNidxArray pi = NULL);			// point indices (optional)
 
+	ANNbinNode *flattenTree(			// nodes in preorder (new[])
+		long long		&n_nodes);		// number of nodes (returned)
+
 public:
 	ANNkd_tree(							// build skeleton tree
-		int				n = 0,			// number of points
+		ANNidx			n = 0,			// number of points
 		int				dd = 0,			// dimension
 		int				bs = 1);		// bucket size
 
 	ANNkd_tree(							// build from point array
 		ANNpointArray	pa,				// point array
-		int				n,				// number of points
+		ANNidx			n,				// number of points
 		int				dd,				// dimension
 		int				bs = 1,			// bucket size
-		ANNsplitRule	split = ANN_KD_SUGGEST);	// splitting method
+		ANNsplitRule	split = ANN_KD_SUGGEST,	// splitting method
+		ANNbool			lazy = ANNfalse);	// build subtrees when first searched
+
+	ANNkd_tree(							// build for a query workload
+		ANNpointArray	pa,				// point array
+		ANNidx			n,				// number of points
+		int				dd,				// dimension
+		divergence		div_component,	// divergence of the searches
+		ANNpointArray	qa,				// sample of queries
+		ANNidx			nq,				// number of queries
+		int				k = 1,			// number of near neighbors searched
+		int				max_bkt = 8);	// largest bucket size
+
+	ANNkd_tree(							// build along a coordinate subset
+		ANNpointArray	pa,				// point array
+		ANNidx			n,				// number of points
+		int				dd,				// dimension
+		const int		*dims,			// coordinates to cut
+		int				n_dims,			// number of them
+		int				max_bkt = 8);	// largest bucket size
 
 	ANNkd_tree(							// build from dump file
 		std::istream&	in);			// input stream for dump file
@@ -782,6 +944,38 @@ public:
 		ANNidxArray		nn_idx,			// nearest neighbor array (modified)
 		ANNdistArray	dd,				// dist to near neighbors (modified)
 		double			eps=0.0);		// error bound
+
+	void annkSearchSeeded(				// approx k near neighbor search
+		divergence		div_component,	// div choice
+		ANNpoint		q,				// query point
+		int				k,				// number of near neighbors to return
+		ANNidxArray		seeds,			// candidate point indices
+		int				n_seeds,		// number of candidates
+		ANNidxArray		nn_idx,			// nearest neighbor array (modified)
+		ANNdistArray	dd,				// dist to near neighbors (modified)
+		double			eps=0.0);		// error bound
+
+	void annkSearchBlock(				// approx k near neighbor search
+		divergence		div_component,	// div choice
+		ANNpointArray	qa,				// query points
+		int				nq,				// number of query points
+		int				k,				// number of near neighbors to return
+		ANNidxArray		nn_idx,			// nearest neighbors (nq*k, modified)
+		ANNdistArray	dd,				// dist to near neighbors (nq*k, modified)
+		double			eps=0.0);		// error bound
+
+	void annLeafOrder(					// order queries by their leaves
+		ANNpointArray	qa,				// query points
+		ANNidx			nq,				// number of query points
+		ANNidxArray		order);			// query order (nq, returned)
+
+	void annkDualSearch(				// dual-tree k near neighbor search
+		divergence		div_component,	// div choice
+		ANNkd_tree		*qtree,			// kd-tree over the query points
+		int				k,				// number of near neighbors to return
+		ANNidxArray		nn_idx,			// nearest neighbors (nq*k, modified)
+		ANNdistArray	dd,				// dist to near neighbors (nq*k, modified)
+		double			eps=0.0);		// error bound
    
    void annhSearch(
       divergence     div_component,
@@ -799,7 +993,8 @@ public:
 		ANNdistArray	dd,				// dist to near neighbors (modified)
 		double			eps=0.0);		// error bound
   
-	int annkFRSearch(					// approx fixed-radius kNN search
+	ANNidx annkFRSearch(				// approx fixed-radius kNN search
+		divergence		div_component,	// div choice
 		ANNpoint		q,				// the query point
 		ANNdist			sqRad,			// squared radius of query ball
 		int				k,				// number of neighbors to return
@@ -807,15 +1002,41 @@ public:
 		ANNdistArray	dd = NULL,		// dist to near neighbors (modified)
 		double			eps=0.0);		// error bound
 
+	ANNidx annRangeCount(				// number of points within a radius
+		divergence		div_component,	// div choice
+		ANNpoint		q,				// the query point
+		ANNdist			sqRad,			// squared radius of query ball
+		double			eps=0.0);		// error bound
+
+	ANNidx annRangeSearch(				// all points within a radius
+		divergence		div_component,	// div choice
+		ANNpoint		q,				// the query point
+		ANNdist			sqRad,			// squared radius of query ball
+		std::vector<ANNidx>	&nn_idx,	// points in range (appended)
+		std::vector<ANNdist> &dd,		// their distances (appended)
+		ANNbool			sorted = ANNtrue,	// closest first?
+		double			eps=0.0);		// error bound
+
 	int theDim()						// return dimension of space
 		{ return dim; }
 
-	int nPoints()						// return number of points
+	ANNidx nPoints()					// return number of points
 		{ return n_pts; }
 
 	ANNpointArray thePoints()			// return pointer to points
 		{  return pts;  }
 
+	int splitRule()						// splitting rule, or -1 if none
+		{ return split_rule; }
+
+	ANNbuildKind buildKind()			// how the tree was built
+		{ return build_kind; }
+
+	int SaveBinary(						// save in binary format
+		const char		*path,			// file (or segment) to write
+		const char		*meta = NULL,	// build metadata (may be NULL)
+		ANNbool			shared = ANNfalse);	// path names a shm segment?
+
 	virtual void Print(					// print the tree (for debugging)
 		ANNbool			with_pts,		// print points as well?
 		std::ostream&	out);			// output stream
@@ -828,6 +1049,13 @@ public:
 		ANNkdStats&		st);			// the statistics (modified)
 };								
 
+DLL_API void annRankDims(				// order coordinates by importance
+	ANNpointArray	pa,					// point array
+	ANNidx			n,					// number of points
+	int				dd,					// dimension
+	divergence		div_component,		// divergence, or empty for spread
+	int				*rank);				// coordinates (returned)
+
 //----------------------------------------------------------------------
 //	Box decomposition tree (bd-tree)
 //		The bd-tree is inherited from a kd-tree.  The main difference
@@ -844,14 +1072,14 @@ public:
 class DLL_API ANNbd_tree: public ANNkd_tree {
 public:
 	ANNbd_tree(							// build skeleton tree
-		int				n,				// number of points
+		ANNidx			n,				// number of points
 		int				dd,				// dimension
 		int				bs = 1)			// bucket size
 		: ANNkd_tree(n, dd, bs) {}		// build base kd-tree
 
 	ANNbd_tree(							// build from point array
 		ANNpointArray	pa,				// point array
-		int				n,				// number of points
+		ANNidx			n,				// number of points
 		int				dd,				// dimension
 		int				bs = 1,			// bucket size
 		ANNsplitRule	split  = ANN_KD_SUGGEST,	// splitting rule
@@ -861,10 +1089,191 @@ public:
 		std::istream&	in);			// input stream for dump file
 };
 
+//----------------------------------------------------------------------
+//	NUMA-replicated kd-tree
+//		On machines with several NUMA nodes, a tree built by one thread
+//		has all of its nodes and points in that thread's local memory,
+//		so searches running on the other nodes pay remote latency at
+//		every leaf.  ANNkd_replicas keeps one copy of the point store
+//		and of the kd-tree per node.  Each replica is built by a thread
+//		pinned to its node, so that first-touch placement keeps its
+//		pages local.  A search worker calls bindWorker(), which pins the
+//		worker to the node of its replica and returns the local tree.
+//
+//		The number of nodes is read from /sys/devices/system/node.  A
+//		positive n_nodes overrides it, which simulates the placement
+//		policy on machines with fewer nodes; replicas whose node does
+//		not physically exist are built and searched without pinning.
+//		Workers are assigned to replicas round robin.
+//
+//		A single replica is built over the caller's points unless copy
+//		is set; several are always copies, padded if pad is set (see
+//		annAllocPts()).  The queries served by each replica add up over
+//		the lifetime of the replicas.
+//----------------------------------------------------------------------
+
+DLL_API int annNumaNodes();		// number of NUMA nodes (at least 1)
+
+class DLL_API ANNkd_replicas {
+	int				dim;				// dimension of space
+	ANNidx			n_pts;				// number of points
+	int				n_repl;				// number of replicas (one per node)
+	ANNbool			simulated;			// node count overridden?
+	ANNbool			copied;				// are the point stores ours?
+	ANNpointArray	*repl_pts;			// point store of each replica
+	ANNkd_tree		**repl_tree;		// kd-tree of each replica
+	int				*repl_node;			// node of each replica (-1 if none)
+	ANNidx			*repl_served;		// queries served by each replica
+public:
+	ANNkd_replicas(						// build one replica per node
+		ANNpointArray	pa,				// point array
+		ANNidx			n,				// number of points
+		int				dd,				// dimension
+		int				bs = 1,			// bucket size
+		ANNsplitRule	split = ANN_KD_SUGGEST,	// splitting method
+		int				n_nodes = 0,	// number of nodes (0 = detect)
+		ANNbool			copy = ANNfalse,	// copy a single replica?
+		ANNbool			pad = ANNfalse);	// pad rows of the copies?
+
+	~ANNkd_replicas();					// destructor
+
+	ANNkd_tree* bindWorker(				// bind calling thread to a replica
+		int				worker);		// worker number
+
+	void served(						// record queries served
+		int				r,				// replica
+		ANNidx			nq);			// number of queries
+
+	int nReplicas()						// number of replicas
+		{ return n_repl; }
+
+	ANNbool isSimulated()				// is the node count simulated?
+		{ return simulated; }
+
+	int replicaOf(int worker)			// replica of a worker
+		{ return worker % n_repl; }
+
+	int replicaNode(int r)				// node holding replica r
+		{ return repl_node[r]; }
+
+	ANNidx replicaServed(int r)			// queries served by replica r
+		{ return repl_served[r]; }
+
+	ANNpointArray replicaPoints(int r)	// point store of replica r
+		{ return repl_pts[r]; }
+
+	ANNkd_tree* replicaTree(int r)		// kd-tree of replica r
+		{ return repl_tree[r]; }
+};
+
+//----------------------------------------------------------------------
+//	Binary kd-tree files
+//		The text format written by Dump() is parsed coordinate by
+//		coordinate, which for large trees takes longer than building
+//		them again.  SaveBinary() writes a versioned binary file that
+//		is used where it lies:
+//
+//			header		ANNbinHeader (magic, version, layout, how the
+//						tree was built, build metadata, section
+//						offsets and checksums)
+//			points		n_pts rows of dim coordinates
+//			indices		the point permutation (pidx)
+//			nodes		the tree in preorder, as ANNbinNode records
+//			box			lower and upper corners of the bounding box
+//
+//		Each section starts on a page boundary.  ANNkd_mapped maps the
+//		file read-only and searches the points and indices in place, so
+//		they are paged in lazily by the searches that touch them; only
+//		the node records are read at load time, to rebuild the nodes.
+//		The header and node checksums are always checked, and those of
+//		the points, indices and box when verify is set (this reads the
+//		whole file).  Checksums are FNV-1a over 64-bit words.
+//
+//		SaveBinary() and the ANNkd_mapped constructor report failures
+//		through an ANNbinStatus rather than aborting, since the file
+//		may come from elsewhere.  Only kd-trees can be saved; files are
+//		read on machines of the same byte order and type sizes only.
+//
+//		With shared set, path is the name of a POSIX shared memory
+//		segment ("/name") instead of a file.  SaveBinary() creates the
+//		segment, and fails if it exists already, since processes that
+//		have it mapped would see it change.  The header is written
+//		last, so a segment that is still being written is rejected by
+//		ANNkd_mapped as not a kd-tree file.  Every process that maps
+//		the segment shares its physical pages, and a mapping stays
+//		valid when the writer exits or annUnlinkShared() removes the
+//		name; the memory is released when the last mapping is gone.
+//		Shared segments are only supported on Linux.
+//----------------------------------------------------------------------
+
+enum ANNbinStatus {
+		ANN_BIN_OK			= 0,		// success
+		ANN_BIN_IO			= 1,		// file cannot be opened, read or written
+		ANN_BIN_FORMAT		= 2,		// not a (compatible) binary kd-tree file
+		ANN_BIN_CHECKSUM	= 3,		// contents do not match their checksum
+		ANN_BIN_UNSUPPORTED	= 4,		// tree cannot be saved (bd-tree)
+		ANN_BIN_EXISTS		= 5};		// shared segment exists already
+
+const int		ANN_BIN_VERSION	= 3;			// binary format version
+const int		ANN_BIN_META	= 256;			// bytes of build metadata
+
+struct ANNbinHeader {					// header of a binary kd-tree file
+	char			magic[8];			// "BANNKDT" and a NUL
+	int				version;			// format version
+	int				header_size;		// sizeof(ANNbinHeader)
+	int				byte_order;			// 0x01020304 as written
+	int				coord_size;			// sizeof(ANNcoord)
+	int				idx_size;			// sizeof(ANNidx)
+	int				dim;				// dimension of space
+	int				bkt_size;			// bucket size
+	int				split;				// splitRule() of the tree
+	int				build;				// buildKind() of the tree
+	int				reserved;			// zero
+	long long		n_pts;				// number of points
+	long long		n_nodes;			// number of node records
+	long long		build_time;			// seconds since the epoch
+	char			ann_version[16];	// ANNversion of the writer
+	char			meta[ANN_BIN_META];	// build metadata (NUL terminated)
+	long long		offset[4];			// offsets of points, indices,
+										//   nodes and box (bytes)
+	unsigned long long checksum[4];		// checksums of the sections
+	unsigned long long header_sum;		// checksum of the fields above
+};
+
+class DLL_API ANNkd_mapped: public ANNkd_tree {
+	void			*map_base;			// start of the mapping
+	size_t			map_size;			// size of the mapping
+	ANNbool			mapped;				// mapped (or read into memory)?
+	ANNbinHeader	hdr;				// copy of the file header
+	ANNbinStatus	st;					// status of the load
+public:
+	ANNkd_mapped(						// map a binary kd-tree file
+		const char		*path,			// file to map
+		ANNbool			verify = ANNfalse,	// check all checksums?
+		ANNbool			shared = ANNfalse);	// path names a shm segment?
+
+	~ANNkd_mapped();					// unmap the file
+
+	ANNbinStatus status()				// status of the load
+		{ return st; }
+
+	const ANNbinHeader& header()		// header of the file
+		{ return hdr; }
+};
+
+DLL_API int annUnlinkShared(			// remove a shared segment name
+	const char			*name);			// segment name
+
 //----------------------------------------------------------------------
 //	Other functions
 //	annMaxPtsVisit		Sets a limit on the maximum number of points
 //						to visit in the search.
+//	annSearchBudget		Sets limits on the points and leaves visited
+//						and the time taken by each standard or
+//						priority search (annkSearch(), annkPriSearch()
+//						and annkSearchSeeded()) on the calling thread.
+//	annSearchTruncated	Whether the last such search on the calling
+//						thread was stopped by its budget.
 //  annClose			Can be called when all use of ANN is finished.
 //						It clears up a minor memory leak.
 //----------------------------------------------------------------------
@@ -872,6 +1281,13 @@ public:
 DLL_API void annMaxPtsVisit(	// max. pts to visit in search
 	int				maxPts);	// the limit
 
+DLL_API void annSearchBudget(	// budget of each search on this thread
+	int				maxPts,		// max. pts to visit (0 for no limit)
+	int				maxLeaves,	// max. leaves to visit (0 for no limit)
+	double			maxTime);	// max. seconds (0 for no limit)
+
+DLL_API ANNbool annSearchTruncated();	// last search stopped on budget?
+
 DLL_API void annClose();		// called to end use of ANN
 
 #endif
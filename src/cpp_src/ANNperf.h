@@ -45,18 +45,18 @@
 class ANNkdStats {			// stats on kd-tree
 public:
 	int		dim;			// dimension of space
-	int		n_pts;			// no. of points
+	ANNidx	n_pts;			// no. of points
 	int		bkt_size;		// bucket size
-	int		n_lf;			// no. of leaves (including trivial)
-	int		n_tl;			// no. of trivial leaves (no points)
-	int		n_spl;			// no. of splitting nodes
-	int		n_shr;			// no. of shrinking nodes (for bd-trees)
+	ANNidx	n_lf;			// no. of leaves (including trivial)
+	ANNidx	n_tl;			// no. of trivial leaves (no points)
+	ANNidx	n_spl;			// no. of splitting nodes
+	ANNidx	n_shr;			// no. of shrinking nodes (for bd-trees)
 	int		depth;			// depth of tree
 	float	sum_ar;			// sum of leaf aspect ratios
 	float	avg_ar;			// average leaf aspect ratio
  //
 							// reset stats
-	void reset(int d=0, int n=0, int bs=0)
+	void reset(int d=0, ANNidx n=0, int bs=0)
 	{
 		dim = d; n_pts = n; bkt_size = bs;
 		n_lf = n_tl = n_spl = n_shr = depth = 0;
@@ -188,12 +188,12 @@ public :
 //----------------------------------------------------------------------
 
 extern int			ann_Ndata_pts;	// number of data points
-extern int			ann_Nvisit_lfs;	// number of leaf nodes visited
-extern int			ann_Nvisit_spl;	// number of splitting nodes visited
-extern int			ann_Nvisit_shr;	// number of shrinking nodes visited
-extern int			ann_Nvisit_pts;	// visited points for one query
-extern int			ann_Ncoord_hts;	// coordinate hits for one query
-extern int			ann_Nfloat_ops;	// floating ops for one query
+extern thread_local int			ann_Nvisit_lfs;	// number of leaf nodes visited
+extern thread_local int			ann_Nvisit_spl;	// number of splitting nodes visited
+extern thread_local int			ann_Nvisit_shr;	// number of shrinking nodes visited
+extern thread_local int			ann_Nvisit_pts;	// visited points for one query
+extern thread_local int			ann_Ncoord_hts;	// coordinate hits for one query
+extern thread_local int			ann_Nfloat_ops;	// floating ops for one query
 extern ANNsampStat	ann_visit_lfs;	// stats on leaf nodes visits
 extern ANNsampStat	ann_visit_spl;	// stats on splitting nodes visits
 extern ANNsampStat	ann_visit_shr;	// stats on shrinking nodes visits
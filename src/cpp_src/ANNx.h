@@ -56,7 +56,20 @@ enum ANNerr {ANNwarn = 0, ANNabort = 1};
 //----------------------------------------------------------------------
 
 extern int		ANNmaxPtsVisited;	// maximum number of pts visited
-extern int		ANNptsVisited;		// number of pts visited in search
+extern thread_local ANNidx	ANNptsVisited;		// number of pts visited in search
+
+//----------------------------------------------------------------------
+//	Search budget (see annSearchBudget())
+//	Searches call annBudgetStart() first, and stop entering nodes once
+//	ANNbudgetOn is set and annBudgetSpent() returns true.
+//----------------------------------------------------------------------
+
+extern thread_local ANNbool	ANNbudgetOn;		// is a budget set?
+extern thread_local ANNbool	ANNtruncated;		// search stopped on budget?
+extern thread_local int		ANNleavesVisited;	// leaves visited in search
+
+void annBudgetStart();			// start the budget of a search
+ANNbool annBudgetSpent();		// is the budget of the search spent?
 
 //----------------------------------------------------------------------
 //	Global function declarations
@@ -71,6 +84,20 @@ void annPrintPt(				// print a point
 	int				dim,		// the dimension
 	std::ostream	&out);		// output stream
 
+//----------------------------------------------------------------------
+//	Node storage
+//	Tree nodes are taken with annAllocNode() from blocks of
+//	ANN_HUGE_PAGE bytes of annAllocAligned(), so that the nodes of a
+//	tree share huge pages, and given back with annDeallocNode().
+//----------------------------------------------------------------------
+
+void* annAllocNode(				// allocate a tree node
+	size_t			bytes);		// size of the node
+
+void annDeallocNode(			// deallocate a tree node
+	void			*p,			// the node
+	size_t			bytes);		// its size
+
 //----------------------------------------------------------------------
 //	Orthogonal (axis aligned) rectangle
 //	Orthogonal rectangles are represented by two points, one
@@ -36,7 +36,7 @@
 //	bd_shrink::ann_FR_search - search a shrinking node
 //----------------------------------------------------------------------
 
-void ANNbd_shrink::ann_FR_search(ANNdist box_dist)
+void ANNbd_shrink::ann_FR_search(ANNdist box_dist, divergence div_component)
 {
 												// check dist calc term cond.
 	if (ANNmaxPtsVisited != 0 && ANNptsVisited > ANNmaxPtsVisited) return;
@@ -45,18 +45,53 @@ void ANNbd_shrink::ann_FR_search(ANNdist box_dist)
 	for (int i = 0; i < n_bnds; i++) {			// is query point in the box?
 		if (bnds[i].out(ANNkdFRQ)) {			// outside this bounding side?
 												// add to inner distance
-			inner_dist = (ANNdist) ANN_SUM(inner_dist, bnds[i].dist(ANNkdFRQ, div_component_kl));
-			// Hard coded in div_component_kl for now
+			inner_dist = (ANNdist) ANN_SUM(inner_dist, bnds[i].dist(ANNkdFRQ, div_component));
 		}
 	}
 	if (inner_dist <= box_dist) {				// if inner box is closer
-		child[ANN_IN]->ann_FR_search(inner_dist);// search inner child first
-		child[ANN_OUT]->ann_FR_search(box_dist);// ...then outer child
+		child[ANN_IN]->ann_FR_search(inner_dist, div_component);// search inner child first
+		child[ANN_OUT]->ann_FR_search(box_dist, div_component);// ...then outer child
 	}
 	else {										// if outer box is closer
-		child[ANN_OUT]->ann_FR_search(box_dist);// search outer child first
-		child[ANN_IN]->ann_FR_search(inner_dist);// ...then outer child
+		child[ANN_OUT]->ann_FR_search(box_dist, div_component);// search outer child first
+		child[ANN_IN]->ann_FR_search(inner_dist, div_component);// ...then outer child
 	}
 	ANN_FLOP(3*n_bnds)							// increment floating ops
 	ANN_SHR(1)									// one more shrinking node
 }
+
+//----------------------------------------------------------------------
+//	bd_shrink::ann_FR_count - count points in range below a shrinking node
+//		The cell of the inner child is the node's cell cut by the
+//		bounding halfspaces.  The outer child is not a box, so it is
+//		bounded by the node's own cell.
+//----------------------------------------------------------------------
+
+ANNidx ANNbd_shrink::ann_FR_count(ANNdist lower, ANNdist upper, divergence div_component)
+{
+	ANNidx n = annFRCountNode(child[ANN_OUT], lower, upper, div_component);
+
+	ANNcoord *saved = new ANNcoord[n_bnds > 0 ? n_bnds : 1];
+	for (int i = 0; i < n_bnds; i++) {			// shrink the cell
+		int cd = bnds[i].cd;
+		ANNcoord q = ANNkdFRQ[cd];
+		ANNcoord &side = (bnds[i].sd > 0 ? ANNkdFRLo[cd] : ANNkdFRHi[cd]);
+		saved[i] = side;
+		lower -= annCellLower(div_component, q, ANNkdFRLo[cd], ANNkdFRHi[cd]);
+		upper -= annCellUpper(div_component, q, ANNkdFRLo[cd], ANNkdFRHi[cd]);
+		if (bnds[i].sd > 0 ? bnds[i].cv > side : bnds[i].cv < side)
+			side = bnds[i].cv;
+		lower += annCellLower(div_component, q, ANNkdFRLo[cd], ANNkdFRHi[cd]);
+		upper += annCellUpper(div_component, q, ANNkdFRLo[cd], ANNkdFRHi[cd]);
+	}
+	n += annFRCountNode(child[ANN_IN], lower, upper, div_component);
+	for (int i = n_bnds - 1; i >= 0; i--) {		// restore it
+		int cd = bnds[i].cd;
+		(bnds[i].sd > 0 ? ANNkdFRLo[cd] : ANNkdFRHi[cd]) = saved[i];
+	}
+	delete [] saved;
+
+	ANN_FLOP(8*n_bnds)							// increment floating ops
+	ANN_SHR(1)									// one more shrinking node
+	return n;
+}
@@ -25,6 +25,7 @@
 #include "bd_tree.h"					// bd-tree declarations
 #include "kd_search.h"					// kd-tree search declarations
 #include "kd_haus.h"
+#include "kd_block_search.h"			// kd-tree block search declarations
 
 //----------------------------------------------------------------------
 //	Approximate searching for bd-trees.
@@ -41,6 +42,7 @@ void ANNbd_shrink::ann_search(ANNdist box_dist, divergence div_component)
 {
 												// check dist calc term cond.
 	if (ANNmaxPtsVisited != 0 && ANNptsVisited > ANNmaxPtsVisited) return;
+	if (ANNbudgetOn && annBudgetSpent()) return;
 
 	ANNdist inner_dist = 0;						// distance to inner box
 	for (int i = 0; i < n_bnds; i++) {			// is query point in the box?
@@ -62,6 +64,62 @@ void ANNbd_shrink::ann_search(ANNdist box_dist, divergence div_component)
 	ANN_SHR(1)									// one more shrinking node
 }
 
+//----------------------------------------------------------------------
+//	bd_shrink::ann_block_search - search a shrinking node for a block
+//		As in ann_search(), both children are always visited.  The
+//		inner child is searched with each query's distance to the
+//		inner box, and the outer child with its current box distance.
+//----------------------------------------------------------------------
+
+void ANNbd_shrink::ann_block_search(int lev, int n_act, divergence div_component)
+{
+	annBlkLevel(lev+1);
+	int *act = ANNblkAct[lev];					// queries at this node
+	ANNdist *box_dist = ANNblkDist[lev];
+	int *c_act = ANNblkAct[lev+1];				// queries for the child
+	ANNdist *c_dist = ANNblkDist[lev+1];
+
+	for (int j = 0; j < n_act; j++) {			// distances to inner box
+		ANNpoint q = ANNblkQ[act[j]];
+		ANNdist inner_dist = 0;
+		for (int i = 0; i < n_bnds; i++) {
+			if (bnds[i].out(q)) {
+				inner_dist = (ANNdist) ANN_SUM(inner_dist, bnds[i].dist(q, div_component));
+			}
+		}
+		c_act[j] = act[j];
+		c_dist[j] = inner_dist;
+	}
+	child[ANN_IN]->ann_block_search(lev+1, n_act, div_component);
+
+	for (int j = 0; j < n_act; j++) {			// same queries, outer box
+		c_act[j] = act[j];
+		c_dist[j] = box_dist[j];
+	}
+	child[ANN_OUT]->ann_block_search(lev+1, n_act, div_component);
+
+	ANN_FLOP(3*n_bnds*n_act)					// increment floating ops
+	ANN_SHR(1)									// one more shrinking node
+}
+
+//----------------------------------------------------------------------
+//	bd_shrink::locate - path key of a point below a shrinking node
+//		Points inside the inner box take the low (inner) branch.
+//----------------------------------------------------------------------
+
+ANNleafKey ANNbd_shrink::locate(ANNpoint q, int level)
+{
+	int side = ANN_IN;
+	for (int i = 0; i < n_bnds; i++) {
+		if (bnds[i].out(q)) {
+			side = ANN_OUT;
+			break;
+		}
+	}
+	ANNleafKey bit = (side == ANN_OUT && level < 64) ? (ANNleafKey) 1 << (63 - level) : 0;
+	return bit | child[side]->locate(q, level+1);
+}
+
 //----------------------------------------------------------------------
 // bd_shrink::ann_haus - dummy function for flat namespace to register
 //----------------------------------------------------------------------
@@ -106,7 +106,7 @@ void ANNbd_shrink::getStats(					// get subtree statistics
 ANNkd_ptr rbd_tree(						// recursive construction of bd-tree
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices to store in subtree
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	int					bsp,			// bucket space
 	ANNorthRect			&bnd_box,		// bounding box for current node
@@ -115,7 +115,7 @@ ANNkd_ptr rbd_tree(						// recursive construction of bd-tree
 
 ANNbd_tree::ANNbd_tree(					// construct from point array
 	ANNpointArray		pa,				// point array (with at least n pts)
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dd,				// dimension
 	int					bs,				// bucket size
 	ANNsplitRule		split,			// splitting rule
@@ -150,6 +150,12 @@ ANNbd_tree::ANNbd_tree(					// construct from point array
 		root = rbd_tree(pa, pidx, n, dd, bs,
 						bnd_box, sl_fair_split, shrink);
 		break;
+	case ANN_KD_SQRT_MIDPT:				// sliding midpoint in sqrt coordinates
+		root = rbd_tree(pa, pidx, n, dd, bs, bnd_box, sqrt_midpt_split, shrink);
+		break;
+	case ANN_KD_LOG_MIDPT:				// sliding midpoint in log coordinates
+		root = rbd_tree(pa, pidx, n, dd, bs, bnd_box, log_midpt_split, shrink);
+		break;
 	default:
 		annError("Illegal splitting method", ANNabort);
 	}
@@ -181,7 +187,7 @@ const int   BD_CT_THRESH  = 2;			// min number of shrink sides
 ANNdecomp trySimpleShrink(				// try a simple shrink
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices to store in subtree
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	const ANNorthRect	&bnd_box,		// current bounding box
 	ANNorthRect			&inner_box)		// inner box if shrinking (returned)
@@ -236,14 +242,14 @@ const float	BD_FRACTION = 0.5;			// ...to reduce points by this fraction
 ANNdecomp tryCentroidShrink(			// try a centroid shrink
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices to store in subtree
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	const ANNorthRect	&bnd_box,		// current bounding box
 	ANNkd_splitter		splitter,		// splitting procedure
 	ANNorthRect			&inner_box)		// inner box if shrinking (returned)
 {
-	int n_sub = n;						// number of points in subset
-	int n_goal = (int) (n*BD_FRACTION); // number of point in goal
+	ANNidx n_sub = n;					// number of points in subset
+	ANNidx n_goal = (ANNidx) (n*BD_FRACTION); // number of point in goal
 	int n_splits = 0;					// number of splits needed
 										// initialize inner box to bounding box
 	annAssignRect(dim, inner_box, bnd_box);
@@ -251,7 +257,7 @@ ANNdecomp tryCentroidShrink(			// try a centroid shrink
 	while (n_sub > n_goal) {			// keep splitting until goal reached
 		int cd;							// cut dim from splitter (ignored)
 		ANNcoord cv;					// cut value from splitter (ignored)
-		int n_lo;						// number of points on low side
+		ANNidx n_lo;					// number of points on low side
 										// invoke splitting procedure
 		(*splitter)(pa, pidx, inner_box, n_sub, dim, cd, cv, n_lo);
 		n_splits++;						// increment split count
@@ -279,7 +285,7 @@ ANNdecomp tryCentroidShrink(			// try a centroid shrink
 ANNdecomp selectDecomp(			// select decomposition method
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices to store in subtree
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	const ANNorthRect	&bnd_box,		// current bounding box
 	ANNkd_splitter		splitter,		// splitting procedure
@@ -335,7 +341,7 @@ ANNdecomp selectDecomp(			// select decomposition method
 ANNkd_ptr rbd_tree(				// recursive construction of bd-tree
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices to store in subtree
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	int					bsp,			// bucket space
 	ANNorthRect			&bnd_box,		// bounding box for current node
@@ -363,7 +369,7 @@ ANNkd_ptr rbd_tree(				// recursive construction of bd-tree
 	if (decomp == SPLIT) {				// split selected
 		int cd;							// cutting dimension
 		ANNcoord cv;					// cutting value
-		int n_lo;						// number on low side of cut
+		ANNidx n_lo;					// number on low side of cut
 										// invoke splitting procedure
 		(*splitter)(pa, pidx, bnd_box, n, dim, cd, cv, n_lo);
 
@@ -385,7 +391,7 @@ ANNkd_ptr rbd_tree(				// recursive construction of bd-tree
 		return new ANNkd_split(cd, cv, lv, hv, lo, hi);
 	}
 	else {								// shrink selected
-		int n_in;						// number of points in box
+		ANNidx n_in;					// number of points in box
 		int n_bnds;						// number of bounding sides
 
 		annBoxSplit(					// split points around inner box
@@ -63,6 +63,7 @@ class ANNbd_shrink : public ANNkd_node	// splitting node of a kd-tree
 	int					n_bnds;			// number of bounding halfspaces
 	ANNorthHSArray		bnds;			// list of bounding halfspaces
 	ANNkd_ptr			child[2];		// in and out children
+	ANNidx				n_sub;			// number of points in subtree
 public:
 	ANNbd_shrink(						// constructor
 		int				nb,				// number of bounding halfspaces
@@ -73,6 +74,7 @@ public:
 			bnds			= bds;				// assign bounds
 			child[ANN_IN]	= ic;				// set children
 			child[ANN_OUT]	= oc;
+			n_sub = (ic != NULL ? ic->count() : 0) + (oc != NULL ? oc->count() : 0);
 		}
 
 	~ANNbd_shrink()						// destructor
@@ -91,12 +93,17 @@ public:
 				ANNorthRect &bnd_box);			// bounding box
 	virtual void print(int level, ostream &out);// print node
 	virtual void dump(ostream &out);			// dump node
+	virtual void flatten(ANNbinNode *rec, long long &next, ANNidxArray pidx);
 
 	virtual void ann_search(ANNdist, divergence);			// standard search
    virtual void ann_haus(ANNdist, divergence, double);
 	virtual void ann_pri_search(ANNdist, divergence);		// priority search
-	virtual void ann_FR_search(ANNdist); 		// fixed-radius search
-	                                        //
+	virtual void ann_FR_search(ANNdist, divergence);	// fixed-radius search
+	virtual void ann_block_search(int, int, divergence);	// block search
+	virtual ANNidx ann_FR_count(ANNdist, ANNdist, divergence); // range count
+	virtual ANNleafKey locate(ANNpoint, int);	// path key of a point
+	virtual ANNidx count()						// points in subtree
+		{ return n_sub; }
 };
 
 #endif
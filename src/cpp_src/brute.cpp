@@ -43,7 +43,7 @@
 
 ANNbruteForce::ANNbruteForce(			// constructor from point array
 	ANNpointArray		pa,				// point array
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dd)				// dimension
 {
 	dim = dd;  n_pts = n;  pts = pa;
@@ -70,7 +70,7 @@ void ANNbruteForce::annkSearch(			// approx k near neighbor search
 	double				eps)			// error bound (ignored)
 {
 	ANNmin_k mk(k);						// construct a k-limited priority queue
-	int i;
+	ANNidx i;
 
 	if (k > n_pts) {					// too many near neighbors?
 		annError("Requesting more near neighbors than data points", ANNabort);
@@ -89,7 +89,7 @@ void ANNbruteForce::annkSearch(			// approx k near neighbor search
 	}
 }
 
-int ANNbruteForce::annkFRSearch(		// approx fixed-radius kNN search
+ANNidx ANNbruteForce::annkFRSearch(		// approx fixed-radius kNN search
 	divergence	div_component,
 	ANNpoint			q,				// query point
 	ANNdist				sqRad,			// squared radius
@@ -99,8 +99,8 @@ int ANNbruteForce::annkFRSearch(		// approx fixed-radius kNN search
 	double				eps)			// error bound
 {
 	ANNmin_k mk(k);						// construct a k-limited priority queue
-	int i;
-	int pts_in_range = 0;				// number of points in query range
+	ANNidx i;
+	ANNidx pts_in_range = 0;			// number of points in query range
 										// run every point through queue
 	for (i = 0; i < n_pts; i++) {
 										// compute distance to point
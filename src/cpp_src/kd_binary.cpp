@@ -0,0 +1,433 @@
+//----------------------------------------------------------------------
+// File:			kd_binary.cpp
+// Description:		Binary, memory-mappable kd-tree files
+//----------------------------------------------------------------------
+// BANN History:
+// Revision 1.1
+//    Initial release: versioned binary format with checksums
+// Revision 1.2
+//    Added POSIX shared memory segments
+// Revision 1.3
+//    Format version 3: splitting rule and kind of build in the header
+//----------------------------------------------------------------------
+
+#include "kd_tree.h"					// kd-tree declarations
+#include "bd_tree.h"					// bd-tree declarations
+
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#ifdef __linux__
+  #include <fcntl.h>					// file mapping
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+//----------------------------------------------------------------------
+//	Layout helpers
+//		Sections start on ANN_BIN_ALIGN byte boundaries, so that each
+//		can be mapped and paged in on its own.
+//----------------------------------------------------------------------
+
+const long long	ANN_BIN_ALIGN	= 4096;			// section alignment
+const char		ANN_BIN_MAGIC[8] = "BANNKDT";	// file magic
+
+static long long annBinAlign(long long off)
+{
+	return (off + ANN_BIN_ALIGN - 1) / ANN_BIN_ALIGN * ANN_BIN_ALIGN;
+}
+
+//----------------------------------------------------------------------
+//	annBinSum - FNV-1a checksum over 64-bit words
+//		A checksum may be accumulated over consecutive pieces, as long
+//		as every piece but the last is a multiple of 8 bytes long.
+//----------------------------------------------------------------------
+
+const unsigned long long ANN_BIN_SUM0 = 14695981039346656037ULL;
+
+static unsigned long long annBinSum(
+	const void			*p,				// data
+	size_t				len,			// length (bytes)
+	unsigned long long	h = ANN_BIN_SUM0)	// running checksum
+{
+	const unsigned char *b = (const unsigned char *) p;
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8) {
+		unsigned long long w;
+		memcpy(&w, b + i, 8);
+		h = (h ^ w) * 1099511628211ULL;
+	}
+	for (; i < len; i++) {
+		h = (h ^ b[i]) * 1099511628211ULL;
+	}
+	return h;
+}
+
+//----------------------------------------------------------------------
+//	flatten - write the nodes of a subtree in preorder
+//----------------------------------------------------------------------
+
+void ANNkd_leaf::flatten(ANNbinNode *rec, long long &next, ANNidxArray pidx)
+{
+	ANNbinNode &r = rec[next++];
+	memset(&r, 0, sizeof(r));
+	r.kind = ANN_BIN_LEAF;
+	r.n = n_pts;
+	r.link = (this == KD_TRIVIAL || n_pts == 0 ? -1 : (long long) (bkt - pidx));
+}
+
+void ANNkd_split::flatten(ANNbinNode *rec, long long &next, ANNidxArray pidx)
+{
+	long long me = next++;
+	memset(&rec[me], 0, sizeof(rec[me]));
+	rec[me].kind = ANN_BIN_SPLIT;
+	rec[me].n = cut_dim;
+	rec[me].cut_val = cut_val;
+	rec[me].cd_bnds[ANN_LO] = cd_bnds[ANN_LO];
+	rec[me].cd_bnds[ANN_HI] = cd_bnds[ANN_HI];
+
+	child[ANN_LO]->flatten(rec, next, pidx);	// low child follows
+	rec[me].link = next;
+	child[ANN_HI]->flatten(rec, next, pidx);
+}
+
+void ANNbd_shrink::flatten(ANNbinNode *rec, long long &next, ANNidxArray /*pidx*/)
+{
+	ANNbinNode &r = rec[next++];				// not representable;
+	memset(&r, 0, sizeof(r));					// SaveBinary() refuses
+	r.kind = ANN_BIN_SHRINK;					// the tree
+}
+
+//----------------------------------------------------------------------
+//	flattenTree - the nodes of the tree in preorder
+//		Returns an array (allocated with new[]) of n_nodes records.
+//----------------------------------------------------------------------
+
+ANNbinNode *ANNkd_tree::flattenTree(long long &n_nodes)
+{
+	ANNkdStats stats;					// count the nodes
+	getStats(stats);
+	n_nodes = (root == NULL ? 0 : stats.n_lf + stats.n_spl + stats.n_shr);
+
+	ANNbinNode *rec = new ANNbinNode[n_nodes > 0 ? n_nodes : 1];
+	long long next = 0;
+	if (root != NULL) root->flatten(rec, next, pidx);
+	n_nodes = next;
+	return rec;
+}
+
+//----------------------------------------------------------------------
+//	SaveBinary - write the tree in binary format
+//----------------------------------------------------------------------
+
+int ANNkd_tree::SaveBinary(
+	const char			*path,			// file (or segment) to write
+	const char			*meta,			// build metadata (may be NULL)
+	ANNbool				shared)			// path names a shm segment?
+{
+	long long n_nodes;
+	ANNbinNode *rec = flattenTree(n_nodes);
+	for (long long i = 0; i < n_nodes; i++) {
+		if (rec[i].kind == ANN_BIN_SHRINK) {
+			delete [] rec;
+			return ANN_BIN_UNSUPPORTED;
+		}
+	}
+
+	ANNbinHeader hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, ANN_BIN_MAGIC, sizeof(hdr.magic));
+	hdr.version = ANN_BIN_VERSION;
+	hdr.header_size = sizeof(ANNbinHeader);
+	hdr.byte_order = 0x01020304;
+	hdr.coord_size = sizeof(ANNcoord);
+	hdr.idx_size = sizeof(ANNidx);
+	hdr.dim = dim;
+	hdr.n_pts = n_pts;
+	hdr.bkt_size = bkt_size;
+	hdr.split = split_rule;
+	hdr.build = build_kind;
+	hdr.n_nodes = n_nodes;
+	hdr.build_time = (long long) time(NULL);
+	strncpy(hdr.ann_version, ANNversion, sizeof(hdr.ann_version) - 1);
+	if (meta != NULL) strncpy(hdr.meta, meta, sizeof(hdr.meta) - 1);
+
+	size_t row = (size_t) dim * sizeof(ANNcoord);
+	long long len[4] = {
+		(long long) n_pts * (long long) row,				// points
+		(long long) n_pts * (long long) sizeof(ANNidx),		// indices
+		n_nodes * (long long) sizeof(ANNbinNode),			// nodes
+		2 * (long long) row};								// box
+	hdr.offset[0] = annBinAlign(sizeof(ANNbinHeader));
+	for (int s = 1; s < 4; s++) {
+		hdr.offset[s] = annBinAlign(hdr.offset[s-1] + len[s-1]);
+	}
+
+	unsigned long long h = ANN_BIN_SUM0;	// points are written row by row
+	for (ANNidx i = 0; i < n_pts; i++) {
+		h = annBinSum(pts[i], row, h);
+	}
+	hdr.checksum[0] = h;
+	hdr.checksum[1] = annBinSum(pidx, (size_t) len[1]);
+	hdr.checksum[2] = annBinSum(rec, (size_t) len[2]);
+	h = annBinSum(bnd_box_lo, row);
+	hdr.checksum[3] = annBinSum(bnd_box_hi, row, h);
+	hdr.header_sum = annBinSum(&hdr, offsetof(ANNbinHeader, header_sum));
+
+	FILE *f = NULL;
+	if (!shared) {
+		f = fopen(path, "wb");
+	}
+	else {
+#ifdef __linux__
+		int fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+		if (fd < 0 && errno == EEXIST) {
+			delete [] rec;
+			return ANN_BIN_EXISTS;
+		}
+		if (fd >= 0 && (f = fdopen(fd, "wb")) == NULL) {
+			close(fd);
+			shm_unlink(path);
+		}
+#else
+		delete [] rec;
+		return ANN_BIN_UNSUPPORTED;
+#endif
+	}
+	if (f == NULL) {
+		delete [] rec;
+		return ANN_BIN_IO;
+	}
+	static const char zeros[ANN_BIN_ALIGN] = {0};
+	long long at = 0;					// bytes written so far
+	bool ok = fwrite(zeros, sizeof(hdr), 1, f) == 1;	// header goes last
+	at += sizeof(hdr);
+	for (int s = 0; s < 4 && ok; s++) {
+		ok = fwrite(zeros, 1, (size_t) (hdr.offset[s] - at), f) == (size_t) (hdr.offset[s] - at);
+		at = hdr.offset[s];
+		switch (s) {
+			case 0:
+				for (ANNidx i = 0; i < n_pts && ok; i++) {
+					ok = fwrite(pts[i], 1, row, f) == row;
+				}
+				break;
+			case 1:
+				ok = ok && fwrite(pidx, 1, (size_t) len[1], f) == (size_t) len[1];
+				break;
+			case 2:
+				ok = ok && fwrite(rec, 1, (size_t) len[2], f) == (size_t) len[2];
+				break;
+			case 3:
+				ok = ok && fwrite(bnd_box_lo, 1, row, f) == row;
+				ok = ok && fwrite(bnd_box_hi, 1, row, f) == row;
+				break;
+		}
+		at += len[s];
+	}
+	ok = ok && fflush(f) == 0 && fseek(f, 0, SEEK_SET) == 0;
+	ok = ok && fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+	ok = (fclose(f) == 0) && ok;
+	delete [] rec;
+#ifdef __linux__
+	if (!ok && shared) shm_unlink(path);
+#endif
+	return ok ? ANN_BIN_OK : ANN_BIN_IO;
+}
+
+//----------------------------------------------------------------------
+//	annUnlinkShared - remove the name of a shared segment
+//		Processes that have the segment mapped keep their mapping.
+//----------------------------------------------------------------------
+
+int annUnlinkShared(const char *name)
+{
+#ifdef __linux__
+	return shm_unlink(name) == 0 ? ANN_BIN_OK : ANN_BIN_IO;
+#else
+	return ANN_BIN_UNSUPPORTED;
+#endif
+}
+
+//----------------------------------------------------------------------
+//	annBinTree - rebuild the nodes of a subtree from its records
+//		Records are checked as they are read, so that a damaged file
+//		is reported rather than followed.  Returns NULL on failure.
+//----------------------------------------------------------------------
+
+static ANNkd_ptr annBinTree(
+	const ANNbinNode	*rec,			// node records
+	long long			n_nodes,		// number of records
+	long long			&next,			// next record (modified)
+	ANNidxArray			pidx,			// point indices
+	ANNidx				n_pts,			// number of points
+	int					dim)			// dimension
+{
+	if (next >= n_nodes) return NULL;
+	const ANNbinNode &r = rec[next++];
+
+	if (r.kind == ANN_BIN_LEAF) {
+		if (r.link < 0)
+			return (r.n == 0 ? KD_TRIVIAL : NULL);
+		if (r.n <= 0 || r.link + r.n > n_pts)
+			return NULL;
+		return new ANNkd_leaf(r.n, pidx + r.link);
+	}
+	if (r.kind != ANN_BIN_SPLIT || r.n < 0 || r.n >= dim)
+		return NULL;
+
+	ANNkd_ptr lo = annBinTree(rec, n_nodes, next, pidx, n_pts, dim);
+	if (lo == NULL) return NULL;
+	ANNkd_ptr hi = NULL;
+	if (r.link == next)					// high child follows low subtree
+		hi = annBinTree(rec, n_nodes, next, pidx, n_pts, dim);
+	if (hi == NULL) {
+		if (lo != KD_TRIVIAL) delete lo;
+		return NULL;
+	}
+	return new ANNkd_split(r.n, r.cut_val, r.cd_bnds[ANN_LO], r.cd_bnds[ANN_HI], lo, hi);
+}
+
+//----------------------------------------------------------------------
+//	ANNkd_mapped - map a binary kd-tree file
+//		The file is mapped read-only where mmap is available, and read
+//		into memory otherwise.  Shared segments are always mapped.  On
+//		failure the status is set and the tree is left empty.
+//----------------------------------------------------------------------
+
+ANNkd_mapped::ANNkd_mapped(
+	const char			*path,			// file (or segment) to map
+	ANNbool				verify,			// check all checksums?
+	ANNbool				shared)			// path names a shm segment?
+	: ANNkd_tree()
+{
+	annDeallocAligned(pidx);			// skeleton has no points
+	pidx = NULL;
+	map_base = NULL;
+	map_size = 0;
+	mapped = ANNfalse;
+	memset(&hdr, 0, sizeof(hdr));
+	st = ANN_BIN_IO;
+
+	long long size = -1;				// map or read the file
+#ifdef __linux__
+	int fd = (shared ? shm_open(path, O_RDONLY, 0) : open(path, O_RDONLY));
+	if (fd < 0) return;
+	struct stat sb;
+	if (fstat(fd, &sb) == 0) size = (long long) sb.st_size;
+	if (size > 0) {
+		void *m = mmap(NULL, (size_t) size, PROT_READ, MAP_SHARED, fd, 0);
+		if (m != MAP_FAILED) {
+			map_base = m;
+			mapped = ANNtrue;
+		}
+	}
+	close(fd);
+	if (!mapped) return;
+#else
+	if (shared) {
+		st = ANN_BIN_UNSUPPORTED;
+		return;
+	}
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) return;
+	if (fseek(f, 0, SEEK_END) == 0) size = ftell(f);
+	if (size > 0 && fseek(f, 0, SEEK_SET) == 0) {
+		map_base = annAllocAligned((size_t) size);
+		if (fread(map_base, 1, (size_t) size, f) != (size_t) size) {
+			annDeallocAligned(map_base);
+			map_base = NULL;
+		}
+	}
+	fclose(f);
+	if (map_base == NULL) return;
+#endif
+	map_size = (size_t) size;
+	const char *base = (const char *) map_base;
+
+	st = ANN_BIN_FORMAT;				// check the header
+	if (size < (long long) sizeof(ANNbinHeader)) return;
+	memcpy(&hdr, base, sizeof(hdr));
+	if (memcmp(hdr.magic, ANN_BIN_MAGIC, sizeof(hdr.magic)) != 0 ||
+		hdr.version != ANN_BIN_VERSION ||
+		hdr.header_size != (int) sizeof(ANNbinHeader) ||
+		hdr.byte_order != 0x01020304 ||
+		hdr.coord_size != (int) sizeof(ANNcoord) ||
+		hdr.idx_size != (int) sizeof(ANNidx)) return;
+	if (hdr.header_sum != annBinSum(&hdr, offsetof(ANNbinHeader, header_sum))) {
+		st = ANN_BIN_CHECKSUM;
+		return;
+	}
+	if (hdr.dim <= 0 || hdr.n_pts < 0 || hdr.bkt_size <= 0 || hdr.n_nodes < 0 ||
+		(ANNidx) hdr.n_pts != hdr.n_pts ||
+		hdr.split < -1 || hdr.split > ANN_KD_LOG_MIDPT ||
+		hdr.build < ANN_BUILD_UNKNOWN || hdr.build > ANN_BUILD_SUBSPACE) return;
+
+	size_t row = (size_t) hdr.dim * sizeof(ANNcoord);
+	long long len[4] = {
+		(long long) hdr.n_pts * (long long) row,
+		(long long) hdr.n_pts * (long long) sizeof(ANNidx),
+		hdr.n_nodes * (long long) sizeof(ANNbinNode),
+		2 * (long long) row};
+	for (int s = 0; s < 4; s++) {		// sections inside the file
+		if (hdr.offset[s] < (long long) sizeof(ANNbinHeader) ||
+			hdr.offset[s] % ANN_BIN_ALIGN != 0 ||
+			hdr.offset[s] + len[s] > size) return;
+	}
+
+	const ANNbinNode *rec = (const ANNbinNode *) (base + hdr.offset[2]);
+	if (annBinSum(rec, (size_t) len[2]) != hdr.checksum[2]) {
+		st = ANN_BIN_CHECKSUM;
+		return;
+	}
+	if (verify) {
+		for (int s = 0; s < 4; s++) {
+			if (s != 2 && annBinSum(base + hdr.offset[s], (size_t) len[s]) != hdr.checksum[s]) {
+				st = ANN_BIN_CHECKSUM;
+				return;
+			}
+		}
+	}
+
+	ANNidxArray the_pidx = (ANNidxArray) (base + hdr.offset[1]);
+	long long next = 0;
+	ANNkd_ptr the_root = NULL;
+	if (hdr.n_nodes > 0) {
+		the_root = annBinTree(rec, hdr.n_nodes, next, the_pidx, hdr.n_pts, hdr.dim);
+		if (the_root == NULL || next != hdr.n_nodes) {
+			if (the_root != NULL && the_root != KD_TRIVIAL) delete the_root;
+			return;
+		}
+	}
+										// points and indices in place
+	ANNpointArray the_pts = annViewPts((ANNcoord *) (base + hdr.offset[0]), hdr.n_pts, hdr.dim);
+	SkeletonTree(hdr.n_pts, hdr.dim, hdr.bkt_size, the_pts, the_pidx);
+	split_rule = hdr.split;
+	build_kind = (ANNbuildKind) hdr.build;
+
+	const ANNcoord *box = (const ANNcoord *) (base + hdr.offset[3]);
+	bnd_box_lo = annAllocPt(dim);
+	bnd_box_hi = annAllocPt(dim);
+	for (int d = 0; d < dim; d++) {
+		bnd_box_lo[d] = box[d];
+		bnd_box_hi[d] = box[dim + d];
+	}
+	root = the_root;
+	st = ANN_BIN_OK;
+}
+
+ANNkd_mapped::~ANNkd_mapped()
+{
+	if (root != NULL && root != KD_TRIVIAL) delete root;
+	root = NULL;
+	pidx = NULL;						// indices live in the file
+	if (pts != NULL) annDeallocViewPts(pts);
+
+	if (map_base != NULL) {
+#ifdef __linux__
+		munmap(map_base, map_size);
+#else
+		annDeallocAligned(map_base);
+#endif
+	}
+}
@@ -0,0 +1,272 @@
+//----------------------------------------------------------------------
+// File:			kd_block_search.cpp
+// Description:		Bregman kd-tree search for blocks of queries
+//----------------------------------------------------------------------
+// BANN History:
+// Revision 1.1
+//    Initial release: leaf-major traversal of query blocks
+//----------------------------------------------------------------------
+
+#include "kd_block_search.h"			// block search declarations
+
+#include <algorithm>					// sort
+#include <utility>						// pair
+
+//----------------------------------------------------------------------
+//	Approximate nearest neighbor searching for a block of queries
+//		annkSearch() walks the tree once per query, so neighbouring
+//		queries pull the same nodes and buckets into cache over and
+//		over.  annkSearchBlock() pushes a whole block through the tree
+//		instead.  Every query keeps its own set of k closest points,
+//		and each node is visited once with the list of queries of the
+//		block that still need it.
+//
+//		At a splitting node the active queries are divided as in the
+//		standard search: a query always descends into its closer child,
+//		and into its further child if the box distance of the node is
+//		within 1/(1+eps) of its k-th closest distance so far.  The child
+//		holding the majority of the block is visited first, and the
+//		list for the other child is only built once the first has
+//		returned, so that it is pruned with the improved distances.  At
+//		a leaf the bucket is compared against every active query while
+//		it is hot in cache.
+//
+//		Results are those of annkSearch() (see ANN.h).
+//		ANNmaxPtsVisited is not applied to block searches.
+//----------------------------------------------------------------------
+
+thread_local ANNpointArray	ANNblkQ;			// query points of the block
+thread_local ANNmin_k		**ANNblkMK;			// k closest points per query
+thread_local int			**ANNblkAct;		// active queries per level
+thread_local ANNdist		**ANNblkDist;		// box distances per level
+thread_local int			ANNblkSize;			// queries in the block
+thread_local int			ANNblkLevels;		// levels allocated
+thread_local int			ANNblkMaxLev;		// capacity of level arrays
+
+//----------------------------------------------------------------------
+//	annBlkLevel - make the active list of a level available
+//		Levels are allocated as the search first reaches them, each
+//		large enough for the whole block, and are freed at the end of
+//		annkSearchBlock().  Lists of deeper levels are rebuilt by each
+//		node, so one list per level suffices.
+//----------------------------------------------------------------------
+void annBlkLevel(int lev)
+{
+	if (lev < ANNblkLevels) return;
+
+	if (lev >= ANNblkMaxLev) {			// grow the level arrays
+		int new_max = 2*lev + 8;
+		int **act = new int*[new_max];
+		ANNdist **dist = new ANNdist*[new_max];
+		for (int l = 0; l < ANNblkLevels; l++) {
+			act[l] = ANNblkAct[l];
+			dist[l] = ANNblkDist[l];
+		}
+		delete [] ANNblkAct;
+		delete [] ANNblkDist;
+		ANNblkAct = act;
+		ANNblkDist = dist;
+		ANNblkMaxLev = new_max;
+	}
+	for (; ANNblkLevels <= lev; ANNblkLevels++) {
+		ANNblkAct[ANNblkLevels] = new int[ANNblkSize];
+		ANNblkDist[ANNblkLevels] = new ANNdist[ANNblkSize];
+	}
+}
+
+//----------------------------------------------------------------------
+//	annkSearchBlock - search for the k nearest neighbors of a block
+//----------------------------------------------------------------------
+void ANNkd_tree::annkSearchBlock(
+	divergence			div_component,	// divergence component function
+	ANNpointArray		qa,				// the query points
+	int					nq,				// number of query points
+	int					k,				// number of near neighbors to return
+	ANNidxArray			nn_idx,			// nearest neighbor indices (returned)
+	ANNdistArray		dd,				// the approximate nearest neighbor
+	double				eps)			// the error bound
+{
+	if (k > n_pts) {					// too many near neighbors?
+		annError("Requesting more near neighbors than data points", ANNabort);
+	}
+	if (nq <= 0) return;
+
+	ANNkdDim = dim;						// copy arguments to static equivs
+	ANNkdPts = pts;
+	ANNkdMaxErr = 1.0 + eps;
+	ANNptsVisited = 0;
+
+	ANNblkQ = qa;
+	ANNblkSize = nq;
+	ANNblkLevels = 0;
+	ANNblkMaxLev = 0;
+	ANNblkAct = NULL;
+	ANNblkDist = NULL;
+	ANNblkMK = new ANNmin_k*[nq];
+
+	annBlkLevel(0);						// every query starts at the root
+	for (int q = 0; q < nq; q++) {
+		ANNblkMK[q] = new ANNmin_k(k);
+		ANNblkAct[0][q] = q;
+		ANNblkDist[0][q] = annBoxDistance(qa[q], bnd_box_lo, bnd_box_hi, dim, div_component);
+	}
+
+	root->ann_block_search(0, nq, div_component);
+
+	for (int q = 0; q < nq; q++) {		// extract the k-th closest points
+		for (int i = 0; i < k; i++) {
+			dd[q*k + i] = ANNblkMK[q]->ith_smallest_key(i);
+			nn_idx[q*k + i] = ANNblkMK[q]->ith_smallest_info(i);
+		}
+		delete ANNblkMK[q];
+	}
+	delete [] ANNblkMK;
+
+	for (int l = 0; l < ANNblkLevels; l++) {
+		delete [] ANNblkAct[l];
+		delete [] ANNblkDist[l];
+	}
+	delete [] ANNblkAct;
+	delete [] ANNblkDist;
+}
+
+//----------------------------------------------------------------------
+//	kd_split::ann_block_search - search a splitting node
+//----------------------------------------------------------------------
+void ANNkd_split::ann_block_search(int lev, int n_act, divergence div_component)
+{
+	annBlkLevel(lev+1);
+	int *act = ANNblkAct[lev];			// queries at this node
+	ANNdist *box_dist = ANNblkDist[lev];
+	int *c_act = ANNblkAct[lev+1];		// queries for the child
+	ANNdist *c_dist = ANNblkDist[lev+1];
+
+	int n_lo = 0;						// queries left of cutting plane
+	for (int i = 0; i < n_act; i++) {
+		if (ANNblkQ[act[i]][cut_dim] - cut_val < 0) n_lo++;
+	}
+										// majority side first
+	int first = (2*n_lo >= n_act ? ANN_LO : ANN_HI);
+
+	for (int pass = 0; pass < 2; pass++) {
+		int side = (pass == 0 ? first : 1 - first);
+		int n_child = 0;
+
+		for (int i = 0; i < n_act; i++) {
+			int q = act[i];
+			ANNcoord qc = ANNblkQ[q][cut_dim];
+			int near = (qc - cut_val < 0 ? ANN_LO : ANN_HI);
+
+			if (near == side) {			// closer child
+				c_act[n_child] = q;
+				c_dist[n_child++] = box_dist[i];
+			}
+										// further child if close enough
+			else if (box_dist[i] * ANNkdMaxErr < ANNblkMK[q]->max_key()) {
+				ANNdist new_dist = box_dist[i] + div_component(qc, cut_val);
+				ANNcoord box_diff = (near == ANN_LO ?
+						cd_bnds[ANN_LO] - qc : qc - cd_bnds[ANN_HI]);
+
+				if (box_diff > 0)
+					new_dist -= div_component(qc, cd_bnds[near]);
+
+				c_act[n_child] = q;
+				c_dist[n_child++] = new_dist;
+			}
+		}
+		if (n_child > 0)
+			child[side]->ann_block_search(lev+1, n_child, div_component);
+	}
+	ANN_FLOP(10*n_act)					// increment floating ops
+	ANN_SPL(1)							// one more splitting node visited
+}
+
+//----------------------------------------------------------------------
+//	kd_leaf::ann_block_search - search points in a leaf node
+//		The bucket is compared against each active query in turn, with
+//		the same early termination as ANNkd_leaf::ann_search().
+//----------------------------------------------------------------------
+void ANNkd_leaf::ann_block_search(int lev, int n_act, divergence div_component)
+{
+	ANNdist dist;				// distance to data point
+	ANNcoord* pp;				// data coordinate pointer
+	ANNcoord* qq;				// query coordinate pointer
+	ANNdist min_dist;			// distance to k-th closest point
+	int d;
+
+	int *act = ANNblkAct[lev];
+
+	for (int j = 0; j < n_act; j++) {	// for each active query
+		ANNmin_k *mk = ANNblkMK[act[j]];
+		ANNpoint q = ANNblkQ[act[j]];
+
+		min_dist = mk->max_key();		// k-th smallest distance so far
+
+		for (int i = 0; i < n_pts; i++) {	// check points in bucket
+
+			pp = ANNkdPts[bkt[i]];		// first coord of next data point
+			qq = q;						// first coord of query point
+			dist = 0;
+
+			for(d = 0; d < ANNkdDim; d++) {
+				ANN_COORD(1)			// one more coordinate hit
+				ANN_FLOP(4)				// increment floating ops
+
+				dist += div_component(*qq++, *pp++);
+
+				if (dist > min_dist) {
+					break;
+				}
+			}
+
+			if (d >= ANNkdDim &&					// among the k best?
+			   (ANN_ALLOW_SELF_MATCH || dist!=0)) { // and no self-match problem
+				mk->insert(dist, bkt[i]);
+				min_dist = mk->max_key();
+			}
+		}
+	}
+	ANN_LEAF(1)							// one more leaf node visited
+	ANN_PTS(n_pts*n_act)				// increment points visited
+	ANNptsVisited += (ANNidx) n_pts*n_act;	// increment number of points visited
+}
+
+//----------------------------------------------------------------------
+//	annLeafOrder - order queries by the leaves they fall into
+//		Each query descends the tree once to find its path key, and the
+//		queries are sorted by key, ties in their original order.
+//		order[i] is set to the query to search i-th.
+//----------------------------------------------------------------------
+void ANNkd_tree::annLeafOrder(
+	ANNpointArray		qa,				// query points
+	ANNidx				nq,				// number of query points
+	ANNidxArray			order)			// query order (nq, returned)
+{
+	std::pair<ANNleafKey, ANNidx> *keys = new std::pair<ANNleafKey, ANNidx>[nq];
+	for (ANNidx q = 0; q < nq; q++) {
+		keys[q] = std::make_pair(root->locate(qa[q], 0), q);
+	}
+	std::sort(keys, keys + nq);
+	for (ANNidx q = 0; q < nq; q++) {
+		order[q] = keys[q].second;
+	}
+	delete [] keys;
+}
+
+//----------------------------------------------------------------------
+//	kd_split::locate - path key of a point below a splitting node
+//----------------------------------------------------------------------
+ANNleafKey ANNkd_split::locate(ANNpoint q, int level)
+{
+	int side = q[cut_dim] < cut_val ? ANN_LO : ANN_HI;
+	ANNleafKey bit = (side == ANN_HI && level < 64) ? (ANNleafKey) 1 << (63 - level) : 0;
+	return bit | child[side]->locate(q, level+1);
+}
+
+//----------------------------------------------------------------------
+//	kd_leaf::locate - path key of a point at a leaf (no more branches)
+//----------------------------------------------------------------------
+ANNleafKey ANNkd_leaf::locate(ANNpoint /*q*/, int /*level*/)
+{
+	return 0;
+}
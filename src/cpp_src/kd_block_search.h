@@ -0,0 +1,30 @@
+#ifndef ANN_kd_block_search_H
+#define ANN_kd_block_search_H
+
+#include "kd_tree.h"
+#include "kd_util.h"
+#include "pr_queue_k.h"
+
+#include <ANNperf.h>
+
+//----------------------------------------------------------------------
+//	Block search state
+//		The queries of the block, their sets of k closest points, and
+//		one active list per tree level.  The active list of level l
+//		holds the queries (ANNblkAct) that descend into the node being
+//		visited at depth l, and their box distances (ANNblkDist).
+//----------------------------------------------------------------------
+
+extern thread_local int           ANNkdDim;
+extern thread_local double        ANNkdMaxErr;
+extern thread_local ANNpointArray ANNkdPts;
+extern thread_local ANNidx        ANNptsVisited;
+
+extern thread_local ANNpointArray ANNblkQ;		// query points of the block
+extern thread_local ANNmin_k      **ANNblkMK;	// k closest points per query
+extern thread_local int           **ANNblkAct;	// active queries per level
+extern thread_local ANNdist       **ANNblkDist;	// box distances per level
+
+void annBlkLevel(int lev);						// make level lev available
+
+#endif
@@ -0,0 +1,290 @@
+//----------------------------------------------------------------------
+// File:			kd_dual_search.cpp
+// Description:		Dual-tree Bregman k-nearest neighbour search
+//----------------------------------------------------------------------
+// BANN History:
+// Revision 1.1
+//    Initial release: node pair traversal with box-to-box bounds
+//----------------------------------------------------------------------
+
+#include "kd_tree.h"					// kd-tree declarations
+#include "pr_queue_k.h"					// k element priority queue
+
+#include <ANNperf.h>					// performance evaluation
+
+//----------------------------------------------------------------------
+//	Dual-tree search
+//		annkSearch() descends the data tree from the root for every
+//		query.  annkDualSearch() is given a second kd-tree over the
+//		queries, and walks pairs (query node, data node) instead.
+//		Each query node keeps a bound, the largest k-th closest
+//		distance of its queries so far, and a pair is pruned when the
+//		lower bound on the divergence between the boxes of its nodes,
+//		times 1+eps, is not below that bound: no data point of the data
+//		node can then be among the k closest of any query of the query
+//		node.  At a pair of leaves every query of the query bucket is
+//		compared against the data bucket.
+//
+//		Both trees are flattened, and each node gets the tight bounding
+//		box of its points, which prunes better than the cells of the
+//		splits.  The lower bound between boxes is taken coordinate by
+//		coordinate, as in annBoxDistance().  A one-dimensional Bregman
+//		divergence D(x, y), in either argument order, decreases as
+//		either argument moves towards the other and vanishes when they
+//		meet.  So over x in [xlo, xhi] and y in [ylo, yhi] it is 0 if
+//		the intervals meet, D(xhi, ylo) if xhi < ylo and D(xlo, yhi) if
+//		xlo > yhi, which holds for the primal and the dual divergences
+//		alike.
+//
+//		Results are those of annkSearch() (see ANN.h).  Trees with
+//		shrinking nodes are searched query by query.
+//----------------------------------------------------------------------
+
+struct ANNdualTree {					// flattened tree with node boxes
+	ANNbinNode		*rec;				// nodes in preorder
+	ANNpointArray	pts;				// points of the tree
+	ANNidxArray		pidx;				// point indices of the buckets
+	ANNidxArray		cnt;				// number of points per node
+	ANNcoord		*lo;				// low corners (dim per node)
+	ANNcoord		*hi;				// high corners (dim per node)
+};
+
+struct ANNdualState {					// state of a dual-tree search
+	ANNdualTree		q;					// query tree
+	ANNdualTree		d;					// data tree
+	int				dim;				// dimension of space
+	divergence		div;				// divergence component
+	double			max_err;			// 1 + eps
+	ANNmin_k		**mk;				// k closest points per query
+	ANNdist			*bound;				// bound per query node
+};
+
+//----------------------------------------------------------------------
+//	annDualBoxes - tight boxes and point counts of a subtree
+//		Returns the record following the subtree.  Empty nodes get an
+//		empty box (lo > hi).
+//----------------------------------------------------------------------
+
+static long long annDualBoxes(ANNdualTree &t, long long i, int dim)
+{
+	ANNcoord *lo = &t.lo[i*dim];
+	ANNcoord *hi = &t.hi[i*dim];
+	for (int d = 0; d < dim; d++) {
+		lo[d] = ANN_DBL_MAX;
+		hi[d] = -ANN_DBL_MAX;
+	}
+	const ANNbinNode &r = t.rec[i];
+	if (r.kind == ANN_BIN_LEAF) {
+		t.cnt[i] = r.link < 0 ? 0 : r.n;
+		for (ANNidx j = 0; j < t.cnt[i]; j++) {
+			ANNpoint p = t.pts[t.pidx[r.link + j]];
+			for (int d = 0; d < dim; d++) {
+				if (p[d] < lo[d]) lo[d] = p[d];
+				if (p[d] > hi[d]) hi[d] = p[d];
+			}
+		}
+		return i + 1;
+	}
+	long long h = annDualBoxes(t, i + 1, dim);		// low child follows
+	long long end = annDualBoxes(t, h, dim);		// then the high child
+	t.cnt[i] = t.cnt[i + 1] + t.cnt[h];
+	for (long long c = i + 1; c != -1; c = (c == h ? -1 : h)) {
+		for (int d = 0; d < dim; d++) {
+			if (t.lo[c*dim + d] < lo[d]) lo[d] = t.lo[c*dim + d];
+			if (t.hi[c*dim + d] > hi[d]) hi[d] = t.hi[c*dim + d];
+		}
+	}
+	return end;
+}
+
+static void annDualPrepare(ANNdualTree &t, ANNbinNode *rec,
+	long long n_nodes, ANNpointArray pts, ANNidxArray pidx, int dim)
+{
+	t.rec = rec;
+	t.pts = pts;
+	t.pidx = pidx;
+	t.cnt = new ANNidx[n_nodes];
+	t.lo = new ANNcoord[n_nodes * dim];
+	t.hi = new ANNcoord[n_nodes * dim];
+	annDualBoxes(t, 0, dim);
+}
+
+static void annDualRelease(ANNdualTree &t)
+{
+	delete [] t.rec;
+	delete [] t.cnt;
+	delete [] t.lo;
+	delete [] t.hi;
+}
+
+//----------------------------------------------------------------------
+//	annDualDist - lower bound on the divergence between two node boxes
+//		Stops adding once the bound exceeds limit.
+//----------------------------------------------------------------------
+
+static ANNdist annDualDist(ANNdualState &st, long long qi, long long di, ANNdist limit)
+{
+	const ANNcoord *qlo = &st.q.lo[qi*st.dim];
+	const ANNcoord *qhi = &st.q.hi[qi*st.dim];
+	const ANNcoord *dlo = &st.d.lo[di*st.dim];
+	const ANNcoord *dhi = &st.d.hi[di*st.dim];
+	ANNdist dist = 0;
+	for (int d = 0; d < st.dim; d++) {
+		if (qhi[d] < dlo[d]) {			// query box below data box
+			dist += st.div(qhi[d], dlo[d]);
+		}
+		else if (qlo[d] > dhi[d]) {		// query box above data box
+			dist += st.div(qlo[d], dhi[d]);
+		}
+		if (dist > limit) break;
+	}
+	ANN_FLOP(4*st.dim)					// increment floating ops
+	return dist;
+}
+
+//----------------------------------------------------------------------
+//	annDualLeaves - compare the queries of a leaf against a data leaf
+//----------------------------------------------------------------------
+
+static void annDualLeaves(ANNdualState &st, long long qi, long long di)
+{
+	const ANNbinNode &qn = st.q.rec[qi];
+	const ANNbinNode &dn = st.d.rec[di];
+	ANNdist bound = 0;
+	for (ANNidx a = 0; a < st.q.cnt[qi]; a++) {
+		ANNidx qid = st.q.pidx[qn.link + a];
+		ANNpoint q = st.q.pts[qid];
+		ANNmin_k *mk = st.mk[qid];
+		ANNdist min_dist = mk->max_key();	// k-th smallest distance so far
+
+		for (ANNidx b = 0; b < st.d.cnt[di]; b++) {
+			ANNidx did = st.d.pidx[dn.link + b];
+			ANNpoint p = st.d.pts[did];
+			ANNdist dist = 0;
+			int d;
+			for (d = 0; d < st.dim; d++) {
+				dist += st.div(q[d], p[d]);
+				if (dist > min_dist) break;
+			}
+			if (d >= st.dim &&					// among the k best?
+			   (ANN_ALLOW_SELF_MATCH || dist!=0)) { // and no self-match problem
+				mk->insert(dist, did);
+				min_dist = mk->max_key();
+			}
+		}
+		if (min_dist > bound) bound = min_dist;
+		ANN_PTS(st.d.cnt[di])			// increment points visited
+	}
+	st.bound[qi] = bound;
+	ANN_LEAF(1)							// one more leaf node visited
+}
+
+//----------------------------------------------------------------------
+//	annDualPair - search a pair of nodes with box lower bound dist
+//		The larger node of the pair is split, visiting the closer data
+//		child first.  The bound of a split query node is the larger of
+//		the bounds of its children.
+//----------------------------------------------------------------------
+
+static void annDualPair(ANNdualState &st, long long qi, long long di, ANNdist dist)
+{
+	if (st.q.cnt[qi] == 0 || st.d.cnt[di] == 0) return;
+	if (!(dist * st.max_err < st.bound[qi])) return;	// pruned
+
+	const ANNbinNode &qn = st.q.rec[qi];
+	const ANNbinNode &dn = st.d.rec[di];
+	if (qn.kind == ANN_BIN_LEAF && dn.kind == ANN_BIN_LEAF) {
+		annDualLeaves(st, qi, di);
+	}
+	else if (qn.kind == ANN_BIN_LEAF ||
+			(dn.kind != ANN_BIN_LEAF && st.d.cnt[di] >= st.q.cnt[qi])) {
+		long long lo = di + 1, hi = dn.link;		// split the data node
+		ANNdist lo_dist = annDualDist(st, qi, lo, st.bound[qi]);
+		ANNdist hi_dist = annDualDist(st, qi, hi, st.bound[qi]);
+		if (lo_dist <= hi_dist) {
+			annDualPair(st, qi, lo, lo_dist);
+			annDualPair(st, qi, hi, hi_dist);
+		}
+		else {
+			annDualPair(st, qi, hi, hi_dist);
+			annDualPair(st, qi, lo, lo_dist);
+		}
+	}
+	else {
+		long long lo = qi + 1, hi = qn.link;		// split the query node
+		annDualPair(st, lo, di, annDualDist(st, lo, di, st.bound[lo]));
+		annDualPair(st, hi, di, annDualDist(st, hi, di, st.bound[hi]));
+		st.bound[qi] = st.bound[lo] > st.bound[hi] ? st.bound[lo] : st.bound[hi];
+	}
+	ANN_SPL(1)							// one more pair visited
+}
+
+//----------------------------------------------------------------------
+//	annkDualSearch - search for the k nearest neighbors of all points
+//		of qtree.  The results of point j of qtree are stored at
+//		nn_idx[j*k ...] and dd[j*k ...].
+//----------------------------------------------------------------------
+
+void ANNkd_tree::annkDualSearch(
+	divergence			div_component,	// divergence component function
+	ANNkd_tree			*qtree,			// kd-tree over the query points
+	int					k,				// number of near neighbors to return
+	ANNidxArray			nn_idx,			// nearest neighbors (nq*k, returned)
+	ANNdistArray		dd,				// dist to near neighbors (nq*k, returned)
+	double				eps)			// error bound
+{
+	if (k > n_pts) {					// too many near neighbors?
+		annError("Requesting more near neighbors than data points", ANNabort);
+	}
+	ANNidx nq = qtree->n_pts;
+	ANNpointArray qpts = qtree->pts;
+
+	long long n_q, n_d;
+	ANNbinNode *q_rec = qtree->flattenTree(n_q);
+	ANNbinNode *d_rec = flattenTree(n_d);
+	ANNbool flat = (ANNbool) (n_q > 0 && n_d > 0);
+	for (long long i = 0; flat && i < n_q; i++) {
+		if (q_rec[i].kind == ANN_BIN_SHRINK) flat = ANNfalse;
+	}
+	for (long long i = 0; flat && i < n_d; i++) {
+		if (d_rec[i].kind == ANN_BIN_SHRINK) flat = ANNfalse;
+	}
+	if (!flat) {						// search query by query
+		delete [] q_rec;
+		delete [] d_rec;
+		for (ANNidx j = 0; j < nq; j++) {
+			annkSearch(div_component, qpts[j], k, &nn_idx[j*k], &dd[j*k], eps);
+		}
+		return;
+	}
+
+	ANNdualState st;
+	st.dim = dim;
+	st.div = div_component;
+	st.max_err = 1.0 + eps;
+	annDualPrepare(st.q, q_rec, n_q, qpts, qtree->pidx, dim);
+	annDualPrepare(st.d, d_rec, n_d, pts, pidx, dim);
+
+	st.mk = new ANNmin_k*[nq];
+	for (ANNidx j = 0; j < nq; j++) {
+		st.mk[j] = new ANNmin_k(k);
+	}
+	st.bound = new ANNdist[n_q];
+	for (long long i = 0; i < n_q; i++) {
+		st.bound[i] = ANN_DIST_INF;
+	}
+
+	annDualPair(st, 0, 0, annDualDist(st, 0, 0, ANN_DIST_INF));
+
+	for (ANNidx j = 0; j < nq; j++) {	// extract the k-th closest points
+		for (int i = 0; i < k; i++) {
+			dd[j*k + i] = st.mk[j]->ith_smallest_key(i);
+			nn_idx[j*k + i] = st.mk[j]->ith_smallest_info(i);
+		}
+		delete st.mk[j];
+	}
+	delete [] st.mk;
+	delete [] st.bound;
+	annDualRelease(st.q);
+	annDualRelease(st.d);
+}
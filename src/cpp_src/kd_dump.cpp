@@ -55,7 +55,7 @@ static ANNkd_ptr annReadDump(			// read dump file
 	ANNpointArray		&the_pts,				// new points (if applic)
 	ANNidxArray			&the_pidx,				// point indices (returned)
 	int					&the_dim,				// dimension (returned)
-	int					&the_n_pts,				// number of points (returned)
+	ANNidx				&the_n_pts,				// number of points (returned)
 	int					&the_bkt_size,			// bucket size (returned)
 	ANNpoint			&the_bnd_box_lo,		// low bounding point
 	ANNpoint			&the_bnd_box_hi);		// high bounding point
@@ -64,7 +64,7 @@ static ANNkd_ptr annReadTree(			// read tree-part of dump file
 	istream				&in,					// input stream
 	ANNtreeType			tree_type,				// type of tree expected
 	ANNidxArray			the_pidx,				// point indices (modified)
-	int					&next_idx);				// next index (modified)
+	ANNidx				&next_idx);				// next index (modified)
 
 //----------------------------------------------------------------------
 //	ANN kd- and bd-tree Dump Format
@@ -107,7 +107,7 @@ void ANNkd_tree::Dump(					// dump entire tree
 	out.precision(ANNcoordPrec);		// use full precision in dumping
 	if (with_pts) {						// print point coordinates
 		out << "points " << dim << " " << n_pts << "\n";
-		for (int i = 0; i < n_pts; i++) {
+		for (ANNidx i = 0; i < n_pts; i++) {
 			out << i << " ";
 			annPrintPt(pts[i], dim, out);
 			out << "\n";
@@ -187,7 +187,7 @@ ANNkd_tree::ANNkd_tree(					// build from dump file
 	istream				&in)					// input stream for dump file
 {
 	int the_dim;								// local dimension
-	int the_n_pts;								// local number of points
+	ANNidx the_n_pts;							// local number of points
 	int the_bkt_size;							// local number of points
 	ANNpoint the_bnd_box_lo;					// low bounding point
 	ANNpoint the_bnd_box_hi;					// high bounding point
@@ -216,7 +216,7 @@ ANNbd_tree::ANNbd_tree(					// build bd-tree from dump file
 	istream				&in) : ANNkd_tree()		// input stream for dump file
 {
 	int the_dim;								// local dimension
-	int the_n_pts;								// local number of points
+	ANNidx the_n_pts;							// local number of points
 	int the_bkt_size;							// local number of points
 	ANNpoint the_bnd_box_lo;					// low bounding point
 	ANNpoint the_bnd_box_hi;					// high bounding point
@@ -256,7 +256,7 @@ static ANNkd_ptr annReadDump(
 	ANNpointArray		&the_pts,				// new points (returned)
 	ANNidxArray			&the_pidx,				// point indices (returned)
 	int					&the_dim,				// dimension (returned)
-	int					&the_n_pts,				// number of points (returned)
+	ANNidx				&the_n_pts,				// number of points (returned)
 	int					&the_bkt_size,			// bucket size (returned)
 	ANNpoint			&the_bnd_box_lo,		// low bounding point (ret'd)
 	ANNpoint			&the_bnd_box_hi)		// high bounding point (ret'd)
@@ -286,7 +286,7 @@ static ANNkd_ptr annReadDump(
 		in >> the_n_pts;						// number of points
 												// allocate point storage
 		the_pts = annAllocPts(the_n_pts, the_dim);
-		for (int i = 0; i < the_n_pts; i++) {	// input point coordinates
+		for (ANNidx i = 0; i < the_n_pts; i++) {	// input point coordinates
 			ANNidx idx;							// point index
 			in >> idx;							// input point index
 			if (idx < 0 || idx >= the_n_pts) {
@@ -323,8 +323,9 @@ static ANNkd_ptr annReadDump(
 		for (j = 0; j < the_dim; j++) {			// read bounding box low
 			in >> the_bnd_box_hi[j];
 		}
-		the_pidx = new ANNidx[the_n_pts];		// allocate point index array
-		int next_idx = 0;						// number of indices filled
+												// allocate point index array
+		the_pidx = (ANNidxArray) annAllocAligned(the_n_pts * sizeof(ANNidx));
+		ANNidx next_idx = 0;					// number of indices filled
 												// read the tree and indices
 		the_root = annReadTree(in, tree_type, the_pidx, next_idx);
 		if (next_idx != the_n_pts) {			// didn't see all the points?
@@ -369,7 +370,7 @@ static ANNkd_ptr annReadTree(
 	istream				&in,					// input stream
 	ANNtreeType			tree_type,				// type of tree expected
 	ANNidxArray			the_pidx,				// point indices (modified)
-	int					&next_idx)				// next index (modified)
+	ANNidx				&next_idx)				// next index (modified)
 {
 	char tag[STRING_LEN];						// tag (leaf, split, shrink)
 	int n_pts;									// number of points in leaf
@@ -391,7 +392,7 @@ static ANNkd_ptr annReadTree(
 	if (strcmp(tag, "leaf") == 0) {				// leaf node
 
 		in >> n_pts;							// input number of points
-		int old_idx = next_idx;					// save next_idx
+		ANNidx old_idx = next_idx;				// save next_idx
 		if (n_pts == 0) {						// trivial leaf
 			return KD_TRIVIAL;
 		}
@@ -34,6 +34,10 @@
 //		nearest neighbor search used in kd_search.cpp, except that the
 //		radius of the search ball is known.  We refer the reader to that
 //		file for the explanation of the recursive search procedure.
+//
+//		Distances are computed with the divergence component function,
+//		as in kd_search.cpp, so the "squared radius" is a bound on the
+//		divergence from the query point.
 //----------------------------------------------------------------------
 
 //----------------------------------------------------------------------
@@ -42,20 +46,25 @@
 //		These are given below.
 //----------------------------------------------------------------------
 
-int				ANNkdFRDim;				// dimension of space
-ANNpoint		ANNkdFRQ;				// query point
-ANNdist			ANNkdFRSqRad;			// squared radius search bound
-double			ANNkdFRMaxErr;			// max tolerable squared error
-ANNpointArray	ANNkdFRPts;				// the points
-ANNmin_k*		ANNkdFRPointMK;			// set of k closest points
-int				ANNkdFRPtsVisited;		// total points visited
-int				ANNkdFRPtsInRange;		// number of points in the range
+thread_local int				ANNkdFRDim;				// dimension of space
+thread_local ANNpoint		ANNkdFRQ;				// query point
+thread_local ANNdist			ANNkdFRSqRad;			// squared radius search bound
+thread_local double			ANNkdFRMaxErr;			// max tolerable squared error
+thread_local ANNpointArray	ANNkdFRPts;				// the points
+thread_local ANNmin_k*		ANNkdFRPointMK;			// set of k closest points
+thread_local ANNidx			ANNkdFRPtsVisited;		// total points visited
+thread_local ANNidx			ANNkdFRPtsInRange;		// number of points in the range
+thread_local std::vector<ANNidx>	*ANNkdFRIdx;			// points in range (annRangeSearch)
+thread_local std::vector<ANNdist>	*ANNkdFRDist;			// their distances
+thread_local ANNcoord			*ANNkdFRLo;				// cell of the node (annRangeCount)
+thread_local ANNcoord			*ANNkdFRHi;
 
 //----------------------------------------------------------------------
 //	annkFRSearch - fixed radius search for k nearest neighbors
 //----------------------------------------------------------------------
 
-int ANNkd_tree::annkFRSearch(
+ANNidx ANNkd_tree::annkFRSearch(
+	divergence			div_component,	// divergence component function
 	ANNpoint			q,				// the query point
 	ANNdist				sqRad,			// squared radius search bound
 	int					k,				// number of near neighbors to return
@@ -70,13 +79,13 @@ int ANNkd_tree::annkFRSearch(
 	ANNkdFRPtsVisited = 0;				// initialize count of points visited
 	ANNkdFRPtsInRange = 0;				// ...and points in the range
 
-	ANNkdFRMaxErr = ANN_POW(1.0 + eps);
+	ANNkdFRMaxErr = 1.0 + eps;
 	ANN_FLOP(2)							// increment floating op count
 
 	ANNkdFRPointMK = new ANNmin_k(k);	// create set for closest k points
+	ANNkdFRIdx = NULL;					// ...rather than reporting all
 										// search starting at the root
-	root->ann_FR_search(annBoxDistance(q, bnd_box_lo, bnd_box_hi, dim, div_component_eucl));
-	// Temporary hard coded for squared euclidean distance 
+	root->ann_FR_search(annBoxDistance(q, bnd_box_lo, bnd_box_hi, dim, div_component), div_component);
 
 	for (int i = 0; i < k; i++) {		// extract the k-th closest points
 		if (dd != NULL)
@@ -89,6 +98,177 @@ int ANNkd_tree::annkFRSearch(
 	return ANNkdFRPtsInRange;			// return final point count
 }
 
+//----------------------------------------------------------------------
+//	annRangeSearch - report all points within a fixed radius
+//		The traversal is that of annkFRSearch(), but each point in range
+//		is appended to nn_idx and dd as it is found, so the cost does
+//		not grow with the product of the number of points in range and
+//		the size of a k-element queue.  If sorted is true, the points
+//		appended are then sorted by increasing distance (and index).
+//		Returns the number of points appended.
+//----------------------------------------------------------------------
+
+ANNidx ANNkd_tree::annRangeSearch(
+	divergence			div_component,	// divergence component function
+	ANNpoint			q,				// the query point
+	ANNdist				sqRad,			// squared radius search bound
+	std::vector<ANNidx>	&nn_idx,		// points in range (appended)
+	std::vector<ANNdist> &dd,			// their distances (appended)
+	ANNbool				sorted,			// closest first?
+	double				eps)			// the error bound
+{
+	ANNkdFRDim = dim;					// copy arguments to static equivs
+	ANNkdFRQ = q;
+	ANNkdFRSqRad = sqRad;
+	ANNkdFRPts = pts;
+	ANNkdFRPtsVisited = 0;				// initialize count of points visited
+	ANNkdFRPtsInRange = 0;				// ...and points in the range
+
+	ANNkdFRMaxErr = 1.0 + eps;
+	ANN_FLOP(2)							// increment floating op count
+
+	size_t first = nn_idx.size();		// start of this query's points
+	ANNkdFRPointMK = NULL;
+	ANNkdFRIdx = &nn_idx;				// report all points in range
+	ANNkdFRDist = &dd;
+										// search starting at the root
+	root->ann_FR_search(annBoxDistance(q, bnd_box_lo, bnd_box_hi, dim, div_component), div_component);
+	ANNkdFRIdx = NULL;
+
+	size_t n = nn_idx.size() - first;
+	if (sorted && n > 1) {				// sort by distance, then index
+		std::vector<std::pair<ANNdist, ANNidx> > pairs(n);
+		for (size_t i = 0; i < n; i++) {
+			pairs[i] = std::make_pair(dd[first + i], nn_idx[first + i]);
+		}
+		std::sort(pairs.begin(), pairs.end());
+		for (size_t i = 0; i < n; i++) {
+			dd[first + i] = pairs[i].first;
+			nn_idx[first + i] = pairs[i].second;
+		}
+	}
+	return (ANNidx) n;
+}
+
+//----------------------------------------------------------------------
+//	annRangeCount - count the points within a fixed radius
+//		Gives the number reported by annkFRSearch() without visiting
+//		every leaf in range.  The cell of each node is tracked on the
+//		way down, with lower and upper bounds on the divergence from
+//		the query to its points (see annCellLower() and annCellUpper()),
+//		updated in the cutting dimension only.  A subtree whose upper
+//		bound is within the radius is counted as a whole from its
+//		stored number of points, one whose lower bound times 1+eps
+//		exceeds the radius is skipped, and only leaves crossing the
+//		boundary of the ball are scanned.  As for annkFRSearch(), the
+//		count includes every point within radius/(1+eps) and none
+//		further than the radius.
+//----------------------------------------------------------------------
+
+ANNidx ANNkd_tree::annRangeCount(
+	divergence			div_component,	// divergence component function
+	ANNpoint			q,				// the query point
+	ANNdist				sqRad,			// squared radius search bound
+	double				eps)			// the error bound
+{
+	ANNkdFRDim = dim;					// copy arguments to static equivs
+	ANNkdFRQ = q;
+	ANNkdFRSqRad = sqRad;
+	ANNkdFRPts = pts;
+	ANNkdFRMaxErr = 1.0 + eps;
+	ANN_FLOP(2)							// increment floating op count
+
+	ANNkdFRLo = new ANNcoord[dim];		// cell of the root
+	ANNkdFRHi = new ANNcoord[dim];
+	ANNdist lower = 0;
+	ANNdist upper = 0;
+	for (int d = 0; d < dim; d++) {
+		ANNkdFRLo[d] = bnd_box_lo[d];
+		ANNkdFRHi[d] = bnd_box_hi[d];
+		lower += annCellLower(div_component, q[d], bnd_box_lo[d], bnd_box_hi[d]);
+		upper += annCellUpper(div_component, q[d], bnd_box_lo[d], bnd_box_hi[d]);
+	}
+	ANNidx n = (root == NULL ? 0 : annFRCountNode(root, lower, upper, div_component));
+
+	delete [] ANNkdFRLo;
+	delete [] ANNkdFRHi;
+	return n;
+}
+
+//----------------------------------------------------------------------
+//	annFRCountNode - count the points of a subtree in range
+//----------------------------------------------------------------------
+
+ANNidx annFRCountNode(
+	ANNkd_ptr			node,			// the subtree
+	ANNdist				lower,			// lower bound on its divergence
+	ANNdist				upper,			// upper bound on its divergence
+	divergence			div_component)	// divergence component function
+{
+	if (lower * ANNkdFRMaxErr > ANNkdFRSqRad)	// cell outside the ball
+		return 0;
+	if (ANN_ALLOW_SELF_MATCH && upper <= ANNkdFRSqRad)	// cell inside
+		return node->count();
+	return node->ann_FR_count(lower, upper, div_component);
+}
+
+//----------------------------------------------------------------------
+//	kd_split::ann_FR_count - count points in range below a splitting node
+//		The cells of the children differ from the node's only along the
+//		cutting dimension, so the bounds change by one term each.
+//----------------------------------------------------------------------
+
+ANNidx ANNkd_split::ann_FR_count(ANNdist lower, ANNdist upper, divergence div_component)
+{
+	ANNcoord q = ANNkdFRQ[cut_dim];
+	ANNcoord lo = ANNkdFRLo[cut_dim];
+	ANNcoord hi = ANNkdFRHi[cut_dim];
+	lower -= annCellLower(div_component, q, lo, hi);	// remove this dimension
+	upper -= annCellUpper(div_component, q, lo, hi);
+
+	ANNkdFRHi[cut_dim] = cut_val;		// low child [lo, cut_val]
+	ANNidx n = annFRCountNode(child[ANN_LO],
+			lower + annCellLower(div_component, q, lo, cut_val),
+			upper + annCellUpper(div_component, q, lo, cut_val), div_component);
+	ANNkdFRHi[cut_dim] = hi;
+
+	ANNkdFRLo[cut_dim] = cut_val;		// high child [cut_val, hi]
+	n += annFRCountNode(child[ANN_HI],
+			lower + annCellLower(div_component, q, cut_val, hi),
+			upper + annCellUpper(div_component, q, cut_val, hi), div_component);
+	ANNkdFRLo[cut_dim] = lo;
+
+	ANN_FLOP(16)						// increment floating ops
+	ANN_SPL(1)							// one more splitting node visited
+	return n;
+}
+
+//----------------------------------------------------------------------
+//	kd_leaf::ann_FR_count - count points in range in a leaf node
+//----------------------------------------------------------------------
+
+ANNidx ANNkd_leaf::ann_FR_count(ANNdist /*lower*/, ANNdist /*upper*/, divergence div_component)
+{
+	ANNidx n = 0;
+	for (int i = 0; i < n_pts; i++) {	// check points in bucket
+		ANNcoord* pp = ANNkdFRPts[bkt[i]];
+		ANNdist dist = 0;
+		int d;
+		for (d = 0; d < ANNkdFRDim; d++) {
+			if ((dist += div_component(ANNkdFRQ[d], pp[d])) > ANNkdFRSqRad) {
+				break;
+			}
+		}
+		if (d >= ANNkdFRDim &&					// in range?
+		   (ANN_ALLOW_SELF_MATCH || dist!=0)) { // and no self-match problem
+			n++;
+		}
+	}
+	ANN_LEAF(1)							// one more leaf node visited
+	ANN_PTS(n_pts)						// increment points visited
+	return n;
+}
+
 //----------------------------------------------------------------------
 //	kd_split::ann_FR_search - search a splitting node
 //		Note: This routine is similar in structure to the standard kNN
@@ -98,7 +278,7 @@ int ANNkd_tree::annkFRSearch(
 //		code structure for the sake of uniformity.
 //----------------------------------------------------------------------
 
-void ANNkd_split::ann_FR_search(ANNdist box_dist)
+void ANNkd_split::ann_FR_search(ANNdist box_dist, divergence div_component)
 {
 										// check dist calc term condition
 	if (ANNmaxPtsVisited != 0 && ANNkdFRPtsVisited > ANNmaxPtsVisited) return;
@@ -107,33 +287,33 @@ void ANNkd_split::ann_FR_search(ANNdist box_dist)
 	ANNcoord cut_diff = ANNkdFRQ[cut_dim] - cut_val;
 
 	if (cut_diff < 0) {					// left of cutting plane
-		child[ANN_LO]->ann_FR_search(box_dist);// visit closer child first
+		child[ANN_LO]->ann_FR_search(box_dist, div_component);// visit closer child first
 
-		ANNcoord box_diff = cd_bnds[ANN_LO] - ANNkdFRQ[cut_dim];
-		if (box_diff < 0)				// within bounds - ignore
-			box_diff = 0;
 										// distance to further box
-		box_dist = (ANNdist) ANN_SUM(box_dist,
-				ANN_DIFF(ANN_POW(box_diff), ANN_POW(cut_diff)));
+		box_dist += div_component(ANNkdFRQ[cut_dim], cut_val);
+
+		ANNcoord box_diff = cd_bnds[ANN_LO] - ANNkdFRQ[cut_dim];
+		if (box_diff > 0)				// outside bounds - replace term
+			box_dist -= div_component(ANNkdFRQ[cut_dim], cd_bnds[ANN_LO]);
 
 										// visit further child if in range
 		if (box_dist * ANNkdFRMaxErr <= ANNkdFRSqRad)
-			child[ANN_HI]->ann_FR_search(box_dist);
+			child[ANN_HI]->ann_FR_search(box_dist, div_component);
 
 	}
 	else {								// right of cutting plane
-		child[ANN_HI]->ann_FR_search(box_dist);// visit closer child first
+		child[ANN_HI]->ann_FR_search(box_dist, div_component);// visit closer child first
 
-		ANNcoord box_diff = ANNkdFRQ[cut_dim] - cd_bnds[ANN_HI];
-		if (box_diff < 0)				// within bounds - ignore
-			box_diff = 0;
 										// distance to further box
-		box_dist = (ANNdist) ANN_SUM(box_dist,
-				ANN_DIFF(ANN_POW(box_diff), ANN_POW(cut_diff)));
+		box_dist += div_component(ANNkdFRQ[cut_dim], cut_val);
+
+		ANNcoord box_diff = ANNkdFRQ[cut_dim] - cd_bnds[ANN_HI];
+		if (box_diff > 0)				// outside bounds - replace term
+			box_dist -= div_component(ANNkdFRQ[cut_dim], cd_bnds[ANN_HI]);
 
 										// visit further child if close enough
 		if (box_dist * ANNkdFRMaxErr <= ANNkdFRSqRad)
-			child[ANN_LO]->ann_FR_search(box_dist);
+			child[ANN_LO]->ann_FR_search(box_dist, div_component);
 
 	}
 	ANN_FLOP(13)						// increment floating ops
@@ -146,7 +326,7 @@ void ANNkd_split::ann_FR_search(ANNdist box_dist)
 //		some fine tuning to replace indexing by pointer operations.
 //----------------------------------------------------------------------
 
-void ANNkd_leaf::ann_FR_search(ANNdist box_dist)
+void ANNkd_leaf::ann_FR_search(ANNdist box_dist, divergence div_component)
 {
 //	register ANNdist dist;				// distance to data point
 //	register ANNcoord* pp;				// data coordinate pointer
@@ -156,7 +336,6 @@ void ANNkd_leaf::ann_FR_search(ANNdist box_dist)
 	ANNdist dist;				// distance to data point
 	ANNcoord* pp;				// data coordinate pointer
    ANNcoord* qq;				// query coordinate pointer
-   ANNcoord t;
    int d;
 
 	for (int i = 0; i < n_pts; i++) {	// check points in bucket
@@ -169,17 +348,21 @@ void ANNkd_leaf::ann_FR_search(ANNdist box_dist)
 			ANN_COORD(1)				// one more coordinate hit
 			ANN_FLOP(5)					// increment floating ops
 
-			t = *(qq++) - *(pp++);		// compute length and adv coordinate
-										// exceeds dist to k-th smallest?
-			if( (dist = ANN_SUM(dist, ANN_POW(t))) > ANNkdFRSqRad) {
+										// exceeds radius bound?
+			if( (dist += div_component(*qq++, *pp++)) > ANNkdFRSqRad) {
 				break;
 			}
 		}
 
 		if (d >= ANNkdFRDim &&					// among the k best?
 		   (ANN_ALLOW_SELF_MATCH || dist!=0)) { // and no self-match problem
-												// add it to the list
-			ANNkdFRPointMK->insert(dist, bkt[i]);
+			if (ANNkdFRIdx != NULL) {			// report it
+				ANNkdFRIdx->push_back(bkt[i]);
+				ANNkdFRDist->push_back(dist);
+			}
+			else {								// add it to the list
+				ANNkdFRPointMK->insert(dist, bkt[i]);
+			}
 			ANNkdFRPtsInRange++;				// increment point count
 		}
 	}
@@ -39,6 +39,38 @@
 //		procedures.
 //----------------------------------------------------------------------
 
-extern ANNpoint			ANNkdFRQ;			// query point (static copy)
+extern thread_local ANNpoint			ANNkdFRQ;			// query point (static copy)
+extern thread_local ANNcoord			*ANNkdFRLo;			// cell of the node (annRangeCount)
+extern thread_local ANNcoord			*ANNkdFRHi;
+
+//----------------------------------------------------------------------
+//	Bounds of a cell for range counting
+//		The divergence component from the query coordinate q to x,
+//		for x in the interval [lo, hi] of the cell, is smallest at the
+//		point of the interval closest to q (0 if q lies in it), and
+//		largest at one of the ends, since it decreases as x moves
+//		towards q.  Summed over the coordinates these bound the
+//		divergence from q to any point of the cell.
+//----------------------------------------------------------------------
+
+inline ANNdist annCellLower(divergence div_component, ANNcoord q, ANNcoord lo, ANNcoord hi)
+{
+	if (q < lo) return div_component(q, lo);
+	if (q > hi) return div_component(q, hi);
+	return 0;
+}
+
+inline ANNdist annCellUpper(divergence div_component, ANNcoord q, ANNcoord lo, ANNcoord hi)
+{
+	ANNdist d_lo = div_component(q, lo);
+	ANNdist d_hi = div_component(q, hi);
+	return d_lo > d_hi ? d_lo : d_hi;
+}
+
+ANNidx annFRCountNode(					// count the points of a subtree
+	ANNkd_ptr			node,			// the subtree
+	ANNdist				lower,			// lower bound on its divergence
+	ANNdist				upper,			// upper bound on its divergence
+	divergence			div_component);	// divergence component function
 
 #endif
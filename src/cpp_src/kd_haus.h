@@ -7,11 +7,11 @@
 
 #include <ANNperf.h>
 
-extern int           ANNkdDim;
-extern ANNpoint      ANNkdQ;
-extern double        ANNkdMaxErr;
-extern ANNpointArray ANNkdPts;
-extern ANNmin_k      *ANNkdPointMK;
-extern int           ANNptsVisited;
+extern thread_local int           ANNkdDim;
+extern thread_local ANNpoint      ANNkdQ;
+extern thread_local double        ANNkdMaxErr;
+extern thread_local ANNpointArray ANNkdPts;
+extern thread_local ANNmin_k      *ANNkdPointMK;
+extern thread_local ANNidx        ANNptsVisited;
 
 #endif
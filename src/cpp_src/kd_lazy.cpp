@@ -0,0 +1,120 @@
+//----------------------------------------------------------------------
+// File:			kd_lazy.cpp
+// Description:		Lazy construction of kd-trees
+//----------------------------------------------------------------------
+// BANN History:
+// Revision 1.1
+//    Initial release: subtrees built by the first search reaching them
+//----------------------------------------------------------------------
+
+#include "kd_tree.h"					// kd-tree declarations
+
+//----------------------------------------------------------------------
+//	Lazy construction
+//		A tree built for a single call, such as bann.bhaus(), is often
+//		searched in a small part only: the Hausdorff search stops each
+//		query as soon as it finds a point closer than the divergence so
+//		far, and few queries visit more than a few leaves.  Building all
+//		of it up front then takes most of the time of the call.
+//
+//		A lazily built tree starts as a single ANNkd_lazy node holding
+//		all the points.  The first search to reach a lazy node builds
+//		ANN_LAZY_LEVELS levels of its subtree with the splitting rule of
+//		the tree, which permutes only the point indices of the node, and
+//		leaves lazy nodes below them.  Subtrees of at most ANN_LAZY_PTS
+//		points are built completely.  Lazy nodes stay in the tree and
+//		forward every call to the subtree built in their place, which
+//		costs a search reaching every cell a few percent; building one
+//		level at a time keeps the work of a search touching few cells
+//		lowest.
+//
+//		The subtree is built under the lock of the node and published
+//		through an atomic pointer, so searches running in parallel see
+//		either the lazy node or the complete subtree.  Subtrees of
+//		different nodes hold disjoint ranges of point indices and are
+//		built independently.  The finished tree is the same as the one
+//		built eagerly, so results do not depend on the order in which
+//		it was built.
+//----------------------------------------------------------------------
+
+const int ANN_LAZY_LEVELS = 1;			// levels built at a time
+const ANNidx ANN_LAZY_PTS = 256;		// subtrees built completely
+
+ANNkd_lazy::ANNkd_lazy(
+	ANNpointArray		pa,				// the points
+	ANNidxArray			pidx,			// point indices of the subtree
+	ANNidx				n,				// number of points
+	int					dim,			// dimension of space
+	int					bsp,			// bucket size
+	const ANNorthRect	&bnd_box,		// cell
+	ANNkd_splitter		splitter)		// splitting routine
+	: pa(pa), pidx(pidx), n_pts(n), dim(dim), bsp(bsp), splitter(splitter),
+	  bnd_box(new ANNorthRect(dim, bnd_box)), node(NULL)
+{
+}
+
+ANNkd_lazy::~ANNkd_lazy()
+{
+	ANNkd_ptr p = node.load(std::memory_order_acquire);
+	if (p != NULL && p != KD_TRIVIAL) delete p;
+	delete bnd_box;
+}
+
+//----------------------------------------------------------------------
+//	build - build the next levels of the subtree
+//----------------------------------------------------------------------
+
+ANNkd_ptr ANNkd_lazy::build()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	ANNkd_ptr p = node.load(std::memory_order_acquire);
+	if (p == NULL) {					// not built by another thread
+		p = rkd_tree_lazy(pa, pidx, n_pts, dim, bsp, *bnd_box, splitter, ANN_LAZY_LEVELS);
+		delete bnd_box;					// no longer needed
+		bnd_box = NULL;
+		node.store(p, std::memory_order_release);
+	}
+	return p;
+}
+
+//----------------------------------------------------------------------
+//	rkd_tree_lazy - build the top levels of a kd-tree
+//		As rkd_tree(), stopping after the given number of levels with
+//		lazy nodes, or with no level at all if levels is 0.
+//----------------------------------------------------------------------
+
+ANNkd_ptr rkd_tree_lazy(
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pidx,			// point indices to store in subtree
+	ANNidx				n,				// number of points
+	int					dim,			// dimension of space
+	int					bsp,			// bucket space
+	ANNorthRect			&bnd_box,		// bounding box for current node
+	ANNkd_splitter		splitter,		// splitting routine
+	int					levels)			// levels to build, lazy below
+{
+	if (n <= bsp || n <= ANN_LAZY_PTS)	// small enough to build at once
+		return rkd_tree(pa, pidx, n, dim, bsp, bnd_box, splitter);
+	if (levels == 0)					// leave for later
+		return new ANNkd_lazy(pa, pidx, n, dim, bsp, bnd_box, splitter);
+
+	int cd;								// cutting dimension
+	ANNcoord cv;						// cutting value
+	ANNidx n_lo;						// number on low side of cut
+	ANNkd_node *lo, *hi;				// low and high children
+
+	(*splitter)(pa, pidx, bnd_box, n, dim, cd, cv, n_lo);
+
+	ANNcoord lv = bnd_box.lo[cd];		// save bounds for cutting dimension
+	ANNcoord hv = bnd_box.hi[cd];
+
+	bnd_box.hi[cd] = cv;				// modify bounds for left subtree
+	lo = rkd_tree_lazy(pa, pidx, n_lo, dim, bsp, bnd_box, splitter, levels-1);
+	bnd_box.hi[cd] = hv;				// restore bounds
+
+	bnd_box.lo[cd] = cv;				// modify bounds for right subtree
+	hi = rkd_tree_lazy(pa, pidx + n_lo, n-n_lo, dim, bsp, bnd_box, splitter, levels-1);
+	bnd_box.lo[cd] = lv;				// restore bounds
+
+	return new ANNkd_split(cd, cv, lv, hv, lo, hi);
+}
@@ -0,0 +1,186 @@
+//----------------------------------------------------------------------
+// File:			kd_numa.cpp
+// Description:		NUMA-replicated kd-trees
+//----------------------------------------------------------------------
+// BANN History:
+// Revision 1.1
+//    Initial release: per-node replicas of the point store and tree
+// Revision 1.2
+//    Replicas kept by an index: copies on request, padded rows and
+//    served counts over their lifetime
+//----------------------------------------------------------------------
+
+#include <ANNx.h>						// all ANN includes
+
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#ifdef __linux__
+  #include <pthread.h>					// thread affinity
+  #include <sched.h>
+  #include <sys/stat.h>
+#endif
+
+//----------------------------------------------------------------------
+//	Node topology
+//		annNumaNodes() counts the nodes listed by the kernel.  The
+//		cpus of a node are read from its cpulist, which is a comma
+//		separated list of ranges (e.g. "0-3,8-11").
+//----------------------------------------------------------------------
+
+int annNumaNodes()
+{
+	int n = 0;
+#ifdef __linux__
+	char path[64];
+	struct stat st;
+	for (;;) {
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", n);
+		if (stat(path, &st) != 0) break;
+		n++;
+	}
+#endif
+	return n > 0 ? n : 1;
+}
+
+static void annPinToNode(				// pin calling thread to a node
+	int					node)			// node (ignored if negative)
+{
+#ifdef __linux__
+	if (node < 0) return;
+
+	char path[64];
+	snprintf(path, sizeof(path),
+			"/sys/devices/system/node/node%d/cpulist", node);
+	FILE *f = fopen(path, "r");
+	if (f == NULL) return;
+
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	int lo, hi;
+	while (fscanf(f, "%d", &lo) == 1) {	// read ranges lo[-hi]
+		hi = lo;
+		int c = fgetc(f);
+		if (c == '-') {
+			if (fscanf(f, "%d", &hi) != 1) break;
+			c = fgetc(f);
+		}
+		for (int i = lo; i <= hi && i < CPU_SETSIZE; i++)
+			CPU_SET(i, &cpus);
+		if (c != ',') break;
+	}
+	fclose(f);
+
+	if (CPU_COUNT(&cpus) > 0)
+		pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+}
+
+//----------------------------------------------------------------------
+//	Replica construction
+//		The replicas are built concurrently, one thread per node.  Each
+//		thread pins itself to its node before it allocates and fills
+//		the point store and builds the tree, so every page of the
+//		replica is first touched on that node.  A single replica is
+//		built directly over the caller's points unless copy is set.
+//----------------------------------------------------------------------
+
+static void annBuildReplica(
+	ANNpointArray		pa,				// source points
+	ANNidx				n,				// number of points
+	int					dd,				// dimension
+	int					bs,				// bucket size
+	ANNsplitRule		split,			// splitting method
+	int					node,			// node to build on
+	ANNbool				copy,			// copy the points?
+	ANNbool				pad,			// pad rows of the copy?
+	ANNpointArray		*pts,			// replica points (returned)
+	ANNkd_tree			**tree)			// replica tree (returned)
+{
+	annPinToNode(node);
+
+	ANNpointArray rp = pa;
+	if (copy) {
+		rp = annAllocPts(n, dd, pad);
+		for (ANNidx i = 0; i < n; i++) {
+			for (int j = 0; j < dd; j++) {
+				rp[i][j] = pa[i][j];
+			}
+		}
+	}
+	*pts = rp;
+	*tree = new ANNkd_tree(rp, n, dd, bs, split);
+}
+
+ANNkd_replicas::ANNkd_replicas(
+	ANNpointArray		pa,				// point array
+	ANNidx				n,				// number of points
+	int					dd,				// dimension
+	int					bs,				// bucket size
+	ANNsplitRule		split,			// splitting method
+	int					n_nodes,		// number of nodes (0 = detect)
+	ANNbool				copy,			// copy a single replica?
+	ANNbool				pad)			// pad rows of the copies?
+{
+	int n_phys = annNumaNodes();		// physical nodes
+
+	dim = dd;
+	n_pts = n;
+	n_repl = (n_nodes > 0 ? n_nodes : n_phys);
+	simulated = (ANNbool) (n_repl != n_phys);
+	copied = (ANNbool) (copy || n_repl > 1);
+
+	repl_pts = new ANNpointArray[n_repl];
+	repl_tree = new ANNkd_tree*[n_repl];
+	repl_node = new int[n_repl];
+	repl_served = new ANNidx[n_repl];
+
+	std::thread *builders = new std::thread[n_repl];
+	for (int r = 0; r < n_repl; r++) {
+		repl_node[r] = (r < n_phys && n_phys > 1 ? r : -1);
+		repl_served[r] = 0;
+		builders[r] = std::thread(annBuildReplica, pa, n, dd, bs, split,
+				repl_node[r], copied, pad,
+				&repl_pts[r], &repl_tree[r]);
+	}
+	for (int r = 0; r < n_repl; r++) {
+		builders[r].join();
+	}
+	delete [] builders;
+}
+
+ANNkd_replicas::~ANNkd_replicas()
+{
+	for (int r = 0; r < n_repl; r++) {
+		delete repl_tree[r];
+		if (copied)						// only copies are ours
+			annDeallocPts(repl_pts[r]);
+	}
+	delete [] repl_pts;
+	delete [] repl_tree;
+	delete [] repl_node;
+	delete [] repl_served;
+}
+
+//----------------------------------------------------------------------
+//	Worker binding
+//		bindWorker() is called by each search worker on entry.  It pins
+//		the worker to the node of its replica and returns the tree to
+//		search.  served() adds the worker's query count to the replica
+//		statistics once it is done.
+//----------------------------------------------------------------------
+
+static std::mutex		ANNreplLock;	// guards served counts
+
+ANNkd_tree* ANNkd_replicas::bindWorker(int worker)
+{
+	int r = replicaOf(worker);
+	annPinToNode(repl_node[r]);
+	return repl_tree[r];
+}
+
+void ANNkd_replicas::served(int r, ANNidx nq)
+{
+	std::lock_guard<std::mutex> guard(ANNreplLock);
+	repl_served[r] += nq;
+}
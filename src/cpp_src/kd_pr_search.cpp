@@ -72,13 +72,13 @@
 //		These are given below.
 //----------------------------------------------------------------------
 
-double			ANNprEps;				// the error bound
-int				ANNprDim;				// dimension of space
-ANNpoint		ANNprQ;					// query point
-double			ANNprMaxErr;			// max tolerable squared error
-ANNpointArray	ANNprPts;				// the points
-ANNpr_queue		*ANNprBoxPQ;			// priority queue for boxes
-ANNmin_k		*ANNprPointMK;			// set of k closest points
+thread_local double			ANNprEps;				// the error bound
+thread_local int				ANNprDim;				// dimension of space
+thread_local ANNpoint		ANNprQ;					// query point
+thread_local double			ANNprMaxErr;			// max tolerable squared error
+thread_local ANNpointArray	ANNprPts;				// the points
+thread_local ANNpr_queue		*ANNprBoxPQ;			// priority queue for boxes
+thread_local ANNmin_k		*ANNprPointMK;			// set of k closest points
 
 //----------------------------------------------------------------------
 //	annkPriSearch - priority search for k nearest neighbors
@@ -100,6 +100,7 @@ void ANNkd_tree::annkPriSearch(
 	ANNprQ = q;
 	ANNprPts = pts;
 	ANNptsVisited = 0;					// initialize count of points visited
+	annBudgetStart();					// start the search budget
 
 	ANNprPointMK = new ANNmin_k(k);		// create set for closest k points
 
@@ -119,6 +120,8 @@ void ANNkd_tree::annkPriSearch(
 		ANN_FLOP(2)						// increment floating ops
 		if (box_dist*ANNprMaxErr >= ANNprPointMK->max_key())
 			break;
+		if (ANNbudgetOn && annBudgetSpent())
+			break;						// stop with boxes left to visit
 
 		np->ann_pri_search(box_dist, div_component);	// search this subtree.
 	}
@@ -225,4 +228,5 @@ void ANNkd_leaf::ann_pri_search(ANNdist box_dist, divergence div_component)
 	ANN_LEAF(1)							// one more leaf node visited
 	ANN_PTS(n_pts)						// increment points visited
 	ANNptsVisited += n_pts;				// increment number of points visited
+	ANNleavesVisited++;
 }
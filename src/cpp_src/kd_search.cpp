@@ -82,14 +82,27 @@
 //----------------------------------------------------------------------
 //		To keep argument lists short, a number of global variables
 //		are maintained which are common to all the recursive calls.
-//		These are given below.
+//		These are given below.  They are thread_local, so that
+//		several threads may search the same tree at once.
 //----------------------------------------------------------------------
 
-int				ANNkdDim;				// dimension of space
-ANNpoint		ANNkdQ;					// query point
-double			ANNkdMaxErr;			// max tolerable squared error
-ANNpointArray	ANNkdPts;				// the points
-ANNmin_k		*ANNkdPointMK;			// set of k closest points
+thread_local int				ANNkdDim;				// dimension of space
+thread_local ANNpoint		ANNkdQ;					// query point
+thread_local double			ANNkdMaxErr;			// max tolerable squared error
+thread_local ANNpointArray	ANNkdPts;				// the points
+thread_local ANNmin_k		*ANNkdPointMK;			// set of k closest points
+thread_local ANNidxArray		ANNkdSeeds;				// points seeded, sorted
+thread_local int				ANNkdNSeeds;			// number of points seeded
+
+//----------------------------------------------------------------------
+//	annIsSeed - was point i compared before the traversal?
+//		Seeded points are skipped in the buckets, so that they are not
+//		inserted twice.  Only called for points that would be inserted.
+//----------------------------------------------------------------------
+static inline ANNbool annIsSeed(ANNidx i)
+{
+	return (ANNbool) std::binary_search(ANNkdSeeds, ANNkdSeeds + ANNkdNSeeds, i);
+}
 
 //----------------------------------------------------------------------
 //	annkSearch - search for the k nearest neighbors
@@ -101,22 +114,73 @@ void ANNkd_tree::annkSearch(
 	ANNidxArray			nn_idx,			// nearest neighbor indices (returned)
 	ANNdistArray		dd,				// the approximate nearest neighbor
 	double				eps)			// the error bound
+{									// a seeded search without seeds
+	annkSearchSeeded(div_component, q, k, NULL, 0, nn_idx, dd, eps);
+}
+
+//----------------------------------------------------------------------
+//	annkSearchSeeded - search for the k nearest neighbors, starting
+//		from candidates
+//		The candidate points are compared with the query first, so that
+//		the traversal starts with the k-th closest distance among them
+//		rather than with an infinite one, and prunes from the first
+//		leaf on.  Candidates that are not points of the tree (e.g. -1)
+//		or repeated are ignored.  With good candidates, such as the
+//		neighbours of a nearby query, few nodes are left to visit.  The
+//		result is that of annkSearch(), which is this search without
+//		candidates.  The candidates are kept sorted, so that the leaves
+//		skip them by binary search.
+//----------------------------------------------------------------------
+void ANNkd_tree::annkSearchSeeded(
+	divergence div_component,	// divergence component function
+	ANNpoint			q,				// the query point
+	int					k,				// number of near neighbors to return
+	ANNidxArray			seeds,			// candidate point indices
+	int					n_seeds,		// number of candidates
+	ANNidxArray			nn_idx,			// nearest neighbor indices (returned)
+	ANNdistArray		dd,				// the approximate nearest neighbor
+	double				eps)			// the error bound
 {
 
 	ANNkdDim = dim;						// copy arguments to static equivs
 	ANNkdQ = q;
 	ANNkdPts = pts;
 	ANNptsVisited = 0;					// initialize count of points visited
+	annBudgetStart();					// start the search budget
 
 	if (k > n_pts) {					// too many near neighbors?
 		annError("Requesting more near neighbors than data points", ANNabort);
 	}
 
-	//ANNkdMaxErr = ANN_POW(1.0 + eps);
 	ANNkdMaxErr = 1.0 + eps;
 	ANN_FLOP(2)							// increment floating op count
 
 	ANNkdPointMK = new ANNmin_k(k);		// create set for closest k points
+	std::vector<ANNidx> cand;			// distinct candidates in the tree
+	for (int s = 0; s < n_seeds; s++) {
+		if (seeds[s] >= 0 && seeds[s] < n_pts) cand.push_back(seeds[s]);
+	}
+	std::sort(cand.begin(), cand.end());
+	cand.erase(std::unique(cand.begin(), cand.end()), cand.end());
+	ANNkdSeeds = cand.data();
+	ANNkdNSeeds = (int) cand.size();
+	for (int s = 0; s < ANNkdNSeeds; s++) {	// compare the candidates; one
+		ANNidx i = ANNkdSeeds[s];		// left out is no closer than the
+										// k-th point
+
+		ANNdist min_dist = ANNkdPointMK->max_key();
+		ANNdist dist = 0;
+		int d;
+		for (d = 0; d < dim; d++) {
+			dist += div_component(q[d], pts[i][d]);
+			if (dist > min_dist) break;
+		}
+		if (d >= dim &&							// among the k best?
+		   (ANN_ALLOW_SELF_MATCH || dist!=0)) { // and no self-match problem
+			ANNkdPointMK->insert(dist, i);
+		}
+	}
+	ANN_PTS(ANNkdNSeeds)				// increment points visited
 										// search starting at the root
 	root->ann_search(annBoxDistance(q, bnd_box_lo, bnd_box_hi, dim, div_component), div_component);
 
@@ -124,6 +188,8 @@ void ANNkd_tree::annkSearch(
 		dd[i] = ANNkdPointMK->ith_smallest_key(i);
 		nn_idx[i] = ANNkdPointMK->ith_smallest_info(i);
 	}
+	ANNkdNSeeds = 0;
+	ANNkdSeeds = NULL;
 	delete ANNkdPointMK;				// deallocate closest point set
 }
 
@@ -134,6 +200,7 @@ void ANNkd_split::ann_search(ANNdist box_dist, divergence div_component)
 {
 										// check dist calc term condition
 	if (ANNmaxPtsVisited != 0 && ANNptsVisited > ANNmaxPtsVisited) return;
+	if (ANNbudgetOn && annBudgetSpent()) return;
 
 										// distance to cutting plane
 	ANNcoord cut_diff = ANNkdQ[cut_dim] - cut_val;
@@ -151,7 +218,8 @@ void ANNkd_split::ann_search(ANNdist box_dist, divergence div_component)
 		//const auto new_dist = box_dist + div_component(ANNkdQ[cut_dim], cd_bnds[ANN_LO]);
 		
 										// visit further child if close enough
-		if (box_dist * ANNkdMaxErr < ANNkdPointMK->max_key())
+		if (box_dist * ANNkdMaxErr < ANNkdPointMK->max_key() &&
+			!(ANNbudgetOn && annBudgetSpent()))
 			child[ANN_HI]->ann_search(new_dist, div_component);
 
 	}
@@ -168,7 +236,8 @@ void ANNkd_split::ann_search(ANNdist box_dist, divergence div_component)
 		//const auto new_dist = box_dist + div_component(ANNkdQ[cut_dim], cd_bnds[ANN_HI]);
 		
 										// visit further child if close enough
-		if (box_dist * ANNkdMaxErr < ANNkdPointMK->max_key())
+		if (box_dist * ANNkdMaxErr < ANNkdPointMK->max_key() &&
+			!(ANNbudgetOn && annBudgetSpent()))
 			child[ANN_LO]->ann_search(new_dist, div_component);
 
 	}
@@ -216,7 +285,8 @@ void ANNkd_leaf::ann_search(ANNdist box_dist, divergence div_component)
 		}
 
 		if (d >= ANNkdDim &&					// among the k best?
-		   (ANN_ALLOW_SELF_MATCH || dist!=0)) { // and no self-match problem
+		   (ANN_ALLOW_SELF_MATCH || dist!=0) && // and no self-match problem
+		   (ANNkdNSeeds == 0 || !annIsSeed(bkt[i]))) { // and not seeded
 												// add it to the list
 			ANNkdPointMK->insert(dist, bkt[i]);
 			min_dist = ANNkdPointMK->max_key();
@@ -225,4 +295,5 @@ void ANNkd_leaf::ann_search(ANNdist box_dist, divergence div_component)
 	ANN_LEAF(1)							// one more leaf node visited
 	ANN_PTS(n_pts)						// increment points visited
 	ANNptsVisited += n_pts;				// increment number of points visited
+	ANNleavesVisited++;
 }
@@ -38,11 +38,13 @@
 //		among the various search procedures.
 //----------------------------------------------------------------------
 
-extern int				ANNkdDim;		// dimension of space (static copy)
-extern ANNpoint			ANNkdQ;			// query point (static copy)
-extern double			ANNkdMaxErr;	// max tolerable squared error
-extern ANNpointArray	ANNkdPts;		// the points (static copy)
-extern ANNmin_k			*ANNkdPointMK;	// set of k closest points
-extern int				ANNptsVisited;	// number of points visited
+extern thread_local int				ANNkdDim;		// dimension of space (static copy)
+extern thread_local ANNpoint			ANNkdQ;			// query point (static copy)
+extern thread_local double			ANNkdMaxErr;	// max tolerable squared error
+extern thread_local ANNpointArray	ANNkdPts;		// the points (static copy)
+extern thread_local ANNmin_k			*ANNkdPointMK;	// set of k closest points
+extern thread_local ANNidxArray		ANNkdSeeds;		// points seeded
+extern thread_local int				ANNkdNSeeds;	// number of points seeded
+extern thread_local ANNidx			ANNptsVisited;	// number of points visited
 
 #endif
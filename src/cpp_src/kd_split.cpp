@@ -45,11 +45,11 @@ void kd_split(
 	ANNpointArray		pa,				// point array (permuted on return)
 	ANNidxArray			pidx,			// point indices
 	const ANNorthRect	&bnds,			// bounding rectangle for cell
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	int					&cut_dim,		// cutting dimension (returned)
 	ANNcoord			&cut_val,		// cutting value (returned)
-	int					&n_lo)			// num of points on low side (returned)
+	ANNidx				&n_lo)			// num of points on low side (returned)
 {
 										// find dimension of maximum spread
 	cut_dim = annMaxSpread(pa, pidx, n, dim);
@@ -77,11 +77,11 @@ void midpt_split(
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices (permuted on return)
 	const ANNorthRect	&bnds,			// bounding rectangle for cell
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	int					&cut_dim,		// cutting dimension (returned)
 	ANNcoord			&cut_val,		// cutting value (returned)
-	int					&n_lo)			// num of points on low side (returned)
+	ANNidx				&n_lo)			// num of points on low side (returned)
 {
 	int d;
 
@@ -107,7 +107,7 @@ void midpt_split(
 										// split along cut_dim at midpoint
 	cut_val = (bnds.lo[cut_dim] + bnds.hi[cut_dim]) / 2;
 										// permute points accordingly
-	int br1, br2;
+	ANNidx br1, br2;
 	annPlaneSplit(pa, pidx, n, cut_dim, cut_val, br1, br2);
 	//------------------------------------------------------------------
 	//	On return:		pa[0..br1-1] < cut_val
@@ -147,11 +147,11 @@ void sl_midpt_split(
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices (permuted on return)
 	const ANNorthRect	&bnds,			// bounding rectangle for cell
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	int					&cut_dim,		// cutting dimension (returned)
 	ANNcoord			&cut_val,		// cutting value (returned)
-	int					&n_lo)			// num of points on low side (returned)
+	ANNidx				&n_lo)			// num of points on low side (returned)
 {
 	int d;
 
@@ -188,7 +188,7 @@ void sl_midpt_split(
 		cut_val = ideal_cut_val;
 
 										// permute points accordingly
-	int br1, br2;
+	ANNidx br1, br2;
 	annPlaneSplit(pa, pidx, n, cut_dim, cut_val, br1, br2);
 	//------------------------------------------------------------------
 	//	On return:		pa[0..br1-1] < cut_val
@@ -244,11 +244,11 @@ void fair_split(
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices (permuted on return)
 	const ANNorthRect	&bnds,			// bounding rectangle for cell
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	int					&cut_dim,		// cutting dimension (returned)
 	ANNcoord			&cut_val,		// cutting value (returned)
-	int					&n_lo)			// num of points on low side (returned)
+	ANNidx				&n_lo)			// num of points on low side (returned)
 {
 	int d;
 	ANNcoord max_length = bnds.hi[0] - bnds.lo[0];
@@ -288,7 +288,7 @@ void fair_split(
 	ANNcoord lo_cut = bnds.lo[cut_dim] + small_piece;// lowest legal cut
 	ANNcoord hi_cut = bnds.hi[cut_dim] - small_piece;// highest legal cut
 
-	int br1, br2;
+	ANNidx br1, br2;
 										// is median below lo_cut ?
 	if (annSplitBalance(pa, pidx, n, cut_dim, lo_cut) >= 0) {
 		cut_val = lo_cut;				// cut at lo_cut
@@ -347,15 +347,15 @@ void sl_fair_split(
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices (permuted on return)
 	const ANNorthRect	&bnds,			// bounding rectangle for cell
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	int					&cut_dim,		// cutting dimension (returned)
 	ANNcoord			&cut_val,		// cutting value (returned)
-	int					&n_lo)			// num of points on low side (returned)
+	ANNidx				&n_lo)			// num of points on low side (returned)
 {
 	int d;
 	ANNcoord min, max;					// min/max coordinates
-	int br1, br2;						// split break points
+	ANNidx br1, br2;					// split break points
 
 	ANNcoord max_length = bnds.hi[0] - bnds.lo[0];
 	cut_dim = 0;
@@ -426,3 +426,129 @@ void sl_fair_split(
 		annMedianSplit(pa, pidx, n, cut_dim, cut_val, n_lo);
 	}
 }
+
+//----------------------------------------------------------------------
+//	sqrt_midpt_split, log_midpt_split - sliding midpoint splitting in
+//		divergence-aware coordinates
+//
+//		The rules above measure cells in the coordinates of the points,
+//		which suits the squared Euclidean distance.  A Bregman
+//		divergence D_F is locally the squared distance in the metric of
+//		the Hessian of F, so a small step dx at x costs about
+//		F''(x) dx^2, and cells of equal side have very different
+//		divergence diameters on data spread over several orders of
+//		magnitude.  The sliding midpoint rule then leaves long cells
+//		where F'' is large, which the search cannot prune.
+//
+//		The coordinate u(x) with u'(x) = sqrt(F''(x)) makes the
+//		divergence locally Euclidean: for the Kullback-Leibler
+//		divergence, F(x) = x log x - x and u(x) = 2 sqrt(x), and for the
+//		Itakura-Saito divergence, F(x) = -log x and u(x) = log x.
+//		These rules apply the sliding midpoint rule to the cell mapped
+//		to u: the longest side there is bisected, so the two halves
+//		have about the same divergence diameter, with ties broken by
+//		the spread there, and the cut is mapped back.  u is increasing,
+//		so the cut is an ordinary cut of the cell and the tree is
+//		searched as any other.  (The gradient coordinates grad F, log x
+//		and -1/x, refine the small values too much.)  Cells reaching a
+//		nonpositive coordinate, where u is not defined, are split by
+//		sl_midpt_split().
+//----------------------------------------------------------------------
+
+static ANNcoord annSqrtCoord(ANNcoord x) { return sqrt(x); }
+static ANNcoord annSqrtInv(ANNcoord u) { return u * u; }
+static ANNcoord annLogCoord(ANNcoord x) { return log(x); }
+static ANNcoord annLogInv(ANNcoord u) { return exp(u); }
+
+static void mapped_midpt_split(
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pidx,			// point indices (permuted on return)
+	const ANNorthRect	&bnds,			// bounding rectangle for cell
+	ANNidx				n,				// number of points
+	int					dim,			// dimension of space
+	int					&cut_dim,		// cutting dimension (returned)
+	ANNcoord			&cut_val,		// cutting value (returned)
+	ANNidx				&n_lo,			// num of points on low side (returned)
+	ANNcoord			(*u)(ANNcoord),		// coordinate map
+	ANNcoord			(*u_inv)(ANNcoord))	// and its inverse
+{
+	int d;
+
+	for (d = 0; d < dim; d++) {			// map defined on the cell?
+		if (!(bnds.lo[d] > 0)) {
+			sl_midpt_split(pa, pidx, bnds, n, dim, cut_dim, cut_val, n_lo);
+			return;
+		}
+	}
+
+	ANNcoord max_length = u(bnds.hi[0]) - u(bnds.lo[0]);
+	for (d = 1; d < dim; d++) {			// find longest mapped side
+		ANNcoord length = u(bnds.hi[d]) - u(bnds.lo[d]);
+		if (length > max_length) {
+			max_length = length;
+		}
+	}
+	ANNcoord max_spread = -1;			// find long side with most spread
+	ANNcoord min, max;
+	for (d = 0; d < dim; d++) {
+										// is it among longest?
+		if (u(bnds.hi[d]) - u(bnds.lo[d]) >= (1-ERR)*max_length) {
+										// compute its mapped spread
+			annMinMax(pa, pidx, n, d, min, max);
+			ANNcoord spr = u(max) - u(min);
+			if (spr > max_spread) {		// is it max so far?
+				max_spread = spr;
+				cut_dim = d;
+			}
+		}
+	}
+										// ideal split at mapped midpoint
+	ANNcoord ideal_cut_val = u_inv((u(bnds.lo[cut_dim]) + u(bnds.hi[cut_dim]))/2);
+
+	annMinMax(pa, pidx, n, cut_dim, min, max);	// find min/max coordinates
+
+	if (ideal_cut_val < min)			// slide to min or max as needed
+		cut_val = min;
+	else if (ideal_cut_val > max)
+		cut_val = max;
+	else
+		cut_val = ideal_cut_val;
+
+										// permute points accordingly
+	ANNidx br1, br2;
+	annPlaneSplit(pa, pidx, n, cut_dim, cut_val, br1, br2);
+										// choose n_lo as sl_midpt_split()
+	if (ideal_cut_val < min) n_lo = 1;
+	else if (ideal_cut_val > max) n_lo = n-1;
+	else if (br1 > n/2) n_lo = br1;
+	else if (br2 < n/2) n_lo = br2;
+	else n_lo = n/2;
+}
+
+void sqrt_midpt_split(
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pidx,			// point indices (permuted on return)
+	const ANNorthRect	&bnds,			// bounding rectangle for cell
+	ANNidx				n,				// number of points
+	int					dim,			// dimension of space
+	int					&cut_dim,		// cutting dimension (returned)
+	ANNcoord			&cut_val,		// cutting value (returned)
+	ANNidx				&n_lo)			// num of points on low side (returned)
+{
+	mapped_midpt_split(pa, pidx, bnds, n, dim, cut_dim, cut_val, n_lo,
+		annSqrtCoord, annSqrtInv);
+}
+
+void log_midpt_split(
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pidx,			// point indices (permuted on return)
+	const ANNorthRect	&bnds,			// bounding rectangle for cell
+	ANNidx				n,				// number of points
+	int					dim,			// dimension of space
+	int					&cut_dim,		// cutting dimension (returned)
+	ANNcoord			&cut_val,		// cutting value (returned)
+	ANNidx				&n_lo)			// num of points on low side (returned)
+{
+	mapped_midpt_split(pa, pidx, bnds, n, dim, cut_dim, cut_val, n_lo,
+		annLogCoord, annLogInv);
+}
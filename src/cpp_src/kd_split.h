@@ -36,50 +36,70 @@ void kd_split(							// standard (optimized) kd-splitter
 	ANNpointArray		pa,				// point array (unaltered)
 	ANNidxArray			pidx,			// point indices (permuted on return)
 	const ANNorthRect	&bnds,			// bounding rectangle for cell
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	int					&cut_dim,		// cutting dimension (returned)
 	ANNcoord			&cut_val,		// cutting value (returned)
-	int					&n_lo);			// num of points on low side (returned)
+	ANNidx				&n_lo);			// num of points on low side (returned)
 
 void midpt_split(						// midpoint kd-splitter
 	ANNpointArray		pa,				// point array (unaltered)
 	ANNidxArray			pidx,			// point indices (permuted on return)
 	const ANNorthRect	&bnds,			// bounding rectangle for cell
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	int					&cut_dim,		// cutting dimension (returned)
 	ANNcoord			&cut_val,		// cutting value (returned)
-	int					&n_lo);			// num of points on low side (returned)
+	ANNidx				&n_lo);			// num of points on low side (returned)
 
 void sl_midpt_split(					// sliding midpoint kd-splitter
 	ANNpointArray		pa,				// point array (unaltered)
 	ANNidxArray			pidx,			// point indices (permuted on return)
 	const ANNorthRect	&bnds,			// bounding rectangle for cell
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	int					&cut_dim,		// cutting dimension (returned)
 	ANNcoord			&cut_val,		// cutting value (returned)
-	int					&n_lo);			// num of points on low side (returned)
+	ANNidx				&n_lo);			// num of points on low side (returned)
 
 void fair_split(						// fair-split kd-splitter
 	ANNpointArray		pa,				// point array (unaltered)
 	ANNidxArray			pidx,			// point indices (permuted on return)
 	const ANNorthRect	&bnds,			// bounding rectangle for cell
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	int					&cut_dim,		// cutting dimension (returned)
 	ANNcoord			&cut_val,		// cutting value (returned)
-	int					&n_lo);			// num of points on low side (returned)
+	ANNidx				&n_lo);			// num of points on low side (returned)
 
 void sl_fair_split(						// sliding fair-split kd-splitter
 	ANNpointArray		pa,				// point array (unaltered)
 	ANNidxArray			pidx,			// point indices (permuted on return)
 	const ANNorthRect	&bnds,			// bounding rectangle for cell
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	int					&cut_dim,		// cutting dimension (returned)
 	ANNcoord			&cut_val,		// cutting value (returned)
-	int					&n_lo);			// num of points on low side (returned)
+	ANNidx				&n_lo);			// num of points on low side (returned)
+
+void sqrt_midpt_split(					// sliding midpoint in sqrt coordinates
+	ANNpointArray		pa,				// point array (unaltered)
+	ANNidxArray			pidx,			// point indices (permuted on return)
+	const ANNorthRect	&bnds,			// bounding rectangle for cell
+	ANNidx				n,				// number of points
+	int					dim,			// dimension of space
+	int					&cut_dim,		// cutting dimension (returned)
+	ANNcoord			&cut_val,		// cutting value (returned)
+	ANNidx				&n_lo);			// num of points on low side (returned)
+
+void log_midpt_split(					// sliding midpoint in log coordinates
+	ANNpointArray		pa,				// point array (unaltered)
+	ANNidxArray			pidx,			// point indices (permuted on return)
+	const ANNorthRect	&bnds,			// bounding rectangle for cell
+	ANNidx				n,				// number of points
+	int					dim,			// dimension of space
+	int					&cut_dim,		// cutting dimension (returned)
+	ANNcoord			&cut_val,		// cutting value (returned)
+	ANNidx				&n_lo);			// num of points on low side (returned)
 
 #endif
@@ -0,0 +1,203 @@
+//----------------------------------------------------------------------
+// File:			kd_subspace.cpp
+// Description:		kd-trees cut along a subset of the coordinates
+//----------------------------------------------------------------------
+// BANN History:
+// Revision 1.1
+//    Initial release: sliding midpoint over chosen coordinates
+//----------------------------------------------------------------------
+
+#include "kd_tree.h"					// kd-tree declarations
+#include "kd_split.h"					// kd-tree splitting rules
+#include "kd_util.h"					// kd-tree utilities
+
+//----------------------------------------------------------------------
+//	Coordinate-subset kd-trees
+//		A search prunes a cell by the sum of the divergence components
+//		along the coordinates its path has cut.  With hundreds of
+//		coordinates a tree over a few million points cuts each of them
+//		once or not at all, as every cell is long in some other
+//		coordinate, and that sum stays far below the distance to the
+//		k-th neighbour: the search then visits nearly every leaf.
+//
+//		Every component of a decomposable divergence is nonnegative,
+//		so the sum over any subset of the coordinates is a lower bound
+//		on the whole.  This constructor cuts the cells along the given
+//		coordinates only, with the sliding midpoint rule restricted to
+//		them, so each is cut many times and the bound approaches the
+//		divergence within the subspace.  Where the points vary mostly
+//		within the subspace, that is most of the divergence.  Leaves
+//		still compare the query with their points along all the
+//		coordinates, so searches remain exact, or within 1+eps.  They
+//		do so in the order of the coordinates and stop once the sum
+//		exceeds the k-th closest distance, which happens soonest with
+//		the subset stored first; bann_index_build_subspace() stores
+//		the points so.
+//
+//		annRankDims() orders the coordinates for the choice of the
+//		subset, by the spread of the points or by the mean divergence
+//		component between sample pairs of points.
+//----------------------------------------------------------------------
+
+const ANNidx ANN_RANK_SAMPLE = 4096;	// pairs sampled to rank by divergence
+
+//----------------------------------------------------------------------
+//	annRankDims - order the coordinates by importance
+//		Stores in rank[0..dd-1] the coordinates in decreasing order of
+//		the spread of the points if div_component is empty, and of the
+//		mean of div_component over pairs of points otherwise.  Pairs
+//		are consecutive points of an evenly spaced sample.
+//----------------------------------------------------------------------
+
+void annRankDims(
+	ANNpointArray		pa,				// point array
+	ANNidx				n,				// number of points
+	int					dd,				// dimension
+	divergence			div_component,	// divergence, or empty for spread
+	int					*rank)			// coordinates (returned)
+{
+	std::vector<double> score(dd, 0.0);
+	if (!div_component) {
+		ANNidxArray pidx = new ANNidx[n];
+		for (ANNidx i = 0; i < n; i++) pidx[i] = i;
+		for (int d = 0; d < dd; d++) score[d] = annSpread(pa, pidx, n, d);
+		delete [] pidx;
+	}
+	else if (n > 1) {
+		ANNidx m = n - 1 < ANN_RANK_SAMPLE ? n - 1 : ANN_RANK_SAMPLE;
+		for (ANNidx j = 0; j < m; j++) {
+			ANNpoint p = pa[(j * (n-1)) / m];
+			ANNpoint q = pa[((j+1) * (n-1)) / m];
+			for (int d = 0; d < dd; d++) score[d] += div_component(q[d], p[d]);
+		}
+	}
+	for (int d = 0; d < dd; d++) rank[d] = d;
+	std::stable_sort(rank, rank + dd,
+		[&score](int a, int b) { return score[a] > score[b]; });
+}
+
+//----------------------------------------------------------------------
+//	sub_midpt_split - sliding midpoint split along chosen coordinates
+//		As sl_midpt_split(), with the cutting dimension one of
+//		dims[0..n_dims-1].
+//----------------------------------------------------------------------
+
+static void sub_midpt_split(
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pidx,			// point indices (permuted on return)
+	const ANNorthRect	&bnds,			// bounding rectangle for cell
+	ANNidx				n,				// number of points
+	const int			*dims,			// coordinates to cut
+	int					n_dims,			// number of them
+	int					&cut_dim,		// cutting dimension (returned)
+	ANNcoord			&cut_val,		// cutting value (returned)
+	ANNidx				&n_lo)			// num of points on low side (returned)
+{
+	ANNcoord max_length = -1;			// find length of longest box side
+	for (int j = 0; j < n_dims; j++) {
+		ANNcoord length = bnds.hi[dims[j]] - bnds.lo[dims[j]];
+		if (length > max_length) max_length = length;
+	}
+	ANNcoord max_spread = -1;			// find long side with most spread
+	cut_dim = dims[0];
+	for (int j = 0; j < n_dims; j++) {
+		int d = dims[j];
+		if ((bnds.hi[d] - bnds.lo[d]) >= (1-ERR)*max_length) {
+			ANNcoord spr = annSpread(pa, pidx, n, d);
+			if (spr > max_spread) {
+				max_spread = spr;
+				cut_dim = d;
+			}
+		}
+	}
+										// ideal split at midpoint
+	ANNcoord ideal_cut_val = (bnds.lo[cut_dim] + bnds.hi[cut_dim])/2;
+
+	ANNcoord min, max;
+	annMinMax(pa, pidx, n, cut_dim, min, max);	// find min/max coordinates
+
+	if (ideal_cut_val < min)			// slide to min or max as needed
+		cut_val = min;
+	else if (ideal_cut_val > max)
+		cut_val = max;
+	else
+		cut_val = ideal_cut_val;
+
+	ANNidx br1, br2;					// permute points accordingly
+	annPlaneSplit(pa, pidx, n, cut_dim, cut_val, br1, br2);
+
+	if (ideal_cut_val < min) n_lo = 1;	// as in sl_midpt_split()
+	else if (ideal_cut_val > max) n_lo = n-1;
+	else if (br1 > n/2) n_lo = br1;
+	else if (br2 < n/2) n_lo = br2;
+	else n_lo = n/2;
+}
+
+//----------------------------------------------------------------------
+//	rkd_tree_sub - recursive construction along chosen coordinates
+//----------------------------------------------------------------------
+
+static ANNkd_ptr rkd_tree_sub(
+	ANNpointArray		pa,				// point array
+	ANNidxArray			pidx,			// point indices to store in subtree
+	ANNidx				n,				// number of points
+	const int			*dims,			// coordinates to cut
+	int					n_dims,			// number of them
+	int					bsp,			// bucket space
+	ANNorthRect			&bnd_box)		// bounding box for current node
+{
+	if (n <= bsp) {						// n small, make a leaf node
+		if (n == 0)						// empty leaf node
+			return KD_TRIVIAL;			// return (canonical) empty leaf
+		else							// construct the node and return
+			return new ANNkd_leaf(n, pidx);
+	}
+
+	int cd;								// cutting dimension
+	ANNcoord cv;						// cutting value
+	ANNidx n_lo;						// number on low side of cut
+	ANNkd_node *lo, *hi;				// low and high children
+
+	sub_midpt_split(pa, pidx, bnd_box, n, dims, n_dims, cd, cv, n_lo);
+
+	ANNcoord lv = bnd_box.lo[cd];		// save bounds for cutting dimension
+	ANNcoord hv = bnd_box.hi[cd];
+
+	bnd_box.hi[cd] = cv;				// modify bounds for left subtree
+	lo = rkd_tree_sub(pa, pidx, n_lo, dims, n_dims, bsp, bnd_box);
+	bnd_box.hi[cd] = hv;				// restore bounds
+
+	bnd_box.lo[cd] = cv;				// modify bounds for right subtree
+	hi = rkd_tree_sub(pa, pidx + n_lo, n-n_lo, dims, n_dims, bsp, bnd_box);
+	bnd_box.lo[cd] = lv;				// restore bounds
+
+	return new ANNkd_split(cd, cv, lv, hv, lo, hi);
+}
+
+//----------------------------------------------------------------------
+//	kd-tree constructor along a subset of the coordinates
+//----------------------------------------------------------------------
+
+ANNkd_tree::ANNkd_tree(
+	ANNpointArray		pa,				// point array (with at least n pts)
+	ANNidx				n,				// number of points
+	int					dd,				// dimension
+	const int			*dims,			// coordinates to cut
+	int					n_dims,			// number of them
+	int					max_bkt)		// largest bucket size
+{
+	SkeletonTree(n, dd, max_bkt);		// set up the basic stuff
+	build_kind = ANN_BUILD_SUBSPACE;
+	pts = pa;							// where the points are
+	if (n == 0) return;					// no points--no sweat
+
+	ANNorthRect bnd_box(dd);			// bounding box for points
+	annEnclRect(pa, pidx, n, dd, bnd_box);// construct bounding rectangle
+	bnd_box_lo = annCopyPt(dd, bnd_box.lo);
+	bnd_box_hi = annCopyPt(dd, bnd_box.hi);
+
+	if (n_dims <= 0)					// no coordinates, one leaf
+		root = new ANNkd_leaf(n, pidx);
+	else
+		root = rkd_tree_sub(pa, pidx, n, dims, n_dims, max_bkt, bnd_box);
+}
@@ -33,6 +33,8 @@
 #include "kd_util.h"					// kd-tree utilities
 #include <ANNperf.h>				// performance evaluation
 
+#include <mutex>
+
 //----------------------------------------------------------------------
 //	Global data
 //
@@ -44,10 +46,12 @@
 //
 //	KD_TRIVIAL is allocated when the first kd-tree is created.  It
 //	must *never* deallocated (since it may be shared by more than
-//	one tree).
+//	one tree).  Trees may be built from several threads at once, so
+//	the allocation is guarded by KD_TRIVIAL_lock.
 //----------------------------------------------------------------------
-static int				IDX_TRIVIAL[] = {0};	// trivial point index
+static ANNidx			IDX_TRIVIAL[] = {0};	// trivial point index
 ANNkd_leaf				*KD_TRIVIAL = NULL;		// trivial leaf node
+static std::mutex		KD_TRIVIAL_lock;		// guards KD_TRIVIAL
 
 //----------------------------------------------------------------------
 //	Printing the kd-tree 
@@ -209,7 +213,7 @@ void ANNkd_tree::getStats(						// get tree statistics
 ANNkd_tree::~ANNkd_tree()				// tree destructor
 {
 	if (root != NULL) delete root;
-	if (pidx != NULL) delete [] pidx;
+	if (pidx != NULL) annDeallocAligned(pidx);
 	if (bnd_box_lo != NULL) annDeallocPt(bnd_box_lo);
 	if (bnd_box_hi != NULL) annDeallocPt(bnd_box_hi);
 }
@@ -220,6 +224,7 @@ ANNkd_tree::~ANNkd_tree()				// tree destructor
 //----------------------------------------------------------------------
 void annClose()				// close use of ANN
 {
+	std::lock_guard<std::mutex> guard(KD_TRIVIAL_lock);
 	if (KD_TRIVIAL != NULL) {
 		delete KD_TRIVIAL;
 		KD_TRIVIAL = NULL;
@@ -242,7 +247,7 @@ void annClose()				// close use of ANN
 //----------------------------------------------------------------------
 
 void ANNkd_tree::SkeletonTree(			// construct skeleton tree
-		int n,							// number of points
+		ANNidx n,						// number of points
 		int dd,							// dimension
 		int bs,							// bucket size
 		ANNpointArray pa,				// point array
@@ -256,8 +261,9 @@ void ANNkd_tree::SkeletonTree(			// construct skeleton tree
 	root = NULL;						// no associated tree yet
 
 	if (pi == NULL) {					// point indices provided?
-		pidx = new ANNidx[n];			// no, allocate space for point indices
-		for (int i = 0; i < n; i++) {
+										// no, allocate space for point indices
+		pidx = (ANNidxArray) annAllocAligned(n * sizeof(ANNidx));
+		for (ANNidx i = 0; i < n; i++) {
 			pidx[i] = i;				// initially identity
 		}
 	}
@@ -266,12 +272,15 @@ void ANNkd_tree::SkeletonTree(			// construct skeleton tree
 	}
 
 	bnd_box_lo = bnd_box_hi = NULL;		// bounding box is nonexistent
+	split_rule = -1;					// builders record how they built
+	build_kind = ANN_BUILD_UNKNOWN;
+	std::lock_guard<std::mutex> guard(KD_TRIVIAL_lock);
 	if (KD_TRIVIAL == NULL)				// no trivial leaf node yet?
 		KD_TRIVIAL = new ANNkd_leaf(0, IDX_TRIVIAL);	// allocate it
 }
 
 ANNkd_tree::ANNkd_tree(					// basic constructor
-		int n,							// number of points
+		ANNidx n,						// number of points
 		int dd,							// dimension
 		int bs)							// bucket size
 {  SkeletonTree(n, dd, bs);  }			// construct skeleton tree
@@ -314,7 +323,7 @@ ANNkd_tree::ANNkd_tree(					// basic constructor
 ANNkd_ptr rkd_tree(				// recursive construction of kd-tree
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices to store in subtree
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	int					bsp,			// bucket space
 	ANNorthRect			&bnd_box,		// bounding box for current node
@@ -329,7 +338,7 @@ ANNkd_ptr rkd_tree(				// recursive construction of kd-tree
 	else {								// n large, make a splitting node
 		int cd;							// cutting dimension
 		ANNcoord cv;					// cutting value
-		int n_lo;						// number on low side of cut
+		ANNidx n_lo;					// number on low side of cut
 		ANNkd_node *lo, *hi;			// low and high children
 
 										// invoke splitting procedure
@@ -367,12 +376,15 @@ ANNkd_ptr rkd_tree(				// recursive construction of kd-tree
 
 ANNkd_tree::ANNkd_tree(					// construct from point array
 	ANNpointArray		pa,				// point array (with at least n pts)
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dd,				// dimension
 	int					bs,				// bucket size
-	ANNsplitRule		split)			// splitting method
+	ANNsplitRule		split,			// splitting method
+	ANNbool				lazy)			// build subtrees when first searched
 {
 	SkeletonTree(n, dd, bs);			// set up the basic stuff
+	split_rule = split;
+	build_kind = ANN_BUILD_SPLIT;
 	pts = pa;							// where the points are
 	if (n == 0) return;					// no points--no sweat
 
@@ -382,24 +394,35 @@ ANNkd_tree::ANNkd_tree(					// construct from point array
 	bnd_box_lo = annCopyPt(dd, bnd_box.lo);
 	bnd_box_hi = annCopyPt(dd, bnd_box.hi);
 
+	ANNkd_splitter splitter = NULL;
 	switch (split) {					// build by rule
 	case ANN_KD_STD:					// standard kd-splitting rule
-		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, kd_split);
+		splitter = kd_split;
 		break;
 	case ANN_KD_MIDPT:					// midpoint split
-		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, midpt_split);
+		splitter = midpt_split;
 		break;
 	case ANN_KD_FAIR:					// fair split
-		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, fair_split);
+		splitter = fair_split;
 		break;
 	case ANN_KD_SUGGEST:				// best (in our opinion)
 	case ANN_KD_SL_MIDPT:				// sliding midpoint split
-		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, sl_midpt_split);
+		splitter = sl_midpt_split;
 		break;
 	case ANN_KD_SL_FAIR:				// sliding fair split
-		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, sl_fair_split);
+		splitter = sl_fair_split;
+		break;
+	case ANN_KD_SQRT_MIDPT:				// sliding midpoint in sqrt coordinates
+		splitter = sqrt_midpt_split;
+		break;
+	case ANN_KD_LOG_MIDPT:				// sliding midpoint in log coordinates
+		splitter = log_midpt_split;
 		break;
 	default:
 		annError("Illegal splitting method", ANNabort);
 	}
+	if (lazy)							// left to the first search
+		root = rkd_tree_lazy(pa, pidx, n, dd, bs, bnd_box, splitter, 0);
+	else
+		root = rkd_tree(pa, pidx, n, dd, bs, bnd_box, splitter);
 }
@@ -31,6 +31,36 @@
 
 using namespace std;					// make std:: available
 
+//----------------------------------------------------------------------
+//	Node record of a binary kd-tree file
+//		Nodes are stored in preorder, so the low child of a splitting
+//		node is the next record, and link gives the record of its high
+//		child.  The bucket of a leaf is given by its offset (link) in
+//		the point indices, or -1 for the trivial leaf.
+//----------------------------------------------------------------------
+
+enum {ANN_BIN_LEAF = 0, ANN_BIN_SPLIT = 1, ANN_BIN_SHRINK = 2};
+
+struct ANNbinNode {						// node record
+	int					kind;			// leaf, split or shrink
+	int					n;				// no. of points or cutting dim
+	long long			link;			// bucket offset or high child
+	ANNcoord			cut_val;		// cutting value
+	ANNcoord			cd_bnds[2];		// bounds along cutting dim
+};
+
+//----------------------------------------------------------------------
+//	Path key of a point
+//		The leaf a point falls into is identified by the branches taken
+//		on the way down from the root: bit 63-l of the key is set if the
+//		point goes to the high (or outer) child at depth l.  Sorting by
+//		key orders points by the preorder of their leaves, so that points
+//		of the same and of nearby leaves become consecutive.  Branches
+//		below depth 63 are not recorded.
+//----------------------------------------------------------------------
+
+typedef unsigned long long ANNleafKey;
+
 //----------------------------------------------------------------------
 //	Generic kd-tree node
 //
@@ -47,10 +77,18 @@ class ANNkd_node{						// generic kd-tree node (empty shell)
 public:
 	virtual ~ANNkd_node() {}					// virtual distroyer
 
+												// nodes start on a cache line
+	static void* operator new(size_t sz) { return annAllocNode(sz); }
+	static void operator delete(void* p, size_t sz) { annDeallocNode(p, sz); }
+
    virtual void ann_search(ANNdist, divergence) = 0;			// tree search
 	virtual void ann_haus(ANNdist, divergence, double) = 0;
 	virtual void ann_pri_search(ANNdist, divergence) = 0;	// priority search
-	virtual void ann_FR_search(ANNdist) = 0;	// fixed-radius search
+	virtual void ann_FR_search(ANNdist, divergence) = 0;	// fixed-radius search
+	virtual void ann_block_search(int, int, divergence) = 0; // block search
+	virtual ANNidx ann_FR_count(ANNdist, ANNdist, divergence) = 0; // range count
+	virtual ANNleafKey locate(ANNpoint, int) = 0;	// path key of a point
+	virtual ANNidx count() = 0;					// points in subtree
 
 	virtual void getStats(						// get tree statistics
 				int dim,						// dimension of space
@@ -59,6 +97,10 @@ public:
 												// print node
 	virtual void print(int level, ostream &out) = 0;
 	virtual void dump(ostream &out) = 0;		// dump node
+	virtual void flatten(						// write binary records
+					ANNbinNode *rec,			// records (modified)
+					long long &next,			// next free record
+					ANNidxArray pidx) = 0;		// base of point indices
 
 	friend class ANNkd_tree;					// allow kd-tree to access us
 };
@@ -74,11 +116,11 @@ typedef void (*ANNkd_splitter)(			// splitting routine for kd-trees
 	ANNpointArray		pa,				// point array (unaltered)
 	ANNidxArray			pidx,			// point indices (permuted on return)
 	const ANNorthRect	&bnds,			// bounding rectangle for cell
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	int					&cut_dim,		// cutting dimension (returned)
 	ANNcoord			&cut_val,		// cutting value (returned)
-	int					&n_lo);			// num of points on low side (returned)
+	ANNidx				&n_lo);			// num of points on low side (returned)
 
 //----------------------------------------------------------------------
 //	Leaf kd-tree node
@@ -110,11 +152,17 @@ public:
 				ANNorthRect &bnd_box);			// bounding box
 	virtual void print(int level, ostream &out);// print node
 	virtual void dump(ostream &out);			// dump node
+	virtual void flatten(ANNbinNode *rec, long long &next, ANNidxArray pidx);
 
 	virtual void ann_search(ANNdist, divergence); 		// standard search
 	virtual void ann_haus(ANNdist, divergence, double);        // Hausdorff search
 	virtual void ann_pri_search(ANNdist, divergence);		// priority search
-	virtual void ann_FR_search(ANNdist);		// fixed-radius search
+	virtual void ann_FR_search(ANNdist, divergence);	// fixed-radius search
+	virtual void ann_block_search(int, int, divergence);	// block search
+	virtual ANNidx ann_FR_count(ANNdist, ANNdist, divergence); // range count
+	virtual ANNleafKey locate(ANNpoint, int);	// path key of a point
+	virtual ANNidx count()						// points in subtree
+		{ return n_pts; }
 };
 
 //----------------------------------------------------------------------
@@ -138,7 +186,9 @@ extern ANNkd_leaf *KD_TRIVIAL;					// trivial (empty) leaf node
 //		cutting dimension is maintained (this is used to speed up point
 //		to box distance calculations) [we do not store the entire bounding
 //		box since this may be wasteful of space in high dimensions].
-//		We also store pointers to the 2 children.
+//		We also store pointers to the 2 children, and the number of
+//		points below the node, so that a subtree lying inside a range
+//		is counted without visiting it (annRangeCount()).
 //----------------------------------------------------------------------
 
 class ANNkd_split : public ANNkd_node	// splitting node of a kd-tree
@@ -148,6 +198,7 @@ class ANNkd_split : public ANNkd_node	// splitting node of a kd-tree
 	ANNcoord			cd_bnds[2];		// lower and upper bounds of
 										// rectangle along cut_dim
 	ANNkd_ptr			child[2];		// left and right children
+	ANNidx				n_sub;			// number of points in subtree
 public:
 	ANNkd_split(						// constructor
 		int cd,							// cutting dimension
@@ -161,6 +212,7 @@ public:
 			cd_bnds[ANN_HI] = hv;				// upper bound for rectangle
 			child[ANN_LO]	= lc;				// left child
 			child[ANN_HI]	= hc;				// right child
+			n_sub = (lc != NULL ? lc->count() : 0) + (hc != NULL ? hc->count() : 0);
 		}
 
 	~ANNkd_split()						// destructor
@@ -177,11 +229,84 @@ public:
 				ANNorthRect &bnd_box);			// bounding box
 	virtual void print(int level, ostream &out);// print node
 	virtual void dump(ostream &out);			// dump node
+	virtual void flatten(ANNbinNode *rec, long long &next, ANNidxArray pidx);
 
 	virtual void ann_search(ANNdist, divergence);			// standard search
 	virtual void ann_haus(ANNdist, divergence, double);
 	virtual void ann_pri_search(ANNdist, divergence);		// priority search
-	virtual void ann_FR_search(ANNdist);		// fixed-radius search
+	virtual void ann_FR_search(ANNdist, divergence);	// fixed-radius search
+	virtual void ann_block_search(int, int, divergence);	// block search
+	virtual ANNidx ann_FR_count(ANNdist, ANNdist, divergence); // range count
+	virtual ANNleafKey locate(ANNpoint, int);	// path key of a point
+	virtual ANNidx count()						// points in subtree
+		{ return n_sub; }
+};
+
+//----------------------------------------------------------------------
+//	Lazy kd-tree node
+//		A subtree of a lazily built tree that has not been built yet:
+//		the range of point indices below it and its cell.  The first
+//		operation that reaches the node builds the next few levels of
+//		the subtree, with lazy nodes below them, and every operation is
+//		passed on to what was built.  Building is guarded by a lock, so
+//		that searches may run in parallel.  See kd_lazy.cpp.
+//----------------------------------------------------------------------
+
+class ANNkd_lazy : public ANNkd_node	// unbuilt subtree of a kd-tree
+{
+	ANNpointArray		pa;				// the points
+	ANNidxArray			pidx;			// point indices of the subtree
+	ANNidx				n_pts;			// number of points
+	int					dim;			// dimension of space
+	int					bsp;			// bucket size
+	ANNkd_splitter		splitter;		// splitting routine
+	ANNorthRect			*bnd_box;		// cell (until built)
+	std::atomic<ANNkd_ptr> node;		// the subtree once built
+	std::mutex			lock;			// guards building
+
+	ANNkd_ptr build();					// build the subtree
+	ANNkd_ptr get()						// the subtree, built if needed
+		{
+			ANNkd_ptr p = node.load(std::memory_order_acquire);
+			return p != NULL ? p : build();
+		}
+public:
+	ANNkd_lazy(							// constructor
+		ANNpointArray pa,				// the points
+		ANNidxArray pidx,				// point indices of the subtree
+		ANNidx n,						// number of points
+		int dim,						// dimension of space
+		int bsp,						// bucket size
+		const ANNorthRect &bnd_box,		// cell
+		ANNkd_splitter splitter);		// splitting routine
+
+	~ANNkd_lazy();						// destructor
+
+	virtual void getStats(int dim, ANNkdStats &st, ANNorthRect &bnd_box)
+		{ get()->getStats(dim, st, bnd_box); }
+	virtual void print(int level, ostream &out)
+		{ get()->print(level, out); }
+	virtual void dump(ostream &out)
+		{ get()->dump(out); }
+	virtual void flatten(ANNbinNode *rec, long long &next, ANNidxArray pidx)
+		{ get()->flatten(rec, next, pidx); }
+
+	virtual void ann_search(ANNdist box_dist, divergence div)
+		{ get()->ann_search(box_dist, div); }
+	virtual void ann_haus(ANNdist box_dist, divergence div, double haus)
+		{ get()->ann_haus(box_dist, div, haus); }
+	virtual void ann_pri_search(ANNdist box_dist, divergence div)
+		{ get()->ann_pri_search(box_dist, div); }
+	virtual void ann_FR_search(ANNdist box_dist, divergence div)
+		{ get()->ann_FR_search(box_dist, div); }
+	virtual void ann_block_search(int lev, int n_act, divergence div)
+		{ get()->ann_block_search(lev, n_act, div); }
+	virtual ANNidx ann_FR_count(ANNdist lower, ANNdist upper, divergence div)
+		{ return get()->ann_FR_count(lower, upper, div); }
+	virtual ANNleafKey locate(ANNpoint q, int level)
+		{ return get()->locate(q, level); }
+	virtual ANNidx count()				// known without building
+		{ return n_pts; }
 };
 
 //----------------------------------------------------------------------
@@ -191,10 +316,20 @@ public:
 ANNkd_ptr rkd_tree(				// recursive construction of kd-tree
 	ANNpointArray		pa,				// point array (unaltered)
 	ANNidxArray			pidx,			// point indices to store in subtree
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	int					bsp,			// bucket space
 	ANNorthRect			&bnd_box,		// bounding box for current node
 	ANNkd_splitter		splitter);		// splitting routine
 
+ANNkd_ptr rkd_tree_lazy(				// top levels of a kd-tree
+	ANNpointArray		pa,				// point array (unaltered)
+	ANNidxArray			pidx,			// point indices to store in subtree
+	ANNidx				n,				// number of points
+	int					dim,			// dimension of space
+	int					bsp,			// bucket space
+	ANNorthRect			&bnd_box,		// bounding box for current node
+	ANNkd_splitter		splitter,		// splitting routine
+	int					levels);		// levels to build, lazy below
+
 #endif
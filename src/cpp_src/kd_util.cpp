@@ -73,14 +73,14 @@ double annAspectRatio(
 void annEnclRect(
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension
 	ANNorthRect			&bnds)			// bounding cube (returned)
 {
 	for (int d = 0; d < dim; d++) {		// find smallest enclosing rectangle
 		ANNcoord lo_bnd = PA(0,d);		// lower bound on dimension d
 		ANNcoord hi_bnd = PA(0,d);		// upper bound on dimension d
-		for (int i = 0; i < n; i++) {
+		for (ANNidx i = 0; i < n; i++) {
 			if (PA(i,d) < lo_bnd) lo_bnd = PA(i,d);
 			else if (PA(i,d) > hi_bnd) hi_bnd = PA(i,d);
 		}
@@ -92,7 +92,7 @@ void annEnclRect(
 void annEnclCube(						// compute smallest enclosing cube
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension
 	ANNorthRect			&bnds)			// bounding cube (returned)
 {
@@ -158,12 +158,12 @@ ANNdist annBoxDistance(					// compute distance from point to box
 ANNcoord annSpread(				// compute point spread along dimension
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					d)				// dimension to check
 {
 	ANNcoord min = PA(0,d);				// compute max and min coords
 	ANNcoord max = PA(0,d);
-	for (int i = 1; i < n; i++) {
+	for (ANNidx i = 1; i < n; i++) {
 		ANNcoord c = PA(i,d);
 		if (c < min) min = c;
 		else if (c > max) max = c;
@@ -174,14 +174,14 @@ ANNcoord annSpread(				// compute point spread along dimension
 void annMinMax(					// compute min and max coordinates along dim
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					d,				// dimension to check
 	ANNcoord			&min,			// minimum value (returned)
 	ANNcoord			&max)			// maximum value (returned)
 {
 	min = PA(0,d);						// compute max and min coords
 	max = PA(0,d);
-	for (int i = 1; i < n; i++) {
+	for (ANNidx i = 1; i < n; i++) {
 		ANNcoord c = PA(i,d);
 		if (c < min) min = c;
 		else if (c > max) max = c;
@@ -191,7 +191,7 @@ void annMinMax(					// compute min and max coordinates along dim
 int annMaxSpread(						// compute dimension of max spread
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim)			// dimension of space
 {
 	int max_dim = 0;					// dimension of max spread
@@ -229,23 +229,23 @@ int annMaxSpread(						// compute dimension of max spread
 //----------------------------------------------------------------------
 
 										// swap two points in pa array
-#define PASWAP(a,b) { int tmp = pidx[a]; pidx[a] = pidx[b]; pidx[b] = tmp; }
+#define PASWAP(a,b) { ANNidx tmp = pidx[a]; pidx[a] = pidx[b]; pidx[b] = tmp; }
 
 void annMedianSplit(
 	ANNpointArray		pa,				// points to split
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					d,				// dimension along which to split
 	ANNcoord			&cv,			// cutting value
-	int					n_lo)			// split into n_lo and n-n_lo
+	ANNidx				n_lo)			// split into n_lo and n-n_lo
 {
-	int l = 0;							// left end of current subarray
-	int r = n-1;						// right end of current subarray
+	ANNidx l = 0;						// left end of current subarray
+	ANNidx r = n-1;						// right end of current subarray
 	while (l < r) {
 		// register int i = (r+l)/2;		// select middle as pivot
 		// register int k;
-		int i = (r + l) / 2;			// select middle as pivot
-		int k;
+		ANNidx i = (r + l) / 2;			// select middle as pivot
+		ANNidx k;
 
 		if (PA(i,d) > PA(r,d))			// make sure last > pivot
 			PASWAP(i,r)
@@ -267,8 +267,8 @@ void annMedianSplit(
 	}
 	if (n_lo > 0) {						// search for next smaller item
 		ANNcoord c = PA(0,d);			// candidate for max
-		int k = 0;						// candidate's index
-		for (int i = 1; i < n_lo; i++) {
+		ANNidx k = 0;					// candidate's index
+		for (ANNidx i = 1; i < n_lo; i++) {
 			if (PA(i,d) > c) {
 				c = PA(i,d);
 				k = i;
@@ -297,14 +297,14 @@ void annMedianSplit(
 void annPlaneSplit(				// split points by a plane
 	ANNpointArray		pa,				// points to split
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					d,				// dimension along which to split
 	ANNcoord			cv,				// cutting value
-	int					&br1,			// first break (values < cv)
-	int					&br2)			// second break (values == cv)
+	ANNidx				&br1,			// first break (values < cv)
+	ANNidx				&br2)			// second break (values == cv)
 {
-	int l = 0;
-	int r = n-1;
+	ANNidx l = 0;
+	ANNidx r = n-1;
 	for(;;) {							// partition pa[0..n-1] about cv
 		while (l < n && PA(l,d) < cv) l++;
 		while (r >= 0 && PA(r,d) >= cv) r--;
@@ -338,13 +338,13 @@ void annPlaneSplit(				// split points by a plane
 void annBoxSplit(				// split points by a box
 	ANNpointArray		pa,				// points to split
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	ANNorthRect			&box,			// the box
-	int					&n_in)			// number of points inside (returned)
+	ANNidx				&n_in)			// number of points inside (returned)
 {
-	int l = 0;
-	int r = n-1;
+	ANNidx l = 0;
+	ANNidx r = n-1;
 	for(;;) {							// partition pa[0..n-1] about box
 		while (l < n && box.inside(dim, PP(l))) l++;
 		while (r >= 0 && !box.inside(dim, PP(r))) r--;
@@ -363,15 +363,15 @@ void annBoxSplit(				// split points by a box
 //		right of this is positive.  (The points are unchanged.)
 //----------------------------------------------------------------------
 
-int annSplitBalance(			// determine balance factor of a split
+ANNidx annSplitBalance(			// determine balance factor of a split
 	ANNpointArray		pa,				// points to split
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					d,				// dimension along which to split
 	ANNcoord			cv)				// cutting value
 {
-	int n_lo = 0;
-	for(int i = 0; i < n; i++) {		// count number less than cv
+	ANNidx n_lo = 0;
+	for(ANNidx i = 0; i < n; i++) {		// count number less than cv
 		if (PA(i,d) < cv) n_lo++;
 	}
 	return n_lo - n/2;
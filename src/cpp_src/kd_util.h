@@ -38,14 +38,14 @@ double annAspectRatio(			// compute aspect ratio of box
 void annEnclRect(				// compute smallest enclosing rectangle
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension
 	ANNorthRect &bnds);					// bounding cube (returned)
 
 void annEnclCube(				// compute smallest enclosing cube
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension
 	ANNorthRect &bnds);					// bounding cube (returned)
 
@@ -59,13 +59,13 @@ ANNdist annBoxDistance(			      // compute distance from point to box
 ANNcoord annSpread(				// compute point spread along dimension
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					d);				// dimension to check
 
 void annMinMax(					// compute min and max coordinates along dim
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					d,				// dimension to check
 	ANNcoord&			min,			// minimum value (returned)
 	ANNcoord&			max);			// maximum value (returned)
@@ -73,38 +73,38 @@ void annMinMax(					// compute min and max coordinates along dim
 int annMaxSpread(				// compute dimension of max spread
 	ANNpointArray		pa,				// point array
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim);			// dimension of space
 
 void annMedianSplit(			// split points along median value
 	ANNpointArray		pa,				// points to split
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					d,				// dimension along which to split
 	ANNcoord			&cv,			// cutting value
-	int					n_lo);			// split into n_lo and n-n_lo
+	ANNidx				n_lo);			// split into n_lo and n-n_lo
 
 void annPlaneSplit(				// split points by a plane
 	ANNpointArray		pa,				// points to split
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					d,				// dimension along which to split
 	ANNcoord			cv,				// cutting value
-	int					&br1,			// first break (values < cv)
-	int					&br2);			// second break (values == cv)
+	ANNidx				&br1,			// first break (values < cv)
+	ANNidx				&br2);			// second break (values == cv)
 
 void annBoxSplit(				// split points by a box
 	ANNpointArray		pa,				// points to split
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					dim,			// dimension of space
 	ANNorthRect			&box,			// the box
-	int					&n_in);			// number of points inside (returned)
+	ANNidx				&n_in);			// number of points inside (returned)
 
-int annSplitBalance(			// determine balance factor of a split
+ANNidx annSplitBalance(			// determine balance factor of a split
 	ANNpointArray		pa,				// points to split
 	ANNidxArray			pidx,			// point indices
-	int					n,				// number of points
+	ANNidx				n,				// number of points
 	int					d,				// dimension along which to split
 	ANNcoord			cv);			// cutting value
 
@@ -0,0 +1,264 @@
+//----------------------------------------------------------------------
+// File:			kd_workload.cpp
+// Description:		Construction of kd-trees for a query workload
+//----------------------------------------------------------------------
+// BANN History:
+// Revision 1.1
+//    Initial release: greedy cost model over a sample of queries
+//----------------------------------------------------------------------
+
+#include "kd_tree.h"					// kd-tree declarations
+#include "kd_split.h"					// kd-tree splitting rules
+#include "kd_util.h"					// kd-tree utilities
+#include "kd_fix_rad_search.h"			// cell bounds
+
+//----------------------------------------------------------------------
+//	Workload-aware construction
+//		The splitting rules choose every cut from the data alone, so a
+//		region that receives most of the queries is cut as finely as
+//		one that receives none.  Given a sample of queries, this
+//		constructor first finds the divergence r(q) from each sample
+//		query q to its k-th nearest neighbour, and then builds the tree
+//		top down, keeping at each node the sample queries whose ball
+//		{x : D(q, x) <= r(q)} meets the cell (annCellLower()).  Those
+//		are the queries whose search would visit the node.
+//
+//		The cost of making a node with n points a leaf is taken as
+//		T (ANN_WL_LEAF + dim n) for T such queries, in coordinate
+//		terms evaluated.  The cost of splitting it is T ANN_WL_SPLIT
+//		plus the cost of making both children leaves, in the manner of
+//		the surface area heuristic for ray tracing, with the sizes and
+//		query counts of the children computed exactly.  The cut is the
+//		cheapest among the sliding midpoint, the quartiles of the
+//		points and the median of the queries in each dimension, and the
+//		node becomes a leaf when no cut is cheaper than the leaf.  Hot
+//		regions are so cut down to small buckets, while cells that no
+//		sample query reaches are built with the sliding midpoint rule
+//		into buckets of up to max_bkt points, as are all leaves.
+//
+//		The tree is an ordinary kd-tree, searched, saved and loaded as
+//		any other; only the time taken by searches depends on the
+//		sample.
+//----------------------------------------------------------------------
+
+const double ANN_WL_SPLIT = 2.0;		// cost of visiting a splitting node
+const double ANN_WL_LEAF = 4.0;			// cost of visiting a leaf
+
+struct ANNwlState {						// state of a workload construction
+	ANNpointArray		pa;				// data points
+	ANNpointArray		qa;				// sample queries
+	ANNdist				*rad;			// divergence to k-th neighbour per query
+	int					dim;			// dimension of space
+	int					max_bkt;		// largest bucket
+	divergence			div;			// divergence component
+};
+
+//----------------------------------------------------------------------
+//	annWlLeafCost - cost of a leaf with n points reached by t queries
+//----------------------------------------------------------------------
+
+static inline double annWlLeafCost(const ANNwlState &st, ANNidx n, ANNidx t)
+{
+	return n == 0 ? 0.0 : t * (ANN_WL_LEAF + st.dim * (double) n);
+}
+
+//----------------------------------------------------------------------
+//	annWlLowCount - number of points to put on the low side of a cut
+//		As sl_midpt_split(): as close to n/2 as points equal to the
+//		cut allow, and never 0 or n.  cv must lie within the spread of
+//		the coordinates c[0..n-1] of the points.
+//----------------------------------------------------------------------
+
+static ANNidx annWlLowCount(const ANNcoord *c, ANNidx n, ANNcoord cv)
+{
+	ANNidx br1 = 0, br2 = 0;			// points < cv, and <= cv
+	for (ANNidx i = 0; i < n; i++) {
+		if (c[i] < cv) br1++;
+		if (c[i] <= cv) br2++;
+	}
+	ANNidx n_lo = n/2;
+	if (n_lo < br1) n_lo = br1;
+	if (n_lo > br2) n_lo = br2;
+	if (n_lo < 1) n_lo = 1;
+	if (n_lo > n-1) n_lo = n-1;
+	return n_lo;
+}
+
+//----------------------------------------------------------------------
+//	annWlReached - queries of a node whose balls meet a child cell
+//		lower holds the lower bounds of the queries on the cell of the
+//		node, which differs from the child [lo, hi] along cd only.
+//----------------------------------------------------------------------
+
+static ANNidx annWlReached(const ANNwlState &st, const std::vector<ANNidx> &qs,
+	const std::vector<ANNdist> &lower, const ANNorthRect &bnds, int cd,
+	ANNcoord lo, ANNcoord hi, std::vector<ANNidx> *q_out, std::vector<ANNdist> *l_out)
+{
+	ANNidx t = 0;
+	for (size_t i = 0; i < qs.size(); i++) {
+		ANNcoord q = st.qa[qs[i]][cd];
+		ANNdist l = lower[i]
+			- annCellLower(st.div, q, bnds.lo[cd], bnds.hi[cd])
+			+ annCellLower(st.div, q, lo, hi);
+		if (l <= st.rad[qs[i]]) {
+			t++;
+			if (q_out != NULL) {
+				q_out->push_back(qs[i]);
+				l_out->push_back(l);
+			}
+		}
+	}
+	return t;
+}
+
+//----------------------------------------------------------------------
+//	rkd_tree_wl - recursive construction for a workload
+//		qs holds the sample queries reaching the cell bnd_box, and
+//		lower their lower bounds on it.
+//----------------------------------------------------------------------
+
+static ANNkd_ptr rkd_tree_wl(
+	ANNwlState			&st,			// construction state
+	ANNidxArray			pidx,			// point indices to store in subtree
+	ANNidx				n,				// number of points
+	ANNorthRect			&bnd_box,		// bounding box for current node
+	const std::vector<ANNidx> &qs,		// queries reaching the node
+	const std::vector<ANNdist> &lower)	// their lower bounds
+{
+	if (n == 0)							// empty leaf node
+		return KD_TRIVIAL;
+	if (qs.empty())						// cold cell: build as usual
+		return rkd_tree(st.pa, pidx, n, st.dim, st.max_bkt, bnd_box, sl_midpt_split);
+	if (n == 1)
+		return new ANNkd_leaf(n, pidx);
+
+	ANNidx t = (ANNidx) qs.size();
+	double best = (n <= st.max_bkt ? annWlLeafCost(st, n, t) : ANN_DBL_MAX);
+	int cd = -1;						// best cut, none if a leaf
+	ANNcoord cv = 0;
+
+	std::vector<ANNcoord> c(n), c_q(t);	// coordinates along a dimension
+	for (int d = 0; d < st.dim; d++) {
+		for (ANNidx i = 0; i < n; i++) c[i] = st.pa[pidx[i]][d];
+		ANNcoord min = *std::min_element(c.begin(), c.end());
+		ANNcoord max = *std::max_element(c.begin(), c.end());
+		if (min == max) continue;		// cannot cut here
+
+		ANNcoord cand[5];				// candidate cuts
+		int n_cand = 0;
+		cand[n_cand++] = (bnd_box.lo[d] + bnd_box.hi[d]) / 2;
+		for (int j = 1; j <= 3; j++) {	// quartiles of the points
+			std::nth_element(c.begin(), c.begin() + (n*j)/4, c.end());
+			cand[n_cand++] = c[(n*j)/4];
+		}
+		for (ANNidx i = 0; i < t; i++) c_q[i] = st.qa[qs[i]][d];
+		std::nth_element(c_q.begin(), c_q.begin() + t/2, c_q.end());
+		cand[n_cand++] = c_q[t/2];		// median of the queries
+
+		for (int j = 0; j < n_cand; j++) {
+			ANNcoord v = cand[j];		// slide into the points
+			if (v < min) v = min;
+			if (v > max) v = max;
+			ANNidx n_lo = annWlLowCount(c.data(), n, v);
+			ANNidx t_lo = annWlReached(st, qs, lower, bnd_box, d, bnd_box.lo[d], v, NULL, NULL);
+			ANNidx t_hi = annWlReached(st, qs, lower, bnd_box, d, v, bnd_box.hi[d], NULL, NULL);
+			double cost = t * ANN_WL_SPLIT
+				+ annWlLeafCost(st, n_lo, t_lo) + annWlLeafCost(st, n - n_lo, t_hi);
+			if (cost < best) {
+				best = cost;
+				cd = d;
+				cv = v;
+			}
+		}
+	}
+	if (cd < 0) {						// a leaf is cheapest
+		if (n <= st.max_bkt)
+			return new ANNkd_leaf(n, pidx);
+		return rkd_tree(st.pa, pidx, n, st.dim, st.max_bkt, bnd_box, sl_midpt_split);
+	}
+
+	for (ANNidx i = 0; i < n; i++) c[i] = st.pa[pidx[i]][cd];
+	ANNidx n_lo = annWlLowCount(c.data(), n, cv);
+	ANNidx br1, br2;					// permute points accordingly
+	annPlaneSplit(st.pa, pidx, n, cd, cv, br1, br2);
+
+	ANNcoord lv = bnd_box.lo[cd];		// save bounds for cutting dimension
+	ANNcoord hv = bnd_box.hi[cd];
+	ANNkd_node *lo, *hi;				// low and high children
+	{
+		std::vector<ANNidx> q_lo;
+		std::vector<ANNdist> l_lo;
+		annWlReached(st, qs, lower, bnd_box, cd, lv, cv, &q_lo, &l_lo);
+		bnd_box.hi[cd] = cv;			// modify bounds for left subtree
+		lo = rkd_tree_wl(st, pidx, n_lo, bnd_box, q_lo, l_lo);
+		bnd_box.hi[cd] = hv;			// restore bounds
+	}
+	{
+		std::vector<ANNidx> q_hi;
+		std::vector<ANNdist> l_hi;
+		annWlReached(st, qs, lower, bnd_box, cd, cv, hv, &q_hi, &l_hi);
+		bnd_box.lo[cd] = cv;			// modify bounds for right subtree
+		hi = rkd_tree_wl(st, pidx + n_lo, n - n_lo, bnd_box, q_hi, l_hi);
+		bnd_box.lo[cd] = lv;			// restore bounds
+	}
+	return new ANNkd_split(cd, cv, lv, hv, lo, hi);
+}
+
+//----------------------------------------------------------------------
+//	kd-tree constructor for a workload
+//----------------------------------------------------------------------
+
+ANNkd_tree::ANNkd_tree(
+	ANNpointArray		pa,				// point array (with at least n pts)
+	ANNidx				n,				// number of points
+	int					dd,				// dimension
+	divergence			div_component,	// divergence of the searches
+	ANNpointArray		qa,				// sample of queries
+	ANNidx				nq,				// number of queries
+	int					k,				// number of near neighbors searched
+	int					max_bkt)		// largest bucket size
+{
+	SkeletonTree(n, dd, max_bkt);		// set up the basic stuff
+	build_kind = ANN_BUILD_WORKLOAD;
+	pts = pa;							// where the points are
+	if (n == 0) return;					// no points--no sweat
+
+	ANNorthRect bnd_box(dd);			// bounding box for points
+	annEnclRect(pa, pidx, n, dd, bnd_box);// construct bounding rectangle
+	bnd_box_lo = annCopyPt(dd, bnd_box.lo);
+	bnd_box_hi = annCopyPt(dd, bnd_box.hi);
+
+	ANNwlState st;
+	st.pa = pa;
+	st.qa = qa;
+	st.dim = dd;
+	st.max_bkt = max_bkt;
+	st.div = div_component;
+	st.rad = new ANNdist[nq > 0 ? nq : 1];
+	if (k > n) k = (int) n;
+
+	std::vector<ANNidx> qs;				// queries reaching the root
+	std::vector<ANNdist> lower;
+	{
+		ANNkd_tree sample_tree(pa, n, dd);	// neighbours of the sample
+		ANNidxArray nn_idx = new ANNidx[k];
+		ANNdistArray nn_dd = new ANNdist[k];
+		for (ANNidx i = 0; i < nq; i++) {
+			sample_tree.annkSearch(div_component, qa[i], k, nn_idx, nn_dd);
+			st.rad[i] = nn_dd[k-1];
+			ANNdist l = 0;
+			for (int d = 0; d < dd; d++) {
+				l += annCellLower(div_component, qa[i][d], bnd_box.lo[d], bnd_box.hi[d]);
+			}
+			if (l <= st.rad[i]) {
+				qs.push_back(i);
+				lower.push_back(l);
+			}
+		}
+		delete [] nn_idx;
+		delete [] nn_dd;
+	}
+
+	root = rkd_tree_wl(st, pidx, n, bnd_box, qs, lower);
+	delete [] st.rad;
+}
@@ -57,12 +57,12 @@ class ANNpr_queue {
 		PQkey			key;			// key value
 		PQinfo			info;			// info field
 	};
-	int			n;						// number of items in queue
-	int			max_size;				// maximum queue size
+	ANNidx		n;						// number of items in queue
+	ANNidx		max_size;				// maximum queue size
 	pq_node		*pq;					// the priority queue (array of nodes)
 
 public:
-	ANNpr_queue(int max)				// constructor (given max size)
+	ANNpr_queue(ANNidx max)				// constructor (given max size)
 		{
 			n = 0;						// initially empty
 			max_size = max;				// maximum number of items
@@ -87,10 +87,10 @@ public:
 		{
 			if (++n > max_size) annError("Priority queue overflow.", ANNabort);
 			// register int r = n;
-			int r = n;
+			ANNidx r = n;
 			while (r > 1) {				// sift up new item
 				// register int p = r/2;
-				int p = r / 2;
+				ANNidx p = r / 2;
 				ANN_FLOP(1)				// increment floating ops
 				if (pq[p].key <= kv)	// in proper order
 					break;
@@ -110,9 +110,9 @@ public:
 			// register PQkey kn = pq[n--].key;// last item in queue
 			PQkey kn = pq[n--].key;
 			// register int p = 1;			// p points to item out of position
-			int p = 1;
+			ANNidx p = 1;
 			// register int r = p<<1;		// left child of p
-			int r = p << 1;
+			ANNidx r = p << 1;
 			while (r <= n) {			// while r is still within the heap
 				ANN_FLOP(2)				// increment floating ops
 										// set r to smaller child of p
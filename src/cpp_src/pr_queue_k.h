@@ -32,7 +32,7 @@
 //	Basic types
 //----------------------------------------------------------------------
 typedef ANNdist			PQKkey;			// key field is distance
-typedef int				PQKinfo;		// info field is int
+typedef ANNidx			PQKinfo;		// info field is a point index
 
 //----------------------------------------------------------------------
 //	Constants
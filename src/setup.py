@@ -1,19 +1,83 @@
 from setuptools import setup, Extension, find_packages
-from Cython.Build import cythonize, build_ext
+from setuptools.command.build_ext import build_ext
+from Cython.Build import cythonize
+from Cython import __version__ as cython_version
 import numpy
-from os import path
+import subprocess
+from glob import glob
+from os import path, environ
 
 # here = path.abspath(path.dirname(__file__))
 # with open(path.join(here, 'README.md'), encoding='utf-8') as f:
 #     long_description = f.read()
 
+# Point indices are 32-bit unless BANN_IDX64 is set, which builds with 64-bit indices for
+# data sets of 2^31 or more points (at the cost of twice the memory for indices).
+define_macros = [('ANN_IDX64', None)] if environ.get('BANN_IDX64') else []
+
 bann_module = Extension(
    name="bann",
    sources=["bann.pyx", "ann_namespace.cpp"],
    include_dirs=[numpy.get_include(), "src/", "cpp_src/"],
+   define_macros=define_macros,
    language="c++"
 )
 
+# The C library of bann.h, built next to the extension from the same C++ core, for programs
+# that search without Python. It is linked into libbann.so (bann.dll on Windows).
+class build_ext_with_lib(build_ext):
+   def run(self):
+      super().run()
+      objects = self.compiler.compile(
+         ["bann_lib.cpp", "ann_namespace.cpp"],
+         output_dir = path.join(self.build_temp, "libbann"),
+         macros = define_macros,
+         include_dirs = [".", "cpp_src/"],
+         extra_postargs = ["-O3", "-std=c++17", "-fPIC"] if self.compiler.compiler_type == "unix" else [])
+      self.compiler.link_shared_object(
+         objects,
+         self.compiler.library_filename("bann", lib_type = "shared"),
+         output_dir = path.dirname(self.get_ext_fullpath("bann")),
+         extra_postargs = ["-pthread"] if self.compiler.compiler_type == "unix" else [],
+         target_lang = "c++")
+
+# The C++ tests of the core in ../tests, which check what Python cannot see, such as the layout
+# of point stores and tree nodes. Each test is built from the sources with the settings of the
+# extension and run; "python setup.py native_tests" fails if any of them fails.
+class native_tests(build_ext):
+   description = "build and run the C++ tests"
+
+   def build_extensions(self):
+      here = path.dirname(path.abspath(__file__))
+      sources = sorted(glob(path.join(here, "..", "tests", "*.cpp")))
+      if not sources:
+         raise SystemExit("No C++ tests found next to the sources.")
+      output_dir = path.join(self.build_temp, "native_tests")
+      failed = []
+      for source in sources:
+         name = path.splitext(path.basename(source))[0]
+         objects = self.compiler.compile(
+            [path.abspath(source)],
+            output_dir = output_dir,
+            macros = define_macros,
+            include_dirs = [here, path.join(here, "cpp_src")],
+            extra_postargs = ["-O2", "-std=c++17"] if self.compiler.compiler_type == "unix" else [])
+         self.compiler.link_executable(
+            objects, name,
+            output_dir = output_dir,
+            extra_postargs = ["-pthread"] if self.compiler.compiler_type == "unix" else [],
+            target_lang = "c++")
+         if subprocess.run([path.join(output_dir, self.compiler.executable_filename(name))]).returncode != 0:
+            failed.append(name)
+      if failed:
+         raise SystemExit("C++ tests failed: " + ", ".join(failed))
+
+# The extension releases the GIL around every C++ call and keeps no shared mutable state,
+# so it can be marked safe for free-threaded CPython (directive available from Cython 3.1).
+compiler_directives = {}
+if tuple(int(v) for v in cython_version.split('.')[:2]) >= (3, 1):
+   compiler_directives['freethreading_compatible'] = True
+
 setup(
    name = "bann",
    version = "0.0.1",
@@ -28,5 +92,6 @@ setup(
    packages = find_packages(),
    license = 'MIT',
    python_requires='>=3.11',
-   ext_modules = cythonize([bann_module])
+   ext_modules = cythonize([bann_module], compiler_directives = compiler_directives),
+   cmdclass = {'build_ext': build_ext_with_lib, 'native_tests': native_tests}
 )
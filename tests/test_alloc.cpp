@@ -0,0 +1,71 @@
+// Allocator checks, built from the sources and run by "python setup.py native_tests".
+// The layout of point stores and tree nodes is not visible from Python.
+#include "ann_namespace.cpp"
+#include <cstdint>
+
+using namespace ann_namespace;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok) {
+    std::cerr << "FAILED: " << what << "\n";
+    failures++;
+  }
+}
+
+int main()
+{
+  // Rows are dim coordinates apart unless padding is asked for
+  ANNpointArray pa = annAllocPts(100000, 3);
+  ANNpointArray pp = annAllocPts(1000, 3, ANNtrue);
+  check(pa[1] - pa[0] == 3, "unpadded rows are dim coordinates apart");
+  check(annRowStride(3) == 4 && pp[1] - pp[0] == annRowStride(3), "padded rows are annRowStride apart");
+  check(annRowStride(8) == 8 && annRowStride(9) == 16, "long rows are padded to whole lines");
+
+  // Large blocks start on a huge page, others on a cache line
+  check((uintptr_t) pa[0] % ANN_HUGE_PAGE == 0, "large point store is huge page aligned");
+  check((uintptr_t) pp[0] % ANN_CACHE_LINE == 0, "small point store is cache line aligned");
+
+  // Nodes are cut from shared huge page blocks, and freed nodes are reused
+  void *a = annAllocNode(24);
+  void *b = annAllocNode(40);
+  check((uintptr_t) a % ANN_CACHE_LINE == 0 && (uintptr_t) b % ANN_CACHE_LINE == 0,
+        "nodes start on a cache line");
+  check((uintptr_t) a / ANN_HUGE_PAGE == (uintptr_t) b / ANN_HUGE_PAGE,
+        "consecutive nodes share a block");
+  annDeallocNode(a, 24);
+  check(annAllocNode(64) == a, "a freed node is reused");
+  annDeallocNode(a, 64);
+  annDeallocNode(b, 40);
+  void *big = annAllocNode(1000);
+  check((uintptr_t) big % ANN_CACHE_LINE == 0, "large nodes start on a cache line");
+  annDeallocNode(big, 1000);
+
+  // Trees allocate and free their nodes through the same storage
+  for (ANNidx i = 0; i < 100000; i++) {
+    for (int d = 0; d < 3; d++) {
+      pa[i][d] = (i * 7919 + d * 104729) % 1000;
+    }
+  }
+  for (ANNidx i = 0; i < 1000; i++) {
+    for (int d = 0; d < 3; d++) {
+      pp[i][d] = (double) ((i * (d + 3) * 7919) % 100003) / 100003;
+    }
+  }
+  for (int round = 0; round < 2; round++) {
+    ANNkd_tree *tree = new ANNkd_tree(pa, 100000, 3);
+    ANNbd_tree *bd = new ANNbd_tree(pp, 1000, 3);
+    check(tree->nPoints() == 100000 && bd->nPoints() == 1000, "trees hold every point");
+    delete bd;
+    delete tree;
+  }
+
+  annDeallocPts(pa);
+  annDeallocPts(pp);
+  if (failures == 0) {
+    std::cout << "test_alloc: OK\n";
+  }
+  return failures == 0 ? 0 : 1;
+}
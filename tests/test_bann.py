@@ -1,6 +1,12 @@
 import unittest
 import bann
 import numpy as np
+import asyncio
+import os
+import subprocess
+import sys
+import tempfile
+from concurrent.futures import ThreadPoolExecutor
 
 """
 def k_search(
@@ -14,6 +20,21 @@ def bhaus(
     double EPS = 0, str div = 'kl') -> double:
 """
 
+def brute_divergences(query, data, div):
+    """
+    Divergences D(query, data) from every query point to every data point, summed over the
+    coordinates, as an array of shape (len(query), len(data)).
+    """
+    q, p = query[:, None, :], data[None, :, :]
+    components = {
+        'se': lambda: (q - p)**2,
+        'kl': lambda: q * np.log(q / p) - q + p,
+        'dkl': lambda: p * np.log(p / q) - p + q,
+        'is': lambda: q / p - np.log(q / p) - 1,
+        'dis': lambda: p / q - np.log(p / q) - 1
+    }
+    return components[div]().sum(axis = 2)
+
 class Test_bann(unittest.TestCase):
     def setUp(self):
         self.data = np.array([[.1], [.6]])
@@ -155,6 +176,256 @@ class Test_bann(unittest.TestCase):
                 [ 7, 23,  8]])))
 
 
+    def test_knn_large(self):
+        print("Testing nearest neighbor searches on huge-page sized point stores...")
+        # A point store above 2 MiB is allocated on huge pages when the system allows
+        rng = np.random.default_rng(1)
+        data = rng.random((40000, 8))
+        query = rng.random((50, 8))
+        brute = np.argsort(brute_divergences(query, data, 'se'), axis = 1)[:, :3]
+        self.assertTrue(np.array_equal(bann.k_search(data, query, 3, 0, 'se'), brute))
+
+        # Rows padded to a SIMD boundary hold the same points
+        index = bann.Index(data, pad_rows = True)
+        self.assertIsNone(index.data)
+        self.assertTrue(np.array_equal(index.k_search(query, 3, 0, 'se'), brute))
+        self.assertTrue(np.array_equal(bann.Index(data[:, :5], pad_rows = True).k_search(query[:, :5], 3, 0, 'kl'),
+                                       bann.k_search(data[:, :5], query[:, :5], 3, 0, 'kl')))
+        with self.assertRaises(ValueError):
+            bann.Index(data, pad_rows = True, subspace = 2)
+
+    def test_knn_block(self):
+        print("Testing block nearest neighbor searches...")
+        # Blocks of queries must find the same neighbours as single query searches
+        for div in ['se', 'kl', 'dkl', 'is', 'dis']:
+            expected = bann.k_search(self.dim_data, self.dim_query, 3, 0, div)
+            for block in [2, 3, 10, 64]:
+                self.assertTrue(np.array_equal(
+                    bann.k_search(self.dim_data, self.dim_query, 3, 0, div, block = block), expected))
+        rng = np.random.default_rng(2)
+        data = rng.random((5000, 4)) + 0.01
+        query = np.sort(rng.random((500, 4)) + 0.01, axis = 0)
+        for div in ['se', 'kl']:
+            self.assertTrue(np.array_equal(bann.k_search(data, query, 5, 0, div, block = 128),
+                                           bann.k_search(data, query, 5, 0, div)))
+
+    def test_knn_reorder(self):
+        print("Testing nearest neighbor searches in leaf order...")
+        # Reordered searches return the results of each query in its own row
+        rng = np.random.default_rng(5)
+        data = rng.random((3000, 3)) + 0.01
+        query = rng.random((777, 3)) + 0.01
+        index = bann.Index(data)
+        for div in ['se', 'kl', 'dkl', 'is', 'dis']:
+            expected, expected_dists = bann.k_search(data, query, 4, 0, div, return_dists = True)
+            for block in [1, 16]:
+                for search in [bann.k_search(data, query, 4, 0, div, block = block, reorder = True,
+                                             return_dists = True),
+                               index.k_search(query, 4, 0, div, block = block, reorder = True,
+                                              return_dists = True)]:
+                    self.assertTrue(np.array_equal(search[0], expected))
+                    self.assertTrue(np.array_equal(search[1], expected_dists))
+
+    def test_knn_dual(self):
+        print("Testing dual-tree nearest neighbor searches...")
+        # The dual-tree search finds the neighbours of the single-tree search, also for the
+        # all-kNN of a data set against itself
+        rng = np.random.default_rng(6)
+        data = rng.random((2000, 3)) + 0.01
+        query = rng.random((1500, 3)) + 0.01
+        index = bann.Index(data)
+        for div in ['se', 'kl', 'dkl', 'is', 'dis']:
+            for q in [query, data]:
+                expected, expected_dists = bann.k_search(data, q, 5, 0, div, return_dists = True)
+                for search in [bann.k_search(data, q, 5, 0, div, dual = True, return_dists = True),
+                               index.k_search(q, 5, 0, div, dual = True, return_dists = True)]:
+                    self.assertTrue(np.array_equal(search[0], expected))
+                    self.assertTrue(np.allclose(search[1], expected_dists))
+            self.assertTrue(np.array_equal(bann.k_search(data, data, 5, 0, div, dual = True),
+                                           expected))
+
+    def test_knn_lazy(self):
+        print("Testing searches of lazily built kd-trees...")
+        # Trees built as the searches reach them give the results of trees built up front,
+        # whether the queries touch a small part of the data or all of it
+        rng = np.random.default_rng(9)
+        data = rng.random((5000, 3)) + 0.01
+        for query in [rng.random((3, 3)) * 0.1 + 0.5, rng.random((1000, 3)) + 0.01]:
+            for div in ['se', 'kl', 'dkl', 'is', 'dis']:
+                expected, expected_dists = bann.k_search(data, query, 4, 0, div, return_dists = True)
+                for block in [1, 8]:
+                    search = bann.k_search(data, query, 4, 0, div, block = block, lazy = True,
+                                           return_dists = True)
+                    self.assertTrue(np.array_equal(search[0], expected))
+                    self.assertTrue(np.array_equal(search[1], expected_dists))
+                haus, nn_dists = bann.bhaus(data, query, 0, div, return_nn_dists = True)
+                self.assertEqual(bann.bhaus(data, query, 0, div, lazy = True), haus)
+                self.assertTrue(np.array_equal(
+                    bann.bhaus(data, query, 0, div, return_nn_dists = True, lazy = True)[1], nn_dists))
+
+    def test_knn_budget(self):
+        print("Testing budgeted standard and priority searches...")
+        rng = np.random.default_rng(8)
+        data = rng.random((3000, 4)) + 0.01
+        query = rng.random((200, 4)) + 0.01
+        index = bann.Index(data)
+        for div in ['se', 'kl', 'dis']:
+            expected, expected_dists = index.k_search(query, 3, 0, div, return_dists = True)
+            for mode in ['standard', 'priority']:
+                # Without a budget both modes complete with the exact result
+                nn_idx, nn_dists, truncated = index.k_search_budget(query, 3, 0, div, mode,
+                                                                    return_dists = True)
+                self.assertFalse(truncated.any())
+                self.assertTrue(np.array_equal(nn_idx, expected))
+                self.assertTrue(np.allclose(nn_dists, expected_dists))
+
+                # Queries that complete within the budget are exact; stopped ones are no closer
+                for budget in [dict(max_points = 40), dict(max_leaves = 20), dict(max_time = 1e-9)]:
+                    nn_idx, nn_dists, truncated = index.k_search_budget(query, 3, 0, div, mode,
+                                                                        return_dists = True, **budget)
+                    self.assertTrue(np.array_equal(nn_idx[~truncated], expected[~truncated]))
+                    self.assertTrue(np.all(nn_dists >= expected_dists * (1 - 1e-12)))
+                    if 'max_points' in budget:
+                        self.assertTrue(truncated.any())
+
+                # A query stopped after its first leaf lacks neighbours
+                nn_idx, truncated = index.k_search_budget(query, 3, 0, div, mode, max_leaves = 1)
+                self.assertTrue(truncated.all())
+                self.assertTrue(np.all(nn_idx[:, 1:] == -1))
+        with self.assertRaises(ValueError):
+            index.k_search_budget(query, 3, mode = 'greedy')
+
+    def test_knn_seeded(self):
+        print("Testing seeded nearest neighbor searches...")
+        # Seeds change where a search starts, never what it finds: good, bad, repeated and
+        # invalid candidates all give the result of k_search
+        rng = np.random.default_rng(7)
+        data = rng.random((2000, 3)) + 0.01
+        query = rng.random((300, 3)) + 0.01
+        index = bann.Index(data)
+        for div in ['se', 'kl', 'dkl', 'is', 'dis']:
+            expected, expected_dists = index.k_search(query, 4, 0, div, return_dists = True)
+            bad = rng.integers(-5, 2005, (300, 6))
+            bad[:, 1] = bad[:, 0]
+            for seeds in [None, expected, expected[:, ::-1], bad]:
+                for chain in [False, True]:
+                    nn_idx, nn_dists = index.k_search_seeded(query, seeds, 4, 0, div, chain,
+                                                             return_dists = True)
+                    self.assertTrue(np.array_equal(nn_idx, expected))
+                    self.assertTrue(np.array_equal(nn_dists, expected_dists))
+
+            # A tracker follows points moving a little between frames
+            tracker = bann.Tracker(index, 4, 0, div)
+            frame = query
+            for _ in range(3):
+                self.assertTrue(np.array_equal(tracker.search(frame), index.k_search(frame, 4, 0, div)))
+                frame = np.maximum(frame + rng.normal(0, 0.003, frame.shape), 0.005)
+            tracker.reset()
+            self.assertIsNone(tracker.last)
+        with self.assertRaises(ValueError):
+            index.k_search_seeded(query, np.zeros((299, 2), dtype = int))
+
+    def test_knn_dists(self):
+        print("Testing returned divergences and output buffers...")
+        reverse = {'se': 'se', 'kl': 'dkl', 'dkl': 'kl', 'is': 'dis', 'dis': 'is'}
+        index = bann.Index(self.dim_data)
+        nq = self.dim_query.shape[0]
+        for div in bann.div_map:
+            divs = brute_divergences(self.dim_query, self.dim_data, div)
+            expected = bann.k_search(self.dim_data, self.dim_query, 3, 0, div)
+            for search in [lambda **kw: bann.k_search(self.dim_data, self.dim_query, 3, 0, div, **kw),
+                           lambda **kw: index.k_search(self.dim_query, 3, 0, div, **kw)]:
+                for block in [1, 4]:
+                    nn_idx, nn_dists = search(block = block, return_dists = True)
+                    self.assertEqual(nn_idx.dtype, bann.idx_dtype)
+                    self.assertTrue(np.array_equal(nn_idx, expected))
+                    self.assertTrue(np.allclose(nn_dists, np.take_along_axis(divs, expected, axis = 1)))
+
+                    # Results are written into the caller's arrays
+                    out_idx = np.full((nq, 3), -1, dtype = bann.idx_dtype)
+                    out_dists = np.empty((nq, 3))
+                    result = search(block = block, out_indices = out_idx, out_dists = out_dists)
+                    self.assertIs(result[0], out_idx)
+                    self.assertIs(result[1], out_dists)
+                    self.assertTrue(np.array_equal(out_idx, expected))
+                    self.assertTrue(np.array_equal(out_dists, nn_dists))
+                    self.assertIs(search(block = block, out_indices = out_idx), out_idx)
+
+            # Hausdorff runs report the divergence of each query point from its nearest point
+            nn_min = brute_divergences(self.dim_query, self.dim_data, reverse[div]).min(axis = 1)
+            haus = bann.bhaus(self.dim_data, self.dim_query, 0, div)
+            for result in [bann.bhaus(self.dim_data, self.dim_query, 0, div, return_nn_dists = True),
+                           index.bhaus(self.dim_query, 0, div, out_nn_dists = np.empty(nq))]:
+                self.assertTrue(np.isclose(result[0], haus))
+                self.assertTrue(np.allclose(result[1], nn_min))
+                self.assertEqual(result[0], result[1].max())
+
+        for bad in [np.empty((nq, 3)), np.empty((nq, 2), dtype = bann.idx_dtype),
+                    np.empty((3, nq), dtype = bann.idx_dtype).T]:
+            with self.assertRaises(ValueError):
+                bann.k_search(self.dim_data, self.dim_query, 3, out_indices = bad)
+        with self.assertRaises(ValueError):
+            index.bhaus(self.dim_query, out_nn_dists = np.empty(nq + 1))
+
+    def test_knn_stream(self):
+        print("Testing streaming nearest neighbor searches...")
+        rng = np.random.default_rng(3)
+        data = rng.random((2000, 4)) + 0.01
+        query = rng.random((1037, 4)) + 0.01
+        expected, expected_dists = bann.k_search(data, query, 3, 0, 'kl', return_dists = True)
+        with tempfile.TemporaryDirectory() as tmp:
+            stored = np.lib.format.open_memmap(os.path.join(tmp, 'query.npy'), mode = 'w+',
+                                               shape = query.shape)
+            stored[:] = query
+            out = np.lib.format.open_memmap(os.path.join(tmp, 'nn.npy'), mode = 'w+',
+                                            dtype = bann.idx_dtype, shape = expected.shape)
+            for threads in [1, 3]:
+                # Chunks of a memory map, written to an output memory map
+                out[:] = -1
+                self.assertEqual(bann.k_search_stream(data, stored, 3, 0, 'kl', chunk_size = 100,
+                                                      threads = threads, out_indices = out), 1037)
+                self.assertTrue(np.array_equal(out, expected))
+
+                # Points and blocks of an iterator, passed on in order to a callback
+                chunks = []
+                items = iter([query[:1], *query[1:500], query[500:]])
+                index = bann.Index(data)
+                index.k_search_stream(items, 3, 0, 'kl', chunk_size = 128, threads = threads,
+                                      return_dists = True,
+                                      callback = lambda start, idx, dists: chunks.append((start, idx, dists)))
+                self.assertEqual([c[0] for c in chunks], list(range(0, 1037, 128)))
+                self.assertTrue(max(c[1].shape[0] for c in chunks) <= 128)
+                self.assertTrue(np.array_equal(np.vstack([c[1] for c in chunks]), expected))
+                self.assertTrue(np.allclose(np.vstack([c[2] for c in chunks]), expected_dists))
+            del stored, out
+
+        with self.assertRaises(ValueError):
+            bann.k_search_stream(data, query, 3)
+        with self.assertRaises(ValueError):
+            bann.k_search_stream(data, query, 3, out_indices = np.empty((1000, 3), dtype = bann.idx_dtype))
+        with self.assertRaises(ValueError):
+            bann.k_search_stream(data, iter(query), 3, out_indices = np.empty((1000, 3), dtype = bann.idx_dtype))
+
+    def test_bh_stream(self):
+        print("Testing streaming Bregman-Hausdorff divergences...")
+        rng = np.random.default_rng(4)
+        setp = rng.random((1500, 3)) + 0.01
+        setq = rng.random((900, 3)) + 0.01
+        with tempfile.TemporaryDirectory() as tmp:
+            stored = np.lib.format.open_memmap(os.path.join(tmp, 'q.npy'), mode = 'w+', shape = setq.shape)
+            stored[:] = setq
+            for div in ['se', 'kl', 'dkl', 'is', 'dis']:
+                for eps in [0, 0.5]:
+                    # Carrying the threshold across chunks gives the result of a single call
+                    expected = bann.bhaus(setp, setq, eps, div)
+                    self.assertEqual(bann.bhaus_stream(setp, stored, eps, div, chunk_size = 64), expected)
+                    self.assertEqual(bann.Index(setp).bhaus_stream(iter(setq), eps, div, chunk_size = 100),
+                                     expected)
+            del stored
+        self.assertEqual(bann.bhaus_stream(setp, iter([])), 0.0)
+        with self.assertRaises(ValueError):
+            bann.bhaus_stream(setp, setq[:, :2])
+
     def test_bh_basics(self):
         print("Testing basic Bregman--Hausdorff divergence computations...")
         # Query two 1-point sets for Bregman--Hausdorff divergences.
@@ -175,6 +446,440 @@ class Test_bann(unittest.TestCase):
         self.assertTrue(np.isclose(bann.bhaus(self.dim_data, self.dim_query, 0, 'dis'), 0.38024526638997314))
         self.assertTrue(np.isclose(bann.bhaus(self.dim_data, self.dim_query, 0, 'se'), 0.019922427962113392))
 
+    def test_index(self):
+        print("Testing persistent index searches...")
+        # One index answers every divergence and direction like the one-shot functions
+        index = bann.Index(self.dim_data)
+        self.assertEqual((index.n_points, index.dim), self.dim_data.shape)
+        for div in ['se', 'kl', 'dkl', 'is', 'dis']:
+            expected = bann.k_search(self.dim_data, self.dim_query, 3, 0, div)
+            self.assertTrue(np.array_equal(index.k_search(self.dim_query, 3, 0, div), expected))
+            self.assertTrue(np.array_equal(index.k_search(self.dim_query, 3, 0, div, block = 4), expected))
+            self.assertEqual(index.bhaus(self.dim_query, 0, div), bann.bhaus(self.dim_data, self.dim_query, 0, div))
+
+        # Range search against brute force, with divergences D(query, data) summed over coordinates
+        for div in bann.div_map:
+            divs = brute_divergences(self.dim_query, self.dim_data, div)
+            for radius in [0, 0.01, 0.05]:
+                in_range = index.range_search(self.dim_query, radius, 0, div)
+                self.assertEqual(len(in_range), self.dim_query.shape[0])
+                for i, idx in enumerate(in_range):
+                    expected = np.flatnonzero(divs[i] <= radius)
+                    self.assertTrue(np.array_equal(idx, expected[np.argsort(divs[i][expected])]))
+
+        stats = index.stats()
+        self.assertEqual(stats['n_pts'], self.dim_data.shape[0])
+        self.assertEqual(stats['dim'], self.dim_data.shape[1])
+        self.assertGreater(stats['depth'], 0)
+
+        with self.assertRaises(ValueError):
+            index.k_search(self.query, 1, 0, 'kl')
+        with self.assertRaises(ValueError):
+            index.range_search(self.dim_query, -1, 0, 'kl')
+
+    def test_range_csr(self):
+        print("Testing range searches with CSR results...")
+        # Per-query radii, reaching from a few points to a few hundred, against brute force
+        rng = np.random.default_rng(9)
+        data = rng.random((2000, 3)) + 0.01
+        query = rng.random((60, 3)) + 0.01
+        index = bann.Index(data)
+        for div in bann.div_map:
+            divs = brute_divergences(query, data, div)
+            # Radii halfway between two points, away from rounding differences
+            ranked, reach = np.sort(divs, axis = 1), rng.integers(0, 300, 60)
+            radii = (ranked[np.arange(60), reach] + ranked[np.arange(60), reach + 1]) / 2
+            offsets, nn_idx, nn_dists = index.range_search_csr(query, radii, 0, div)
+            self.assertEqual(offsets.dtype, bann.idx_dtype)
+            self.assertEqual(offsets[0], 0)
+            for i in range(60):
+                found = nn_idx[offsets[i]:offsets[i + 1]]
+                expected = np.flatnonzero(divs[i] <= radii[i])
+                self.assertTrue(np.array_equal(found, expected[np.argsort(divs[i][expected])]))
+                self.assertTrue(np.allclose(nn_dists[offsets[i]:offsets[i + 1]], divs[i][found]))
+
+            # Unsorted results hold the same points
+            unsorted_offsets, unsorted_idx = index.range_search_csr(query, radii, 0, div, sort = False,
+                                                                    return_dists = False)
+            self.assertTrue(np.array_equal(unsorted_offsets, offsets))
+            for i in range(60):
+                self.assertTrue(np.array_equal(np.sort(unsorted_idx[offsets[i]:offsets[i + 1]]),
+                                               np.sort(nn_idx[offsets[i]:offsets[i + 1]])))
+
+            # One radius for every query, as range_search
+            offsets, nn_idx = index.range_search_csr(query, 0.02, 0, div, return_dists = False)
+            in_range = index.range_search(query, 0.02, 0, div)
+            self.assertTrue(np.array_equal(np.diff(offsets), [len(idx) for idx in in_range]))
+            self.assertTrue(np.array_equal(nn_idx, np.concatenate(in_range)))
+        with self.assertRaises(ValueError):
+            index.range_search_csr(query, np.ones(59))
+        with self.assertRaises(ValueError):
+            index.range_search_csr(query, -np.ones(60))
+
+    def test_index_split(self):
+        print("Testing splitting rules of an index...")
+        rng = np.random.default_rng(11)
+        data = 10.0 ** rng.uniform(-4, 0, (3000, 4))
+        query = 10.0 ** rng.uniform(-4, 0, (100, 4))
+        default = bann.Index(data)
+        for split in bann.split_map:
+            index = bann.Index(data, split = split)
+            for div in bann.div_map:
+                expected, expected_dists = default.k_search(query, 5, 0, div, return_dists = True)
+                nn_idx, nn_dists = index.k_search(query, 5, 0, div, return_dists = True)
+                self.assertTrue(np.allclose(nn_dists, expected_dists))
+        # Cells suited to the divergence let more queries finish within a budget of points
+        for split, div in [('log', 'is'), ('sqrt', 'kl')]:
+            index = bann.Index(data, split = split)
+            self.assertLess(index.k_search_budget(query, 5, 0, div, max_points = 100)[-1].sum(),
+                            default.k_search_budget(query, 5, 0, div, max_points = 100)[-1].sum())
+
+        # Data reaching 0 is split as by the default rule where the rules are undefined
+        data[:100, 0] = 0.0
+        nn_idx = bann.Index(data, split = 'log').k_search(query, 3, 0, 'se')
+        self.assertTrue(np.array_equal(nn_idx, bann.Index(data).k_search(query, 3, 0, 'se')))
+        with self.assertRaises(ValueError):
+            bann.Index(data, split = 'median')
+
+    def test_index_workload(self):
+        print("Testing indexes built for a query workload...")
+        rng = np.random.default_rng(12)
+        data = rng.random((5000, 3)) + 0.01
+        centers = np.array([[0.2, 0.3, 0.5], [0.7, 0.6, 0.2]])
+        sample = np.abs(centers[rng.integers(0, 2, 500)] + rng.normal(0, 0.03, (500, 3))) + 0.01
+        query = np.vstack([np.abs(centers[rng.integers(0, 2, 100)] + rng.normal(0, 0.03, (100, 3))) + 0.01,
+                           rng.random((20, 3)) + 0.01])
+        default = bann.Index(data)
+        for div in bann.div_map:
+            index = bann.Index(data, workload = sample, workload_k = 3, workload_div = div)
+            stats = index.stats()
+            self.assertEqual(stats['bkt_size'], 8)
+            self.assertEqual(stats['n_pts'], 5000)
+            for k in (1, 3, 10):
+                expected, expected_dists = default.k_search(query, k, 0, div, return_dists = True)
+                nn_idx, nn_dists = index.k_search(query, k, 0, div, return_dists = True)
+                self.assertTrue(np.allclose(nn_dists, expected_dists))
+            # Any search works on the tree
+            self.assertTrue(np.array_equal(index.range_count(query, 0.01, 0, div),
+                                           default.range_count(query, 0.01, 0, div)))
+
+        # Cold regions get coarse leaves
+        index = bann.Index(data, workload = sample, max_bucket = 32)
+        self.assertLess(index.stats()['n_lf'], default.stats()['n_lf'])
+        with self.assertRaises(ValueError):
+            bann.Index(data, workload = sample[:, :2])
+        with self.assertRaises(ValueError):
+            bann.Index(data, workload = sample, max_bucket = 0)
+
+    def test_index_subspace(self):
+        print("Testing indexes built along a coordinate subspace...")
+        # Points varying mostly along 4 of 60 coordinates
+        rng = np.random.default_rng(13)
+        wide = [7, 19, 33, 50]
+        scale = np.full(60, 0.002)
+        scale[wide] = 0.4
+        data = 0.5 + rng.random((3000, 60)) * scale
+        query = 0.5 + rng.random((50, 60)) * scale
+        default = bann.Index(data)
+        self.assertCountEqual(bann.Index(data, subspace = 4).subspace, wide)
+        for rank in ['spread', 'kl']:
+            for subspace in [4, 12, [50, 7], [59]]:
+                index = bann.Index(data, subspace = subspace, subspace_rank = rank)
+                self.assertIsNone(index.data)
+                for div in bann.div_map:
+                    expected, expected_dists = default.k_search(query, 5, 0, div, return_dists = True)
+                    for block in [1, 8]:
+                        nn_idx, nn_dists = index.k_search(query, 5, 0, div, block = block,
+                                                          return_dists = True)
+                        self.assertTrue(np.array_equal(nn_idx, expected))
+                        self.assertTrue(np.allclose(nn_dists, expected_dists))
+                    self.assertTrue(np.array_equal(index.k_search(query, 5, 0, div, dual = True),
+                                                   expected))
+                    self.assertTrue(np.isclose(index.bhaus(query, 0, div), default.bhaus(query, 0, div)))
+                    radius = np.median(expected_dists[:, 2])
+                    self.assertTrue(np.array_equal(index.range_count(query, radius, 0, div),
+                                                   default.range_count(query, radius, 0, div)))
+
+        index = bann.Index(data, subspace = [50, 7])
+        self.assertTrue(np.array_equal(index.subspace, [50, 7]))
+        with self.assertRaises(ValueError):
+            index.save(os.path.join(tempfile.gettempdir(), 'bann_subspace.idx'))
+        for subspace in [0, 61, [], [3, 3], [60]]:
+            with self.assertRaises(ValueError):
+                bann.Index(data, subspace = subspace)
+        with self.assertRaises(ValueError):
+            bann.Index(data, subspace = 4, workload = query)
+
+    def test_range_count(self):
+        print("Testing range counting...")
+        rng = np.random.default_rng(10)
+        data = rng.random((3000, 3)) + 0.01
+        query = rng.random((50, 3)) + 0.01
+        index = bann.Index(data)
+        for div in bann.div_map:
+            divs = brute_divergences(query, data, div)
+            # Radii halfway between two points, from none to most of the data set
+            ranked, reach = np.sort(divs, axis = 1), rng.integers(0, 2900, 50)
+            reach[:3] = [0, 1, 2899]
+            radii = (ranked[np.arange(50), reach] + ranked[np.arange(50), reach + 1]) / 2
+            radii[0] = 0.0
+            counts = index.range_count(query, radii, 0, div)
+            self.assertEqual(counts.dtype, bann.idx_dtype)
+            self.assertTrue(np.array_equal(counts, (divs <= radii[:, None]).sum(axis = 1)))
+            offsets, _ = index.range_search_csr(query, radii, 0, div, return_dists = False)
+            self.assertTrue(np.array_equal(counts, np.diff(offsets)))
+
+            # Approximate counts lie between those at radius/(1+eps) and radius
+            counts = index.range_count(query, radii, 0.5, div)
+            self.assertTrue((counts >= (divs <= radii[:, None] / 1.5).sum(axis = 1)).all())
+            self.assertTrue((counts <= (divs <= radii[:, None]).sum(axis = 1)).all())
+        with self.assertRaises(ValueError):
+            index.range_count(query, np.ones(49))
+
+    def test_c_functions(self):
+        print("Testing C entry points of an index...")
+        index = bann.Index(self.dim_data)
+        knn, haus = bann.c_functions['knn'], bann.c_functions['haus']
+        nn_idx = np.empty(3, dtype = bann.idx_dtype)
+        nn_dists = np.empty(3)
+        for div, code in bann.div_map.items():
+            expected, expected_dists = index.k_search(self.dim_query, 3, 0, div, return_dists = True)
+            threshold = 0.0
+            for i, q in enumerate(self.dim_query):
+                self.assertEqual(knn(index.handle, q.ctypes.data, 3, code, 0.0,
+                                     nn_idx.ctypes.data, nn_dists.ctypes.data), 0)
+                self.assertTrue(np.array_equal(nn_idx, expected[i]))
+                self.assertTrue(np.array_equal(nn_dists, expected_dists[i]))
+                self.assertEqual(knn(index.handle, q.ctypes.data, 3, code, 0.0, nn_idx.ctypes.data, None), 0)
+                self.assertTrue(np.array_equal(nn_idx, expected[i]))
+                threshold = max(threshold, haus(index.handle, q.ctypes.data, code, 0.0, threshold))
+            self.assertEqual(threshold, index.bhaus(self.dim_query, 0, div))
+        q = self.dim_query[0]
+        self.assertEqual(knn(index.handle, q.ctypes.data, 3, 7, 0.0, nn_idx.ctypes.data, None), -1)
+        self.assertEqual(knn(index.handle, q.ctypes.data, index.n_points + 1, 1, 0.0, nn_idx.ctypes.data, None), -1)
+        self.assertEqual(haus(index.handle, q.ctypes.data, 7, 0.0, 0.0), -1)
+
+    def test_c_library(self):
+        print("Testing the C library...")
+        # setup.py builds libbann.so next to the extension; search it through ctypes
+        import ctypes
+        lib = ctypes.CDLL(os.path.join(os.path.dirname(os.path.abspath(bann.__file__)), 'libbann.so'))
+        idx64 = np.dtype(bann.idx_dtype).itemsize == 8
+        lib.bann_create.restype = ctypes.c_void_p
+        lib.bann_create.argtypes = [ctypes.c_void_p, ctypes.c_longlong if idx64 else ctypes.c_int,
+                                    ctypes.c_int, ctypes.c_long, ctypes.c_int, ctypes.c_void_p]
+        lib.bann_destroy.argtypes = [ctypes.c_void_p]
+        idx_t = ctypes.c_longlong if idx64 else ctypes.c_int
+        lib.bann_knn.argtypes = [ctypes.c_void_p, ctypes.c_void_p, idx_t, ctypes.c_int, ctypes.c_int,
+                                 ctypes.c_double, ctypes.c_void_p, ctypes.c_void_p]
+        lib.bann_range_all.argtypes = [ctypes.c_void_p, ctypes.c_void_p, idx_t, ctypes.c_void_p, idx_t,
+                                       ctypes.c_int, ctypes.c_double, ctypes.c_int, ctypes.c_void_p,
+                                       ctypes.c_void_p]
+        lib.bann_range_result_copy.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p]
+        lib.bann_range_result_free.argtypes = [ctypes.c_void_p]
+        lib.bann_range.argtypes = [ctypes.c_void_p, ctypes.c_void_p, idx_t, ctypes.c_double, ctypes.c_int,
+                                   ctypes.c_double, ctypes.c_void_p, ctypes.c_void_p]
+        self.assertEqual(lib.bann_idx_size(), np.dtype(bann.idx_dtype).itemsize)
+
+        rng = np.random.default_rng(14)
+        data = rng.random((1000, 3)) + 0.01
+        query = rng.random((20, 3)) + 0.01
+        index = bann.Index(data)
+        handle = lib.bann_create(data.ctypes.data, 1000, 3, 3, 0, None)
+        try:
+            nn_idx = np.empty((20, 4), dtype = bann.idx_dtype)
+            self.assertEqual(lib.bann_knn(handle, query.ctypes.data, 20, 4, 1, 0.0, nn_idx.ctypes.data, None), 0)
+            self.assertTrue(np.array_equal(nn_idx, index.k_search(query, 4, 0, 'kl')))
+
+            radii = np.full(20, 0.02)
+            offsets = np.empty(21, dtype = bann.idx_dtype)
+            found = ctypes.c_void_p()
+            self.assertEqual(lib.bann_range_all(handle, query.ctypes.data, 20, radii.ctypes.data, 20, 1,
+                                                0.0, 1, offsets.ctypes.data, ctypes.byref(found)), 0)
+            in_range = np.empty(offsets[-1], dtype = bann.idx_dtype)
+            lib.bann_range_result_copy(found, in_range.ctypes.data, None)
+            lib.bann_range_result_free(found)
+            expected_offsets, expected = index.range_search_csr(query, radii, 0, 'kl', return_dists = False)
+            self.assertTrue(np.array_equal(offsets, expected_offsets))
+            self.assertTrue(np.array_equal(in_range, expected))
+
+            # Counts of one radius come in index-sized integers
+            counts = np.empty(20, dtype = bann.idx_dtype)
+            self.assertEqual(lib.bann_range(handle, query.ctypes.data, 20, 0.02, 1, 0.0,
+                                            counts.ctypes.data, None), 0)
+            self.assertTrue(np.array_equal(counts, index.range_count(query, 0.02, 0, 'kl')))
+        finally:
+            lib.bann_destroy(handle)
+
+    def test_index_zero_copy(self):
+        print("Testing index construction over NumPy buffers...")
+        wide = np.random.default_rng(3).random((120, 7)) + 0.01
+        views = [wide, wide[::2], wide[::-3], wide[:, 1:5], wide[10:90:4, 2:], wide[:, 3:4]]
+        for view in views:
+            expected = bann.Index(np.ascontiguousarray(view), copy = True).k_search(view[:9], 2, 0, 'kl')
+            index = bann.Index(view)
+            self.assertTrue(np.shares_memory(index.data, wide))
+            self.assertTrue(np.array_equal(index.k_search(view[:9], 2, 0, 'kl'), expected))
+
+        # Layouts that cannot be searched in place are copied once
+        for data in [np.asfortranarray(wide), wide.astype(np.float32), wide[:, ::2]]:
+            index = bann.Index(data)
+            self.assertFalse(np.shares_memory(index.data, wide))
+            self.assertTrue(np.array_equal(index.k_search(wide[:9, :data.shape[1]], 1, 0, 'se'),
+                                           bann.k_search(np.ascontiguousarray(data, dtype = np.double),
+                                                         wide[:9, :data.shape[1]], 1, 0, 'se')))
+        self.assertIsNone(bann.Index(wide, copy = True).data)
+
+    def test_index_file(self):
+        print("Testing saving and loading indexes...")
+        index = bann.Index(self.dim_data)
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, 'data.bann')
+            index.save(path, metadata = {'source': 'dim_data', 'rows': 10})
+            for verify in [False, True]:
+                loaded = bann.Index.load(path, verify = verify)
+                self.assertEqual((loaded.n_points, loaded.dim), (index.n_points, index.dim))
+                self.assertEqual(loaded.metadata, {'source': 'dim_data', 'rows': 10})
+                self.assertGreater(loaded.build_time, 0)
+                self.assertEqual(loaded.stats(), index.stats())
+                for div in ['se', 'kl', 'dkl', 'is', 'dis']:
+                    self.assertTrue(np.array_equal(loaded.k_search(self.dim_query, 3, 0, div),
+                                                   index.k_search(self.dim_query, 3, 0, div)))
+                    self.assertEqual(loaded.bhaus(self.dim_query, 0, div),
+                                     index.bhaus(self.dim_query, 0, div))
+            self.assertIsNone(index.metadata)
+
+            # How the tree was built is kept in the file
+            self.assertEqual((index.stats()['build'], index.stats()['split']), ('split', 'suggest'))
+            workload = bann.Index(self.dim_data, workload = self.dim_query)
+            self.assertEqual((workload.stats()['build'], workload.stats()['split']), ('workload', None))
+            for built in [bann.Index(self.dim_data, split = 'log'), workload]:
+                built.save(path)
+                self.assertEqual(bann.Index.load(path).stats(), built.stats())
+            index.save(path)
+
+            # A damaged point is only noticed when verifying, a damaged header always
+            with open(path, 'r+b') as f:
+                f.seek(4096)
+                f.write(b'\xff' * 8)
+            bann.Index.load(path)
+            self.assertRaises(ValueError, bann.Index.load, path, verify = True)
+            with open(path, 'r+b') as f:
+                f.write(b'NOTBANN')
+            self.assertRaises(ValueError, bann.Index.load, path)
+            self.assertRaises(OSError, bann.Index.load, os.path.join(tmp, 'missing.bann'))
+            self.assertRaises(ValueError, index.save, path, metadata = 'x' * 300)
+
+    def test_index_shared(self):
+        print("Testing indexes shared between processes...")
+        name = 'bann-test-%d' % os.getpid()
+        np.save(os.path.join(tempfile.gettempdir(), name + '.npy'), self.dim_data)
+        # Publish from a process that exits before the index is attached
+        script = ("import bann, numpy; bann.Index(numpy.load(%r)).publish(%r, metadata = 'child')"
+                  % (os.path.join(tempfile.gettempdir(), name + '.npy'), name))
+        subprocess.run([sys.executable, '-c', script], check = True)
+        try:
+            attached = bann.Index.attach(name, verify = True)
+            self.assertEqual(attached.metadata, 'child')
+            self.assertRaises(FileExistsError, bann.Index(self.dim_data).publish, name)
+        finally:
+            bann.Index.unlink_shared(name)
+            os.remove(os.path.join(tempfile.gettempdir(), name + '.npy'))
+
+        # The attached index outlives the name of its segment
+        expected = bann.k_search(self.dim_data, self.dim_query, 3, 0, 'kl')
+        self.assertTrue(np.array_equal(attached.k_search(self.dim_query, 3, 0, 'kl'), expected))
+        self.assertRaises(OSError, bann.Index.attach, name)
+        self.assertRaises(FileNotFoundError, bann.Index.unlink_shared, name)
+
+    def test_numa(self):
+        print("Testing NUMA-replicated nearest neighbor searches...")
+        # Simulated placements must return the same neighbours as k_search
+        expected = bann.k_search(self.dim_data, self.dim_query, 3, 0, 'kl')
+        for nodes in range(1, 4):
+            for threads in range(1, 5):
+                nn_idx, stats = bann.numa_k_search(self.dim_data, self.dim_query, 3, 0, 'kl',
+                                                   threads = threads, numa_nodes = nodes)
+                self.assertTrue(np.array_equal(nn_idx, expected))
+                self.assertEqual(stats['replicas'], nodes)
+                self.assertEqual(stats['worker_replica'], [w % nodes for w in range(threads)])
+                self.assertEqual(sum(stats['served']), self.dim_query.shape[0])
+                self.assertEqual(len(stats['replica_node']), nodes)
+
+        # An Index keeps its replicas, and counts the queries each serves over its lifetime
+        nq = self.dim_query.shape[0]
+        index = bann.Index(self.dim_data, numa_nodes = 3)
+        for threads in [1, 2, 5]:
+            nn_idx, dists = index.k_search(self.dim_query, 3, 0, 'kl', block = 2, return_dists = True,
+                                           threads = threads)
+            self.assertTrue(np.array_equal(nn_idx, expected))
+        stats = index.stats()
+        self.assertEqual(stats['replicas'], 3)
+        self.assertEqual(len(stats['replica_node']), 3)
+        self.assertEqual(sum(stats['served']), 3 * nq)
+        # Worker w of n searches replica w % 3, on queries [w * nq // n, (w + 1) * nq // n)
+        part = [(w + 1) * nq // 5 - w * nq // 5 for w in range(5)]
+        self.assertEqual(stats['served'], [nq + nq // 2 + part[0] + part[3], nq - nq // 2 + part[1] + part[4],
+                                           part[2]])
+        self.assertIsNone(index.data)
+        self.assertEqual(bann.Index(self.dim_data).stats()['replicas'], 0)
+        self.assertTrue(np.array_equal(bann.Index(self.dim_data).k_search(self.dim_query, 3, 0, 'kl', threads = 4),
+                                       expected))
+        with self.assertRaises(ValueError):
+            bann.Index(self.dim_data, numa_nodes = 2, subspace = 2)
+        with self.assertRaises(ValueError):
+            index.k_search(self.dim_query, 3, 0, 'kl', dual = True, threads = 2)
+
+    def test_threads(self):
+        print("Testing concurrent calls from Python threads...")
+        # Calls release the GIL, so they must give the same answers when overlapped
+        divs = ['se', 'kl', 'dkl', 'is', 'dis']
+        knn = {div: bann.k_search(self.dim_data, self.dim_query, 3, 0, div) for div in divs}
+        haus = {div: bann.bhaus(self.dim_data, self.dim_query, 0, div) for div in divs}
+        with ThreadPoolExecutor(max_workers = 8) as pool:
+            knn_jobs = [(div, pool.submit(bann.k_search, self.dim_data, self.dim_query, 3, 0, div))
+                        for div in divs * 8]
+            haus_jobs = [(div, pool.submit(bann.bhaus, self.dim_data, self.dim_query, 0, div))
+                         for div in divs * 8]
+            for div, job in knn_jobs:
+                self.assertTrue(np.array_equal(job.result(), knn[div]))
+            for div, job in haus_jobs:
+                self.assertEqual(job.result(), haus[div])
+
+    def test_async(self):
+        print("Testing asynchronous query submission...")
+        expected = bann.k_search(self.dim_data, self.dim_query, 3, 0, 'kl')
+        index = bann.Index(self.dim_data)
+        # Requests submitted together are coalesced into fewer internal batches
+        with bann.SearchQueue(threads = 2, window = 0.05) as queue:
+            futures = [queue.submit(index, self.dim_query[i:i+1], 3, 0, 'kl')
+                       for i in range(self.dim_query.shape[0])]
+            nn_idx = np.vstack([f.result() for f in futures])
+            self.assertTrue(np.array_equal(nn_idx, expected))
+            self.assertEqual(queue.requests, self.dim_query.shape[0])
+            self.assertLess(queue.batches, queue.requests)
+            # Queues search an index, whose tree is shared by every batch
+            with self.assertRaises(TypeError):
+                queue.submit(self.dim_data, self.dim_query, 3, 0, 'kl')
+        with self.assertRaises(RuntimeError):
+            queue.submit(index, self.dim_query, 3, 0, 'kl')
+
+        # Batches of several groups are searched side by side, each completing its own futures
+        queue = bann.SearchQueue(threads = 3, window = 0.05, max_batch = 4)
+        futures = [(div, i, queue.submit(index, self.dim_query[i:i+2], 3, 0, div))
+                   for i in range(0, 10, 2) for div in ['kl', 'is']]
+        queue.close()
+        for div, i, f in futures:
+            self.assertTrue(f.done())
+            self.assertTrue(np.array_equal(f.result(), bann.k_search(self.dim_data, self.dim_query[i:i+2], 3, 0, div)))
+        self.assertEqual(queue.batches, 6)
+
+        # Awaitable searches from an event loop
+        async def search_all():
+            return await asyncio.gather(*[bann.k_search_async(index, self.dim_query[i:i+1], 3, 0, 'kl')
+                                          for i in range(self.dim_query.shape[0])])
+        self.assertTrue(np.array_equal(np.vstack(asyncio.run(search_all())), expected))
+
     def tests_errors(self):
         print("Testing error handling...")
         # Check if the Exceptions in bann.pyx throw properly
@@ -185,6 +890,8 @@ class Test_bann(unittest.TestCase):
         ## Divergence choice TypeError
         with self.assertRaises(TypeError):
             bann.k_search(self.data, self.query, 1, 0, 123)
+        with self.assertRaises(TypeError):
+            bann.bhaus(self.data, self.query, 0, 123)
         ## ValueErrors for invalid divergence choices
         with self.assertRaises(ValueError):
             bann.k_search(self.data, self.query, 1, 0, 'not_a_divergence')
@@ -199,6 +906,9 @@ class Test_bann(unittest.TestCase):
             bann.k_search(np.array([.1, .6]), self.query, 1, 0, 'kl')
         with self.assertRaises(ValueError):
             bann.k_search(self.data, np.array([.3, .4]), 1, 0, 'kl')
+        ## Block size ValueError
+        with self.assertRaises(ValueError):
+            bann.k_search(self.data, self.query, 1, 0, 'kl', block = 0)
 
 if __name__ == '__main__':
     unittest.main()
\ No newline at end of file